@@ -0,0 +1,284 @@
+#include "allocation-tracker.h"
+#include "mancala-engine.h"
+#include "search-handle.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if defined(MANCALA_TRACK_ALLOCATIONS)
+
+static thread_local unsigned long long t_Allocations = 0;
+static thread_local unsigned long long t_AllocatedBytes = 0;
+
+/**
+ * @brief Allocates memory and counts the allocation for the calling thread.
+ */
+static void* CountedAllocate(std::size_t size, const std::size_t& alignment = 0)
+{
+    t_Allocations++;
+    t_AllocatedBytes += size;
+    size = size == 0 ? 1 : size;
+    if (alignment <= alignof(std::max_align_t))
+    {
+        return std::malloc(size);
+    }
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+/**
+ * @brief Frees memory returned by CountedAllocate.
+ */
+static void CountedFree(void* pointer, const std::size_t& alignment = 0)
+{
+#if defined(_WIN32)
+    if (alignment > alignof(std::max_align_t))
+    {
+        _aligned_free(pointer);
+        return;
+    }
+#endif
+    (void)alignment;
+    std::free(pointer);
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* pointer = CountedAllocate(size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = CountedAllocate(size, (std::size_t)alignment))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept { CountedFree(pointer); }
+void operator delete[](void* pointer) noexcept { CountedFree(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { CountedFree(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { CountedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { CountedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { CountedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t alignment) noexcept { CountedFree(pointer, (std::size_t)alignment); }
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept { CountedFree(pointer, (std::size_t)alignment); }
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept { CountedFree(pointer, (std::size_t)alignment); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept { CountedFree(pointer, (std::size_t)alignment); }
+
+#endif
+
+/**
+ * @brief Checks whether the program was built with allocation counting.
+ *
+ * @return True if the allocation counts are tracked, false otherwise.
+ */
+bool AllocationTracker::Enabled()
+{
+#if defined(MANCALA_TRACK_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Returns the number of heap allocations made by the calling thread so far.
+ *
+ * @return The allocation count, 0 if allocations are not tracked.
+ */
+unsigned long long AllocationTracker::Allocations()
+{
+#if defined(MANCALA_TRACK_ALLOCATIONS)
+    return t_Allocations;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Returns the number of bytes allocated by the calling thread so far.
+ *
+ * @return The allocated bytes, 0 if allocations are not tracked.
+ */
+unsigned long long AllocationTracker::AllocatedBytes()
+{
+#if defined(MANCALA_TRACK_ALLOCATIONS)
+    return t_AllocatedBytes;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Returns the resident set size of the process.
+ *
+ * @return The resident memory in bytes, 0 where it cannot be measured.
+ */
+size_t AllocationTracker::ResidentBytes()
+{
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (statm >> totalPages >> residentPages)
+    {
+        return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief Checks that fixed-depth and timed searches do not allocate and that memory stays flat over many moves.
+ *
+ * Reports allocations per search, per node and per move. Fails if any search allocates (when
+ * allocations are tracked) or if the resident memory grows while playing the moves.
+ *
+ * @param depth The depth of the searches.
+ * @param moves The number of consecutive moves to play.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int AllocationTracker::Start(const char& depth, const int& moves)
+{
+    constexpr size_t RSS_TOLERANCE = 1 << 20; // Allocator and page cache noise
+    bool passed = true;
+
+    if (!Enabled())
+    {
+        std::cout << "allocation counts are not tracked, build with -DMANCALA_TRACK_ALLOCATIONS=ON\n";
+    }
+
+    Minimax engine(std::make_shared<TranspositionTable>());
+    std::mt19937 generator(2024);
+
+    // Fixed-depth searches from positions of both rulesets
+    {
+        unsigned long long allocations = 0, nodes = 0;
+        int searches = 0;
+        for (int ruleset = 0; ruleset < 2; ++ruleset)
+        {
+            State state;
+            state.ChangeRuleset((char)ruleset);
+            while (state.GameState() != GAMEOVER && searches < 40)
+            {
+                const unsigned long long before = Allocations();
+                const SearchResult result = engine.Search(state, depth);
+                allocations += Allocations() - before;
+                nodes += result.m_Nodes;
+                searches++;
+
+                const MoveList legalMoves = state.LegalMoves();
+                state.MakeMove(generator() % 4 == 0 ? legalMoves[generator() % legalMoves.size()] : result.m_BestMove);
+            }
+        }
+
+        std::cout << std::format("searches: {} at depth {}, {} nodes\n", searches, (int)depth, nodes);
+        std::cout << std::format("allocations per search: {}, per node: {}\n", (double)allocations / searches, (double)allocations / std::max(nodes, 1ULL));
+        if (Enabled() && allocations != 0)
+        {
+            std::cout << "FAILED: fixed-depth searches allocated " << allocations << " times\n";
+            passed = false;
+        }
+    }
+
+    // Iterative deepening with a time limit, as the C API searches a batch
+    {
+        SearchOptions options;
+        options.m_MaxDepth = depth;
+        options.m_TimeLimit = 5.0F;
+        unsigned long long allocations = 0;
+        State state;
+        for (int search = 0; search < 20 && state.GameState() != GAMEOVER; ++search)
+        {
+            const unsigned long long before = Allocations();
+            const SearchResult result = SearchHandle::Search(engine, state, options);
+            allocations += Allocations() - before;
+            state.MakeMove(result.m_BestMove);
+        }
+
+        std::cout << std::format("allocations of timed searches: {}\n", allocations);
+        if (Enabled() && allocations != 0)
+        {
+            std::cout << "FAILED: timed searches allocated " << allocations << " times\n";
+            passed = false;
+        }
+    }
+
+    // Consecutive moves, restarting finished games
+    {
+        State state;
+        size_t warmResident = 0;
+        unsigned long long allocations = 0;
+        for (int move = 0; move < moves; ++move)
+        {
+            if (move == moves / 10)
+            {
+                warmResident = ResidentBytes(); // After the tables were touched
+            }
+            if (state.GameState() == GAMEOVER)
+            {
+                state = State();
+                state.ChangeRuleset((char)(move % 2));
+            }
+
+            const unsigned long long before = Allocations();
+            const SearchResult result = engine.Search(state, std::min<char>(depth, 4));
+            state.MakeMove(result.m_BestMove);
+            allocations += Allocations() - before;
+        }
+
+        const size_t resident = ResidentBytes();
+        std::cout << std::format("moves: {}, allocations per move: {}\n", moves, (double)allocations / moves);
+        if (warmResident != 0)
+        {
+            std::cout << std::format("resident memory: {} KB -> {} KB\n", warmResident / 1024, resident / 1024);
+            if (resident > warmResident + RSS_TOLERANCE)
+            {
+                std::cout << "FAILED: resident memory grew while playing\n";
+                passed = false;
+            }
+        }
+        if (Enabled() && allocations != 0)
+        {
+            std::cout << "FAILED: playing moves allocated " << allocations << " times\n";
+            passed = false;
+        }
+    }
+
+    std::cout << (passed ? "allocation check passed\n" : "allocation check failed\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Counts heap allocations and checks that searching and playing do not allocate.
+ *
+ * Building with MANCALA_TRACK_ALLOCATIONS replaces the global operator new and delete with versions
+ * that count allocations. Counts are kept per thread, so a measurement on one thread is not disturbed
+ * by others (such as the pondering thread). Without the option every count is zero and Enabled returns
+ * false.
+ */
+class AllocationTracker
+{
+public:
+	static bool Enabled();
+	static unsigned long long Allocations();
+	static unsigned long long AllocatedBytes();
+	static size_t ResidentBytes();
+
+	static int Start(const char& depth = 6, const int& moves = 1000);
+};
@@ -0,0 +1,603 @@
+#include "engine-server.h"
+#include "allocation-tracker.h"
+#include "position-index.h"
+#include "serializer.h"
+#include "tracer.h"
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <filesystem>
+#include <format>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<bool> s_Interrupted = false; // Set by SIGINT and SIGTERM
+
+/**
+ * @brief Creates the shared tables and starts the worker threads.
+ *
+ * @param config The server settings.
+ */
+EngineServer::EngineServer(const ServerConfig& config)
+    : m_Config(config), m_Table(std::make_shared<TranspositionTable>(config.m_TableMegabytes)), m_ExactTable(std::make_shared<TranspositionTable>(16)),
+      m_NextSession(1), m_NextClient(1), m_Wakeup{ -1, -1 }, m_Stop(false), m_Start(std::chrono::steady_clock::now()),
+      m_Moves(Metrics::Counter("mancala_server_moves_total", "Engine moves played by the server.")),
+      m_SessionCount(Metrics::Gauge("mancala_server_sessions", "Sessions hosted by the server.")),
+      m_QueuedJobs(Metrics::Gauge("mancala_server_queued_searches", "Engine moves waiting for a worker.")),
+      m_MoveLatency(Metrics::Histogram("mancala_server_move_latency_seconds", "Time from a go request to its reply."))
+{
+    if (std::filesystem::exists(POSITIONS_FILE))
+    {
+        hafif::deserialize_umap_from_file(m_Positions, POSITIONS_FILE);
+    }
+
+    for (int i = 0; i < std::max(1, m_Config.m_Workers); ++i)
+    {
+        m_Workers.emplace_back(&EngineServer::WorkerLoop, this);
+    }
+}
+
+/**
+ * @brief Stops the workers after the searches already queued.
+ */
+EngineServer::~EngineServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_JobsMutex);
+        m_Stop = true;
+    }
+    m_JobsReady.notify_all();
+    for (std::thread& worker : m_Workers)
+    {
+        worker.join();
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Closed after the workers, whose last replies may still write to it
+    if (m_Wakeup[0] >= 0)
+    {
+        close(m_Wakeup[0]);
+        close(m_Wakeup[1]);
+    }
+#endif
+}
+
+/**
+ * @brief Runs searches until the server stops. Each worker keeps one engine on the shared tables.
+ */
+void EngineServer::WorkerLoop()
+{
+    Minimax engine(m_Table, m_ExactTable);
+    while (true)
+    {
+        SearchJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_JobsMutex);
+            m_JobsReady.wait(lock, [this]() { return !m_Jobs.empty() || m_Stop; });
+            if (m_Jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_QueuedJobs.Set((double)m_Jobs.size());
+        }
+
+        TraceZone zone("server move");
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        char depth = 0;
+        float score = 0.0F;
+        const char move = SearchMove(engine, job.m_State, job.m_TimeLimit, depth, score);
+
+        {
+            std::lock_guard<std::mutex> lock(m_SessionsMutex);
+            auto it = m_Sessions.find(job.m_Session);
+            if (it == m_Sessions.end())
+            {
+                continue; // Closed while searching
+            }
+            it->second.m_State.MakeMove(move);
+            it->second.m_Busy = false;
+        }
+
+        m_Moves.Add();
+        m_MoveLatency.Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        Send(job.m_Client, std::format("bestmove {} {} {} {}", job.m_Session, (int)move, (int)depth, score));
+    }
+}
+
+/**
+ * @brief Searches a position with iterative deepening until its time budget is used.
+ *
+ * Depths found in the position cache are answered from it, so positions other sessions already
+ * searched let this one go deeper. The first depth always completes; deeper searches are stopped by
+ * the engine at the deadline and the move of the last completed depth is played. The deepest searched
+ * result is added to the cache.
+ *
+ * @param engine The engine of the calling worker.
+ * @param state The position to search.
+ * @param timeLimit The time budget in milliseconds.
+ * @param reachedDepth Receives the deepest depth searched or found in the cache.
+ * @param score Receives the score of the best move, from player 1's point of view.
+ * @return The best move.
+ */
+char EngineServer::SearchMove(Minimax& engine, const State& state, const int& timeLimit, char& reachedDepth, float& score)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(timeLimit);
+    char bestMove = state.LegalMoves()[0];
+    char searchedDepth = 0;
+    char searchedMove = -1;
+
+    for (char depth = 1; depth < 80; ++depth)
+    {
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (depth > 1 && elapsed >= timeLimit)
+        {
+            break;
+        }
+
+        char cached;
+        if (CachedMove(state, depth, cached))
+        {
+            bestMove = cached;
+            reachedDepth = depth;
+            continue;
+        }
+
+        if (depth > 1)
+        {
+            engine.SetLimits(deadline, ULLONG_MAX);
+        }
+        const SearchResult result = engine.Search(state, depth);
+        if (engine.IsStopped())
+        {
+            break; // Cut short at the deadline, the previous depth stands
+        }
+        if (result.m_BestMove >= 0)
+        {
+            bestMove = searchedMove = result.m_BestMove;
+            score = result.m_Score;
+            reachedDepth = searchedDepth = depth;
+        }
+    }
+    engine.ClearLimits();
+    engine.Resume();
+
+    if (searchedMove >= 0 && searchedDepth == reachedDepth)
+    {
+        CacheMove(state, searchedDepth, searchedMove);
+    }
+    return bestMove;
+}
+
+/**
+ * @brief Looks up the move the position cache holds for a position searched to a depth.
+ *
+ * @return True if a legal move was found, false otherwise.
+ */
+bool EngineServer::CachedMove(const State& state, const char& depth, char& move)
+{
+    const State canonical = state.Canonical();
+    if (!PositionIndex::Indexable(canonical))
+    {
+        return false;
+    }
+
+    const unsigned long long key = PositionIndex::CacheKey(canonical, depth);
+    std::shared_lock<std::shared_mutex> lock(m_PositionsMutex);
+    auto it = m_Positions.find(key);
+    if (it == m_Positions.end())
+    {
+        return false;
+    }
+
+    move = state.m_Turn == 1 ? State::MirrorMove(it->second) : it->second;
+    State position = state;
+    return position.IsLegal(move);
+}
+
+/**
+ * @brief Adds a searched move to the position cache and queues it for the cache file.
+ */
+void EngineServer::CacheMove(const State& state, const char& depth, const char& move)
+{
+    const State canonical = state.Canonical();
+    if (!PositionIndex::Indexable(canonical))
+    {
+        return;
+    }
+
+    const unsigned long long key = PositionIndex::CacheKey(canonical, depth);
+    const char cachedMove = state.m_Turn == 1 ? State::MirrorMove(move) : move;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_PositionsMutex);
+        if (!m_Positions.emplace(key, cachedMove).second)
+        {
+            return;
+        }
+    }
+
+    std::string record(reinterpret_cast<const char*>(&key), sizeof(key));
+    record.push_back(cachedMove);
+    m_Persistence.Append(POSITIONS_FILE, std::move(record));
+}
+
+/**
+ * @brief Executes one request line of a client.
+ */
+void EngineServer::HandleLine(const std::shared_ptr<Client>& client, const std::string& line)
+{
+    std::istringstream stream(line);
+    std::string command;
+    stream >> command;
+
+    if (command == "new")
+    {
+        int ruleset = 0;
+        int timeLimit = m_Config.m_DefaultTimeLimit;
+        stream >> ruleset >> timeLimit;
+
+        Session session = { State(), std::clamp(timeLimit, 1, m_Config.m_MaxTimeLimit), client->m_Id, false };
+        session.m_State.ChangeRuleset(ruleset == 1 ? 1 : 0);
+
+        unsigned int id;
+        {
+            std::lock_guard<std::mutex> lock(m_SessionsMutex);
+            id = m_NextSession++;
+            m_Sessions.emplace(id, session);
+            m_SessionCount.Set((double)m_Sessions.size());
+        }
+        Send(client, std::format("session {}", id));
+        return;
+    }
+
+    if (command == "stats")
+    {
+        Send(client, Stats());
+        return;
+    }
+
+    if (command == "quit")
+    {
+        Disconnect(client);
+        return;
+    }
+
+    if (command == "shutdown")
+    {
+        s_Interrupted.store(true);
+        Send(client, "ok");
+        return;
+    }
+
+    unsigned int id = 0;
+    if (!(stream >> id))
+    {
+        Send(client, "error unknown request");
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_SessionsMutex);
+    auto it = m_Sessions.find(id);
+    if (it == m_Sessions.end() || it->second.m_Client != client->m_Id)
+    {
+        lock.unlock();
+        Send(client, std::format("error no session {}", id));
+        return;
+    }
+    Session& session = it->second;
+
+    if (command == "state")
+    {
+        std::string reply = std::format("state {}", id);
+        for (char pit : session.m_State.m_Board)
+        {
+            reply += std::format(" {}", (int)pit);
+        }
+        reply += std::format(" {} {}", (int)session.m_State.m_Turn, session.m_State.GameState() == GAMEOVER ? "gameover" : "playing");
+        lock.unlock();
+        Send(client, reply);
+    }
+    else if (command == "close")
+    {
+        m_Sessions.erase(it);
+        m_SessionCount.Set((double)m_Sessions.size());
+        lock.unlock();
+        Send(client, std::format("closed {}", id));
+    }
+    else if (session.m_Busy)
+    {
+        lock.unlock();
+        Send(client, std::format("error session {} is searching", id));
+    }
+    else if (session.m_State.GameState() == GAMEOVER)
+    {
+        lock.unlock();
+        Send(client, std::format("error session {} is over", id));
+    }
+    else if (command == "move")
+    {
+        int pit = -1;
+        stream >> pit;
+        if (!session.m_State.IsLegal((char)pit))
+        {
+            lock.unlock();
+            Send(client, std::format("error illegal move {}", pit));
+            return;
+        }
+        session.m_State.MakeMove((char)pit);
+        lock.unlock();
+        Send(client, std::format("ok {}", id));
+    }
+    else if (command == "go")
+    {
+        session.m_Busy = true;
+        SearchJob job = { id, session.m_State, session.m_TimeLimit, client };
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> jobsLock(m_JobsMutex);
+            m_Jobs.push_back(std::move(job));
+            m_QueuedJobs.Set((double)m_Jobs.size());
+        }
+        m_JobsReady.notify_one();
+    }
+    else
+    {
+        lock.unlock();
+        Send(client, "error unknown request");
+    }
+}
+
+/**
+ * @brief Queues one reply line for the I/O thread, dropping it when the client is gone.
+ */
+void EngineServer::Send(const std::shared_ptr<Client>& client, const std::string& line)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        std::lock_guard<std::mutex> lock(client->m_OutputMutex);
+        if (client->m_Closed)
+        {
+            return;
+        }
+        client->m_Output += line;
+        client->m_Output += '\n';
+    }
+
+    // A full pipe already holds a wakeup, so a failed write needs no retry
+    const char wakeup = 0;
+    [[maybe_unused]] const ssize_t written = write(m_Wakeup[1], &wakeup, 1);
+#endif
+}
+
+/**
+ * @brief Writes as much of the queued output of a client as its socket takes without blocking.
+ *
+ * @return False if the connection failed, true otherwise.
+ */
+bool EngineServer::Flush(const std::shared_ptr<Client>& client)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    std::lock_guard<std::mutex> lock(client->m_OutputMutex);
+    size_t sent = 0;
+    while (sent < client->m_Output.size() && !client->m_Closed)
+    {
+        const ssize_t written = send(client->m_Socket, client->m_Output.data() + sent, client->m_Output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return false;
+            }
+            break;
+        }
+        sent += written;
+    }
+    client->m_Output.erase(0, sent);
+#endif
+    return true;
+}
+
+/**
+ * @brief Closes a connection and the sessions it created.
+ */
+void EngineServer::Disconnect(const std::shared_ptr<Client>& client)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        std::lock_guard<std::mutex> lock(client->m_OutputMutex);
+        if (client->m_Closed)
+        {
+            return;
+        }
+        client->m_Closed = true;
+        client->m_Output.clear();
+        close(client->m_Socket);
+    }
+
+    std::lock_guard<std::mutex> lock(m_SessionsMutex);
+    std::erase_if(m_Sessions, [&](const auto& session) { return session.second.m_Client == client->m_Id; });
+    m_SessionCount.Set((double)m_Sessions.size());
+#endif
+}
+
+/**
+ * @brief Formats the throughput and memory statistics of the server.
+ */
+std::string EngineServer::Stats()
+{
+    size_t sessions;
+    {
+        std::lock_guard<std::mutex> lock(m_SessionsMutex);
+        sessions = m_Sessions.size();
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+    const size_t resident = AllocationTracker::ResidentBytes();
+    return std::format("stats sessions={} clients={} moves={} moves_per_second={} session_bytes={} resident_bytes={}",
+        sessions, m_Clients.size(), m_Moves.Value(), (unsigned long long)(m_Moves.Value() / std::max(seconds, 1e-3)),
+        sizeof(Session) + sizeof(unsigned int) + 2 * sizeof(void*), resident);
+}
+
+/**
+ * @brief Accepts connections and executes requests until interrupted or asked to shut down.
+ *
+ * @return 0 on a clean shutdown, 1 if the socket could not be opened.
+ */
+int EngineServer::Run()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (m_Config.m_SocketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << std::format("Socket path is too long: {}\n", m_Config.m_SocketPath);
+        return 1;
+    }
+    m_Config.m_SocketPath.copy(address.sun_path, m_Config.m_SocketPath.size());
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(m_Config.m_SocketPath.c_str());
+    if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 1024) != 0)
+    {
+        std::cerr << std::format("Cannot listen on {}\n", m_Config.m_SocketPath);
+        if (server >= 0)
+        {
+            close(server);
+        }
+        return 1;
+    }
+
+    if (pipe(m_Wakeup) != 0)
+    {
+        std::cerr << "Cannot create the wakeup pipe\n";
+        close(server);
+        return 1;
+    }
+    fcntl(m_Wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(m_Wakeup[1], F_SETFL, O_NONBLOCK);
+
+    std::signal(SIGINT, [](int) { s_Interrupted.store(true); });
+    std::signal(SIGTERM, [](int) { s_Interrupted.store(true); });
+    std::cout << std::format("listening on {} with {} workers\n", m_Config.m_SocketPath, m_Workers.size());
+
+    std::vector<pollfd> descriptors;
+    char buffer[4096];
+    while (!s_Interrupted.load())
+    {
+        descriptors.clear();
+        descriptors.push_back({ server, POLLIN, 0 });
+        descriptors.push_back({ m_Wakeup[0], POLLIN, 0 });
+        for (const auto& [socket, client] : m_Clients)
+        {
+            std::lock_guard<std::mutex> lock(client->m_OutputMutex);
+            descriptors.push_back({ socket, (short)(client->m_Output.empty() ? POLLIN : POLLIN | POLLOUT), 0 });
+        }
+
+        if (poll(descriptors.data(), descriptors.size(), 100) <= 0)
+        {
+            continue;
+        }
+
+        if (descriptors[0].revents & POLLIN)
+        {
+            const int socket = accept(server, nullptr, nullptr);
+            if (socket >= 0)
+            {
+                fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+                std::shared_ptr<Client> client = std::make_shared<Client>();
+                client->m_Id = m_NextClient++;
+                client->m_Socket = socket;
+                m_Clients.emplace(socket, client);
+            }
+        }
+
+        if (descriptors[1].revents & POLLIN)
+        {
+            // The replies themselves are in the queues of the clients, polled for POLLOUT on the next pass
+            while (read(m_Wakeup[0], buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+
+        for (size_t i = 2; i < descriptors.size(); ++i)
+        {
+            if (descriptors[i].revents == 0)
+            {
+                continue;
+            }
+
+            const std::shared_ptr<Client> client = m_Clients[descriptors[i].fd];
+            if (descriptors[i].revents & (POLLIN | POLLERR | POLLHUP))
+            {
+                const ssize_t received = recv(client->m_Socket, buffer, sizeof(buffer), 0);
+                if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    Disconnect(client);
+                }
+                else if (received > 0)
+                {
+                    client->m_Input.append(buffer, received);
+                    size_t end;
+                    while (!client->m_Closed && (end = client->m_Input.find('\n')) != std::string::npos)
+                    {
+                        const std::string line = client->m_Input.substr(0, end);
+                        client->m_Input.erase(0, end + 1);
+                        HandleLine(client, line);
+                    }
+                }
+            }
+
+            // Replies to the requests just read usually fit the socket at once, so they are not left for the next poll
+            if (!client->m_Closed && !Flush(client))
+            {
+                Disconnect(client);
+            }
+
+            if (client->m_Closed)
+            {
+                m_Clients.erase(descriptors[i].fd);
+            }
+        }
+    }
+
+    for (const auto& [socket, client] : m_Clients)
+    {
+        Flush(client);
+        Disconnect(client);
+    }
+    m_Clients.clear();
+    close(server);
+    unlink(m_Config.m_SocketPath.c_str());
+    return 0;
+#else
+    std::cerr << "The engine server needs Unix domain sockets\n";
+    return 1;
+#endif
+}
+
+/**
+ * @brief Runs an engine server until it is interrupted.
+ *
+ * @param config The server settings.
+ * @return The exit code of the process.
+ */
+int EngineServer::Start(const ServerConfig& config)
+{
+    EngineServer server(config);
+    return server.Run();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mancala-engine.h"
+#include "metrics.h"
+#include "persistence-queue.h"
+#include "position-index.h"
+
+/**
+ * @brief Settings of an engine server.
+ */
+struct ServerConfig
+{
+	std::string m_SocketPath = "mancala.sock";
+	int m_Workers = (int)std::max(1u, std::thread::hardware_concurrency());
+	size_t m_TableMegabytes = 256;   // Transposition table shared by every session
+	int m_DefaultTimeLimit = 100;    // Milliseconds per engine move unless a session asks for another
+	int m_MaxTimeLimit = 10000;
+};
+
+/**
+ * @brief Hosts many game sessions in one process and plays engine moves for them.
+ *
+ * Clients connect to a Unix domain socket and talk a line protocol, every request gets one reply line:
+ *
+ *     new [ruleset] [time limit ms]  ->  session <id>
+ *     move <id> <pit>                ->  ok <id>
+ *     go <id>                        ->  bestmove <id> <pit> <depth> <score>   (when the search finishes)
+ *     state <id>                     ->  state <id> <14 pit counts> <turn> <playing|gameover>
+ *     close <id>                     ->  closed <id>
+ *     stats                          ->  stats <key>=<value> ...
+ *     quit                           ->  closes the connection
+ *
+ * Errors are reported as "error <message>". One thread multiplexes every connection with poll and a
+ * fixed pool of worker threads runs the searches, each within its session's time budget. All workers
+ * share one transposition table, one table of exact endgame results and the position cache of
+ * PositionIndex::CACHE_FILE, so every session profits from positions searched for any other. A session
+ * only holds its position and settings, so idle sessions cost a few dozen bytes.
+ */
+class EngineServer
+{
+private:
+	/**
+	 * @brief A game hosted by the server.
+	 */
+	struct Session
+	{
+		State m_State;
+		int m_TimeLimit;
+		unsigned long long m_Client; // Id of the connection that created the session
+		bool m_Busy;   // A search for this session is queued or running
+	};
+
+	/**
+	 * @brief A connected client on a non-blocking socket.
+	 *
+	 * Replies of the workers and of the I/O thread are queued in m_Output under m_OutputMutex and only the
+	 * I/O thread writes them to the socket, when poll reports it writable, so a slow client never blocks
+	 * a worker.
+	 */
+	struct Client
+	{
+		unsigned long long m_Id; // Never reused, unlike the socket
+		int m_Socket;
+		std::string m_Input;     // Bytes received after the last complete line
+		std::mutex m_OutputMutex;
+		std::string m_Output;    // Bytes queued for the socket
+		bool m_Closed = false;
+	};
+
+	/**
+	 * @brief An engine move to search.
+	 */
+	struct SearchJob
+	{
+		unsigned int m_Session;
+		State m_State;
+		int m_TimeLimit;
+		std::shared_ptr<Client> m_Client;
+	};
+
+	ServerConfig m_Config;
+	std::shared_ptr<TranspositionTable> m_Table;
+	std::shared_ptr<TranspositionTable> m_ExactTable;
+
+	std::shared_mutex m_PositionsMutex;
+	std::unordered_map<unsigned long long, char> m_Positions; // Shared position cache
+	PersistenceQueue m_Persistence;
+
+	std::mutex m_SessionsMutex;
+	std::unordered_map<unsigned int, Session> m_Sessions;
+	unsigned int m_NextSession;
+
+	std::unordered_map<int, std::shared_ptr<Client>> m_Clients; // By socket, used by the I/O thread only
+	unsigned long long m_NextClient;
+	int m_Wakeup[2];                                            // Pipe written by Send to wake the I/O thread for queued replies
+
+	std::mutex m_JobsMutex;
+	std::condition_variable m_JobsReady;
+	std::deque<SearchJob> m_Jobs;
+	bool m_Stop;
+	std::vector<std::thread> m_Workers;
+
+	std::chrono::steady_clock::time_point m_Start;
+	MetricCounter& m_Moves;
+	MetricGauge& m_SessionCount;
+	MetricGauge& m_QueuedJobs;
+	LatencyHistogram& m_MoveLatency;
+
+	void WorkerLoop();
+	char SearchMove(Minimax& engine, const State& state, const int& timeLimit, char& reachedDepth, float& score);
+	bool CachedMove(const State& state, const char& depth, char& move);
+	void CacheMove(const State& state, const char& depth, const char& move);
+
+	void HandleLine(const std::shared_ptr<Client>& client, const std::string& line);
+	void Send(const std::shared_ptr<Client>& client, const std::string& line);
+	bool Flush(const std::shared_ptr<Client>& client);
+	void Disconnect(const std::shared_ptr<Client>& client);
+	std::string Stats();
+
+public:
+	static constexpr const char* POSITIONS_FILE = PositionIndex::CACHE_FILE;
+
+	EngineServer(const ServerConfig& config);
+	~EngineServer();
+
+	int Run();
+
+	static int Start(const ServerConfig& config);
+};
@@ -0,0 +1,472 @@
+#include "evaluation-tuner.h"
+#include "task-scheduler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+/**
+ * @brief Runs a function over the index range [0, count) split into one contiguous chunk per thread.
+ *
+ * @param threads Number of threads to use.
+ * @param count Number of items.
+ * @param work Called once per thread with the chunk [begin, end) and the thread index.
+ */
+static void ParallelFor(const int& threads, const size_t& count, const std::function<void(size_t, size_t, int)>& work)
+{
+    std::vector<std::thread> workers;
+    const size_t chunk = (count + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t)
+    {
+        const size_t begin = std::min(count, t * chunk);
+        const size_t end = std::min(count, begin + chunk);
+        workers.emplace_back(work, begin, end, t);
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * @brief Maps an evaluation score to an expected result in [0, 1].
+ */
+static float Sigmoid(const float& scale, const float& score)
+{
+    return 1.0F / (1.0F + std::exp(-scale * score));
+}
+
+/**
+ * @brief Constructs a tuner that starts from the default evaluation weights.
+ *
+ * @param threads Number of threads used for labelling and gradient descent.
+ */
+EvaluationTuner::EvaluationTuner(const int& threads) : m_Threads(std::max(1, threads)), m_Scale(0.1F), m_Weights(Minimax::DefaultWeights())
+{
+}
+
+/**
+ * @brief Reads one game record from an archive file.
+ *
+ * A record is the ruleset byte, the beginning-of-game flag, the moves and the end-of-game flag,
+ * as written by Game::SaveGame.
+ *
+ * @param file The archive file.
+ * @param moves Receives the moves of the game.
+ * @param ruleset Receives the ruleset of the game.
+ * @return True if a complete record was read, false otherwise.
+ */
+bool EvaluationTuner::ReadGame(std::ifstream& file, std::vector<char>& moves, char& ruleset)
+{
+    const char BEGINNING_OF_GAME = (char)0xFE;
+    const char END_OF_GAME = (char)0xFF;
+
+    moves.clear();
+    char flag;
+    if (!file.get(ruleset) || !file.get(flag) || flag != BEGINNING_OF_GAME)
+    {
+        return false;
+    }
+
+    char move;
+    while (file.get(move))
+    {
+        if (move == END_OF_GAME)
+        {
+            return true;
+        }
+        moves.push_back(move);
+    }
+    return false;
+}
+
+/**
+ * @brief Replays every archived game and stores the features and labels of its positions.
+ *
+ * Positions are labelled with the result of their game. When labelDepth is not zero, they are
+ * labelled with the score of a search of that depth instead, mapped through the same sigmoid.
+ *
+ * @param directory The game archive, usually db/games.
+ * @param labelDepth Depth of the labelling search, 0 to label with game results.
+ * @return The number of positions loaded.
+ */
+size_t EvaluationTuner::LoadGames(const std::string& directory, const char& labelDepth)
+{
+    std::vector<State> positions;
+    std::vector<float> results;
+
+    float duration = 0.0;
+    {
+        Timer timer(&duration);
+
+        if (!std::filesystem::exists(directory))
+        {
+            std::cerr << std::format("Cannot find game archive {}\n", directory);
+            return 0;
+        }
+
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.is_regular_file() && entry.path().filename() != "count.dat")
+            {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        std::vector<char> moves;
+        char ruleset;
+        for (const std::filesystem::path& path : files)
+        {
+            std::ifstream file(path, std::ios::binary);
+            while (ReadGame(file, moves, ruleset))
+            {
+                if (moves.empty())
+                {
+                    continue;
+                }
+
+                // The starting player is not recorded, it is the owner of the first pit played
+                State state;
+                state.ChangeRuleset(ruleset);
+                state.ChangeTurn(moves[0] < 6 ? 0 : 1);
+
+                std::vector<State> gamePositions;
+                bool valid = true;
+                for (char move : moves)
+                {
+                    if (state.GameState() == GAMEOVER || !state.IsLegal(move))
+                    {
+                        valid = false;
+                        break;
+                    }
+                    gamePositions.push_back(state);
+                    state.MakeMove(move);
+                }
+
+                if (!valid || state.GameState() != GAMEOVER)
+                {
+                    continue; // Corrupt or unfinished game
+                }
+
+                const float result = state.m_Board[6] > state.m_Board[13] ? 1.0F : (state.m_Board[6] < state.m_Board[13] ? 0.0F : 0.5F);
+                positions.insert(positions.end(), gamePositions.begin(), gamePositions.end());
+                results.insert(results.end(), gamePositions.size(), result);
+            }
+        }
+
+        // Extract the feature matrix, and search the positions when labelling with search scores
+        const size_t firstRow = m_Labels.size();
+        m_Features.resize((firstRow + positions.size()) * FEATURE_COUNT);
+        m_Labels.resize(firstRow + positions.size());
+        std::vector<float> scores(labelDepth > 0 ? positions.size() : 0);
+
+        // Searches vary widely in cost, so the positions are replayed in small tasks of a work-stealing scheduler
+        constexpr size_t CHUNK = 64;
+        TaskScheduler scheduler({ m_Threads, false });
+        std::vector<std::unique_ptr<Minimax>> engines(scheduler.Threads()); // One per worker, created on first use
+        for (size_t begin = 0; begin < positions.size(); begin += CHUNK)
+        {
+            scheduler.Submit([&, begin]()
+                {
+                    std::unique_ptr<Minimax>& engine = engines[TaskScheduler::WorkerIndex()];
+                    if (labelDepth > 0 && !engine)
+                    {
+                        engine = std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16));
+                    }
+
+                    for (size_t i = begin; i < std::min(positions.size(), begin + CHUNK); ++i)
+                    {
+                        Minimax::Features(positions[i], &m_Features[(firstRow + i) * FEATURE_COUNT]);
+                        m_Labels[firstRow + i] = results[i];
+                        if (engine)
+                        {
+                            scores[i] = engine->Search(positions[i], labelDepth - 1).m_Score;
+                        }
+                    }
+                });
+        }
+        scheduler.Wait();
+
+        // Search scores are turned into labels with the scale that fits the game results best
+        if (labelDepth > 0)
+        {
+            FitScale();
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                m_Labels[firstRow + i] = Sigmoid(m_Scale, scores[i]);
+            }
+        }
+    }
+
+    std::cout << std::format("loaded {} positions in {} ms ({} positions/s)\n", positions.size(), duration,
+        (long long)(positions.size() / std::max(duration * 0.001F, 0.001F)));
+    return positions.size();
+}
+
+/**
+ * @brief Computes the mean squared error between the labels and the predicted results.
+ *
+ * @param weights The evaluation weights to predict with.
+ * @param scale The sigmoid scale K.
+ * @return The mean squared error over all loaded positions.
+ */
+float EvaluationTuner::Error(const EvaluationWeights& weights, const float& scale) const
+{
+    std::vector<double> partialErrors(m_Threads, 0.0);
+    ParallelFor(m_Threads, m_Labels.size(), [&](size_t begin, size_t end, int thread)
+        {
+            TraceZone zone("evaluation batch");
+            double error = 0.0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                const float* features = &m_Features[i * FEATURE_COUNT];
+                float score = 0.0F;
+                for (int j = 0; j < FEATURE_COUNT; ++j)
+                {
+                    score += weights.m_Weights[j] * features[j];
+                }
+                const double difference = Sigmoid(scale, score) - m_Labels[i];
+                error += difference * difference;
+            }
+            partialErrors[thread] = error;
+        });
+
+    double error = 0.0;
+    for (double partialError : partialErrors)
+    {
+        error += partialError;
+    }
+    return m_Labels.empty() ? 0.0F : (float)(error / m_Labels.size());
+}
+
+/**
+ * @brief Computes the gradient of the mean squared error with respect to every weight.
+ *
+ * @param weights The evaluation weights to differentiate at.
+ * @param gradient Receives FEATURE_COUNT partial derivatives.
+ */
+void EvaluationTuner::Gradient(const EvaluationWeights& weights, double* gradient) const
+{
+    std::vector<double> partialGradients(m_Threads * FEATURE_COUNT, 0.0);
+    ParallelFor(m_Threads, m_Labels.size(), [&](size_t begin, size_t end, int thread)
+        {
+            TraceZone zone("gradient batch");
+            double* partialGradient = &partialGradients[thread * FEATURE_COUNT];
+            for (size_t i = begin; i < end; ++i)
+            {
+                const float* features = &m_Features[i * FEATURE_COUNT];
+                float score = 0.0F;
+                for (int j = 0; j < FEATURE_COUNT; ++j)
+                {
+                    score += weights.m_Weights[j] * features[j];
+                }
+                const float prediction = Sigmoid(m_Scale, score);
+                const double factor = 2.0 * (prediction - m_Labels[i]) * prediction * (1.0F - prediction) * m_Scale;
+                for (int j = 0; j < FEATURE_COUNT; ++j)
+                {
+                    partialGradient[j] += factor * features[j];
+                }
+            }
+        });
+
+    for (int j = 0; j < FEATURE_COUNT; ++j)
+    {
+        gradient[j] = 0.0;
+        for (int t = 0; t < m_Threads; ++t)
+        {
+            gradient[j] += partialGradients[t * FEATURE_COUNT + j];
+        }
+        gradient[j] /= std::max<size_t>(1, m_Labels.size());
+    }
+}
+
+/**
+ * @brief Finds the sigmoid scale K that makes the current weights fit the labels best.
+ */
+void EvaluationTuner::FitScale()
+{
+    float bestError = Error(m_Weights, m_Scale);
+    for (float step = 0.1F; step >= 0.0001F; step *= 0.1F)
+    {
+        bool improved = true;
+        while (improved)
+        {
+            improved = false;
+            for (float candidate : { m_Scale - step, m_Scale + step })
+            {
+                if (candidate <= 0.0F)
+                {
+                    continue;
+                }
+                const float error = Error(m_Weights, candidate);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    m_Scale = candidate;
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fits the weights with Adam gradient descent.
+ *
+ * @param epochs Number of passes over the loaded positions.
+ * @param learningRate Step size of the optimizer.
+ * @return The mean squared error after tuning.
+ */
+float EvaluationTuner::Tune(const int& epochs, const float& learningRate)
+{
+    if (m_Labels.empty())
+    {
+        return 0.0F;
+    }
+
+    FitScale();
+    std::cout << std::format("scale: {} initial error: {}\n", m_Scale, Error(m_Weights, m_Scale));
+
+    double gradient[FEATURE_COUNT];
+    double firstMoment[FEATURE_COUNT] = {};
+    double secondMoment[FEATURE_COUNT] = {};
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+
+    float duration = 0.0;
+    {
+        Timer timer(&duration);
+        for (int epoch = 1; epoch <= epochs; ++epoch)
+        {
+            Gradient(m_Weights, gradient);
+            for (int j = 0; j < FEATURE_COUNT; ++j)
+            {
+                firstMoment[j] = beta1 * firstMoment[j] + (1 - beta1) * gradient[j];
+                secondMoment[j] = beta2 * secondMoment[j] + (1 - beta2) * gradient[j] * gradient[j];
+                const double correctedFirst = firstMoment[j] / (1 - std::pow(beta1, epoch));
+                const double correctedSecond = secondMoment[j] / (1 - std::pow(beta2, epoch));
+                m_Weights.m_Weights[j] -= (float)(learningRate * correctedFirst / (std::sqrt(correctedSecond) + epsilon));
+            }
+
+            if (epoch % 100 == 0 || epoch == epochs)
+            {
+                std::cout << std::format("epoch: {} error: {}\n", epoch, Error(m_Weights, m_Scale));
+            }
+        }
+    }
+
+    const double throughput = (double)m_Labels.size() * epochs / std::max(duration * 0.001, 0.001);
+    std::cout << std::format("tuned {} epochs in {} ms ({} positions/s)\n", epochs, duration, (long long)throughput);
+    return Error(m_Weights, m_Scale);
+}
+
+/**
+ * @brief Returns the weights found by the tuner.
+ *
+ * @return The tuned evaluation weights.
+ */
+const EvaluationWeights& EvaluationTuner::GetWeights() const
+{
+    return m_Weights;
+}
+
+/**
+ * @brief Plays fixed-depth games between two sets of weights.
+ *
+ * Every game starts from a different two-move opening and is played twice with colors reversed.
+ *
+ * @param candidate The weights being measured.
+ * @param baseline The weights to compare against.
+ * @param games Number of openings, each one is played twice.
+ * @param depth Search depth of both engines.
+ * @param threads Number of games played at the same time.
+ * @return The score of the candidate in [0, 1], 0.5 means equal strength.
+ */
+float EvaluationTuner::Match(const EvaluationWeights& candidate, const EvaluationWeights& baseline, const int& games, const char& depth, const int& threads)
+{
+    // Collect the two-move openings of the classical ruleset
+    std::vector<State> openings;
+    {
+        State start;
+        for (char first : start.LegalMoves())
+        {
+            State afterFirst = start.NextState(first);
+            for (char second : afterFirst.LegalMoves())
+            {
+                openings.push_back(afterFirst.NextState(second));
+            }
+        }
+    }
+
+    std::atomic<int> next(0);
+    std::atomic<int> points(0); // Half points of the candidate
+    const int count = std::min<int>(games, (int)openings.size());
+
+    ParallelFor(std::max(1, threads), std::max(1, threads), [&](size_t, size_t, int)
+        {
+            Minimax candidateEngine(std::make_shared<TranspositionTable>(16)); // Tables are not shared, the weights differ
+            Minimax baselineEngine(std::make_shared<TranspositionTable>(16));
+            candidateEngine.SetWeights(candidate);
+            baselineEngine.SetWeights(baseline);
+
+            for (int game = next++; game < 2 * count; game = next++)
+            {
+                State state = openings[game / 2];
+                const char candidatePlayer = game % 2;
+                while (state.GameState() != GAMEOVER)
+                {
+                    Minimax& engine = state.m_Turn == candidatePlayer ? candidateEngine : baselineEngine;
+                    state.MakeMove(engine.BestMove(state, depth));
+                }
+
+                const char candidateStore = candidatePlayer == 0 ? 6 : 13;
+                const char baselineStore = candidatePlayer == 0 ? 13 : 6;
+                points += state.m_Board[candidateStore] > state.m_Board[baselineStore] ? 2 : (state.m_Board[candidateStore] == state.m_Board[baselineStore] ? 1 : 0);
+            }
+        });
+
+    return count == 0 ? 0.5F : points / (4.0F * count);
+}
+
+/**
+ * @brief Tunes the weights on db/games, writes them to settings/eval_weights.dat and measures the result.
+ *
+ * @param threads Number of threads to use.
+ * @param epochs Number of gradient descent epochs.
+ * @param labelDepth Depth of the labelling search, 0 to label with game results.
+ */
+void EvaluationTuner::Start(const int& threads, const int& epochs, const char& labelDepth)
+{
+    Minimax::LoadDefaultWeights("./settings/eval_weights.dat");
+
+    EvaluationTuner tuner(threads);
+    if (tuner.LoadGames("./db/games", labelDepth) == 0)
+    {
+        std::cout << "No positions to tune on, play some games first\n";
+        return;
+    }
+
+    const float error = tuner.Tune(epochs);
+    const EvaluationWeights& weights = tuner.GetWeights();
+
+    std::cout << "weights:";
+    for (int j = 0; j < FEATURE_COUNT; ++j)
+    {
+        std::cout << " " << weights.m_Weights[j];
+    }
+    std::cout << std::format("\nfinal error: {}\n", error);
+
+    std::filesystem::create_directory("settings");
+    if (weights.Save("./settings/eval_weights.dat"))
+    {
+        std::cout << "weights saved to settings/eval_weights.dat\n";
+    }
+
+    // Measure playing strength against the built-in weights
+    const float score = Match(weights, EvaluationWeights(), 18, 4, threads);
+    std::cout << std::format("match score against built-in weights: {}%\n", score * 100.0F);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mancala-engine.h"
+
+/**
+ * @brief Fits the evaluation weights to recorded games (Texel tuning).
+ *
+ * Positions are replayed from the game archive and labelled with the result of their game, or with
+ * the score of a deeper search. The weights are then fitted by minimizing the squared error between
+ * the label and sigmoid(K * evaluation), using multi-threaded gradient descent over a feature matrix
+ * that is extracted once and kept in memory.
+ */
+class EvaluationTuner
+{
+private:
+	int m_Threads;
+	float m_Scale;                 // K in sigmoid(K * evaluation)
+	std::vector<float> m_Features; // FEATURE_COUNT values per position, row by row
+	std::vector<float> m_Labels;   // Expected result for player 1 in [0, 1]
+	EvaluationWeights m_Weights;
+
+	float Error(const EvaluationWeights& weights, const float& scale) const;
+	void Gradient(const EvaluationWeights& weights, double* gradient) const;
+	void FitScale();
+
+public:
+	EvaluationTuner(const int& threads);
+
+	size_t LoadGames(const std::string& directory, const char& labelDepth = 0);
+	float Tune(const int& epochs, const float& learningRate = 0.01F);
+	const EvaluationWeights& GetWeights() const;
+
+	static bool ReadGame(std::ifstream& file, std::vector<char>& moves, char& ruleset);
+	static float Match(const EvaluationWeights& candidate, const EvaluationWeights& baseline, const int& games, const char& depth, const int& threads);
+	static void Start(const int& threads, const int& epochs, const char& labelDepth);
+};
@@ -0,0 +1,259 @@
+#include "game-annotator.h"
+#include "evaluation-tuner.h"
+#include "search-handle.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Constructs an annotator; the output directory is created when missing.
+ *
+ * @param config Settings of the run.
+ */
+GameAnnotator::GameAnnotator(const AnnotatorConfig& config)
+    : m_Config(config), m_FileCount(0), m_FilesDone(0), m_Games(0), m_Positions(0), m_Nodes(0)
+{
+    if (m_Config.m_Threads <= 0)
+    {
+        m_Config.m_Threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::filesystem::create_directories(m_Config.m_OutputDirectory);
+}
+
+/**
+ * @brief Creates the search state of one worker thread.
+ *
+ * @param tableSize Megabytes of the worker's transposition table.
+ */
+GameAnnotator::WorkerContext::WorkerContext(const size_t& tableSize) : m_Engine(std::make_shared<TranspositionTable>(tableSize))
+{
+}
+
+/**
+ * @brief Annotates every archive file that has no up-to-date sidecar yet.
+ *
+ * @return The number of files annotated.
+ */
+size_t GameAnnotator::Run()
+{
+    std::error_code error;
+    if (!std::filesystem::exists(m_Config.m_Directory, error))
+    {
+        std::cerr << std::format("Cannot find game archive {}\n", m_Config.m_Directory);
+        return 0;
+    }
+
+    std::vector<std::filesystem::path> files;
+    size_t skipped = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(m_Config.m_Directory))
+    {
+        if (!entry.is_regular_file() || entry.path().filename() == "count.dat" || entry.path().extension() != ".dat")
+        {
+            continue;
+        }
+        if (IsAnnotated(entry.path()))
+        {
+            skipped++;
+            continue;
+        }
+        files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    m_FileCount = files.size();
+    std::cout << std::format("annotating {} files ({} already annotated) on {} threads, {} nodes per position\n",
+        files.size(), skipped, m_Config.m_Threads, m_Config.m_NodeLimit);
+
+    m_Start = std::chrono::steady_clock::now();
+    {
+        TaskScheduler scheduler({ m_Config.m_Threads, false });
+        std::vector<std::unique_ptr<WorkerContext>> contexts;
+        for (int worker = 0; worker < scheduler.Threads(); ++worker)
+        {
+            contexts.push_back(std::make_unique<WorkerContext>(m_Config.m_TableSize));
+        }
+
+        for (const std::filesystem::path& file : files)
+        {
+            scheduler.Submit([this, &file, &contexts]() { AnnotateFile(file, *contexts[TaskScheduler::WorkerIndex()]); });
+        }
+        scheduler.Wait();
+    }
+    return files.size();
+}
+
+/**
+ * @brief Returns the sidecar file the annotations of an archive file are written to.
+ */
+std::filesystem::path GameAnnotator::SidecarPath(const std::filesystem::path& gameFile) const
+{
+    std::filesystem::path sidecar = std::filesystem::path(m_Config.m_OutputDirectory) / gameFile.filename();
+    sidecar.replace_extension(".ann");
+    return sidecar;
+}
+
+/**
+ * @brief Checks whether an archive file was annotated after it was last written.
+ */
+bool GameAnnotator::IsAnnotated(const std::filesystem::path& gameFile) const
+{
+    std::error_code error;
+    const std::filesystem::path sidecar = SidecarPath(gameFile);
+    const auto annotated = std::filesystem::last_write_time(sidecar, error);
+    if (error)
+    {
+        return false;
+    }
+    const auto written = std::filesystem::last_write_time(gameFile, error);
+    return !error && annotated >= written;
+}
+
+/**
+ * @brief Annotates every game of an archive file and writes its sidecar.
+ *
+ * @param gameFile The archive file.
+ * @param context The search state of the calling worker.
+ */
+void GameAnnotator::AnnotateFile(const std::filesystem::path& gameFile, WorkerContext& context)
+{
+    std::ifstream file(gameFile, std::ios::binary);
+    std::string output = "# ply turn move best-move best-score played-score drop\n";
+    std::vector<char> moves;
+    char ruleset;
+    size_t games = 0;
+    while (EvaluationTuner::ReadGame(file, moves, ruleset))
+    {
+        output += std::format("game {} ruleset {}", games++, (int)ruleset);
+        if (!AnnotateGame(moves, ruleset, context, output))
+        {
+            output += " invalid\n";
+        }
+    }
+    m_Games.fetch_add(games, std::memory_order_relaxed);
+
+    // Written under a temporary name, so an interrupted run never leaves a sidecar that looks complete
+    const std::filesystem::path sidecar = SidecarPath(gameFile);
+    const std::filesystem::path temporary = std::filesystem::path(sidecar).concat(".tmp");
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out << output;
+        if (!out)
+        {
+            std::cerr << std::format("Could not write {}\n", temporary.string());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, sidecar, error);
+
+    const double seconds = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count());
+    std::lock_guard<std::mutex> lock(m_OutputMutex);
+    std::cout << std::format("[{}/{}] {}: {} games, {:.0f} positions/s, {:.0f} nodes/s\n", ++m_FilesDone, m_FileCount,
+        gameFile.filename().string(), games, m_Positions.load() / seconds, m_Nodes.load() / seconds);
+}
+
+/**
+ * @brief Replays one game and appends the annotation of every move.
+ *
+ * A move's drop is how much worse, from the mover's point of view, the position it leads to scores than
+ * the best move does. It is clamped to [0, MAX_DROP], as a search of the position after the move can
+ * find slightly more than the search of the position before it did.
+ *
+ * @param moves The moves of the game.
+ * @param ruleset The ruleset of the game.
+ * @param context The search state of the calling worker.
+ * @param output Receives the rest of the game line and one line per move.
+ * @return True if the game was replayed, false if it holds an illegal move.
+ */
+bool GameAnnotator::AnnotateGame(const std::vector<char>& moves, const char& ruleset, WorkerContext& context, std::string& output)
+{
+    if (moves.empty())
+    {
+        return false;
+    }
+
+    // The starting player is not recorded, it is the owner of the first pit played
+    State state;
+    state.ChangeRuleset(ruleset);
+    state.ChangeTurn(moves[0] < 6 ? 0 : 1);
+
+    // Positions of one game share most of their subtrees, positions of other games hardly any
+    context.m_Engine.GetTranspositionTable()->Clear();
+
+    std::string lines;
+    float loss[2] = { 0.0F, 0.0F };
+    SearchResult current = Analyze(state, context);
+    for (size_t ply = 0; ply < moves.size(); ++ply)
+    {
+        const char move = moves[ply];
+        if (state.GameState() == GAMEOVER || !state.IsLegal(move))
+        {
+            return false;
+        }
+
+        const State next = state.NextState(move);
+        SearchResult following;
+        float playedScore = current.m_Score;
+        if (next.GameState() == GAMEOVER)
+        {
+            following.m_Score = context.m_Engine.StaticEvaluation(next);
+        }
+        else
+        {
+            following = Analyze(next, context);
+        }
+        if (move != current.m_BestMove)
+        {
+            playedScore = following.m_Score;
+        }
+
+        const float difference = state.m_Turn == 0 ? current.m_Score - playedScore : playedScore - current.m_Score;
+        const float drop = std::clamp(difference, 0.0F, MAX_DROP);
+        loss[(int)state.m_Turn] += drop;
+        lines += std::format("{} {} {} {} {} {} {}\n", ply, (int)state.m_Turn, (int)move, (int)current.m_BestMove, current.m_Score, playedScore, drop);
+
+        state = next;
+        current = following;
+    }
+
+    output += std::format(" moves {} loss {} {}\n", moves.size(), loss[0], loss[1]);
+    output += lines;
+    return true;
+}
+
+/**
+ * @brief Searches a position by iterative deepening until the node budget stops it.
+ *
+ * @param state The position, not over.
+ * @param context The search state of the calling worker.
+ * @return The result of the deepest completed iteration, with the nodes of every iteration.
+ */
+SearchResult GameAnnotator::Analyze(const State& state, WorkerContext& context)
+{
+    SearchOptions options;
+    options.m_MaxDepth = m_Config.m_MaxDepth;
+    options.m_NodeLimit = m_Config.m_NodeLimit;
+    const SearchResult result = SearchHandle::Search(context.m_Engine, state, options);
+
+    m_Positions.fetch_add(1, std::memory_order_relaxed);
+    m_Nodes.fetch_add(result.m_Nodes, std::memory_order_relaxed);
+    return result;
+}
+
+/**
+ * @brief Annotates the archive and reports the throughput of the run.
+ *
+ * @param config Settings of the run.
+ */
+void GameAnnotator::Start(const AnnotatorConfig& config)
+{
+    GameAnnotator annotator(config);
+    const size_t files = annotator.Run();
+
+    const double seconds = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - annotator.m_Start).count());
+    std::cout << std::format("annotated {} files, {} games, {} positions in {:.1f} s ({:.0f} positions/s, {:.0f} nodes/s) to {}\n",
+        files, annotator.m_Games.load(), annotator.m_Positions.load(), seconds, annotator.m_Positions.load() / seconds,
+        annotator.m_Nodes.load() / seconds, annotator.m_Config.m_OutputDirectory);
+}
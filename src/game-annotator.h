@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mancala-engine.h"
+#include "task-scheduler.h"
+
+/**
+ * @brief Settings of an annotation run.
+ */
+struct AnnotatorConfig
+{
+	unsigned long long m_NodeLimit = 200000;     // Per-position node budget of iterative deepening
+	char m_MaxDepth = 30;                        // Deepening stops here even when nodes are left
+	int m_Threads = 0;                           // Search threads, 0 for one per core
+	size_t m_TableSize = 16;                     // Megabytes of every worker's transposition table
+	std::string m_Directory = "db/games";
+	std::string m_OutputDirectory = "db/annotations";
+};
+
+/**
+ * @brief Annotates every move of the archived games with the score it gave away.
+ *
+ * Every archive file is one task of a work-stealing scheduler. Its games are replayed move by move and
+ * every position is searched by iterative deepening until the node budget is spent. A worker keeps one
+ * engine and clears its transposition table when a game starts, so the search of a position reuses the
+ * work done on the previous positions of the same game. The score of the played move is the score of
+ * the position it leads to, which is searched next anyway, so every position is searched once.
+ *
+ * The annotations of an archive file go to a text sidecar file of the same name in the output directory,
+ * written to a temporary file and renamed once complete. A file whose sidecar is newer than the file
+ * itself is skipped, so an interrupted run continues where it stopped.
+ */
+class GameAnnotator
+{
+private:
+	static constexpr float MAX_DROP = 48.0F; // Drops that change the result are counted as every stone on the board
+
+	/**
+	 * @brief The search state a worker thread keeps across the files it annotates.
+	 */
+	struct WorkerContext
+	{
+		Minimax m_Engine;
+
+		WorkerContext(const size_t& tableSize);
+	};
+
+	AnnotatorConfig m_Config;
+	size_t m_FileCount;                            // Files that need annotating
+	std::atomic<size_t> m_FilesDone;
+	std::atomic<unsigned long long> m_Games;
+	std::atomic<unsigned long long> m_Positions;
+	std::atomic<unsigned long long> m_Nodes;
+	std::mutex m_OutputMutex;                      // Serializes progress lines
+	std::chrono::steady_clock::time_point m_Start;
+
+	std::filesystem::path SidecarPath(const std::filesystem::path& gameFile) const;
+	bool IsAnnotated(const std::filesystem::path& gameFile) const;
+	void AnnotateFile(const std::filesystem::path& gameFile, WorkerContext& context);
+	bool AnnotateGame(const std::vector<char>& moves, const char& ruleset, WorkerContext& context, std::string& output);
+	SearchResult Analyze(const State& state, WorkerContext& context);
+
+public:
+	GameAnnotator(const AnnotatorConfig& config);
+
+	size_t Run();
+
+	static void Start(const AnnotatorConfig& config);
+};
@@ -0,0 +1,214 @@
+#include "game-config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const GameConfig::Field GameConfig::FIELDS[5] = {
+    { "ruleset", "default_ruleset.dat", &GameConfig::m_Ruleset, 0, 1 },
+    { "time_limit", "minimax_time_limit.dat", &GameConfig::m_TimeLimit, 1, GameConfig::MAX_TIME_LIMIT },
+    { "opening_move_allowed", "opening_move_permission.dat", &GameConfig::m_OpeningMoveAllowed, 0, 1 },
+    { "ponder", "ponder.dat", &GameConfig::m_Ponder, 0, 1 },
+    { "show_evaluation", "show_evaluation.dat", &GameConfig::m_ShowEvaluation, 0, 1 },
+};
+
+std::vector<std::string> GameConfig::s_Overrides;
+
+/**
+ * @brief Sets a setting if the value is within its range.
+ *
+ * @return True if the value was set, false otherwise.
+ */
+bool GameConfig::Assign(GameConfig& config, const Field& field, const int& value)
+{
+    if (value < field.m_Min || value > field.m_Max)
+    {
+        return false;
+    }
+    config.*field.m_Value = value;
+    return true;
+}
+
+/**
+ * @brief Loads the settings file; settings it does not hold or holds out of range keep their current values.
+ *
+ * Where the file can be mapped the settings are read straight from the mapping instead of being copied
+ * out of it first.
+ *
+ * @param filename The settings file.
+ * @return True if the file exists and is a settings file, false otherwise.
+ */
+bool GameConfig::Load(const std::string& filename)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(Header))
+    {
+        close(file);
+        return false;
+    }
+    void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    const bool loaded = Parse((const char*)mapping, (size_t)status.st_size);
+    munmap(mapping, status.st_size);
+    return loaded;
+#else
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Parse(contents.data(), contents.size());
+#endif
+}
+
+/**
+ * @brief Reads the settings from the contents of a settings file.
+ *
+ * @param data The contents.
+ * @param size Number of bytes of the contents.
+ * @return True if the contents are a settings file, false otherwise.
+ */
+bool GameConfig::Parse(const char* data, const size_t& size)
+{
+    Header header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.m_Magic, MAGIC, sizeof(MAGIC)) != 0 || header.m_Version < 1 || header.m_Size < 0)
+    {
+        return false;
+    }
+
+    const size_t available = std::min(size - sizeof(header), (size_t)header.m_Size) / sizeof(int);
+    for (size_t i = 0; i < std::min(available, std::size(FIELDS)); ++i)
+    {
+        int value;
+        std::memcpy(&value, data + sizeof(header) + i * sizeof(int), sizeof(int));
+        Assign(*this, FIELDS[i], value);
+    }
+    return true;
+}
+
+/**
+ * @brief Loads the one-file-per-setting files that preceded the settings file.
+ *
+ * @param directory Directory of the old files.
+ * @return True if any of them was found. Values out of range are ignored.
+ */
+bool GameConfig::LoadLegacy(const std::string& directory)
+{
+    bool found = false;
+    for (const Field& field : FIELDS)
+    {
+        std::ifstream file(std::filesystem::path(directory) / field.m_LegacyFile, std::ios::binary);
+        int value;
+        if (file.read((char*)&value, sizeof(value)))
+        {
+            Assign(*this, field, value);
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Returns the contents of the settings file for these settings.
+ */
+std::string GameConfig::Serialize() const
+{
+    Header header;
+    std::memcpy(header.m_Magic, MAGIC, sizeof(MAGIC));
+    header.m_Version = VERSION;
+    header.m_Size = (int)(std::size(FIELDS) * sizeof(int));
+
+    std::string contents((const char*)&header, sizeof(header));
+    for (const Field& field : FIELDS)
+    {
+        contents.append((const char*)&(this->*field.m_Value), sizeof(int));
+    }
+    return contents;
+}
+
+/**
+ * @brief Changes one setting.
+ *
+ * @param assignment The setting as `<key>=<value>`, such as `time_limit=250`.
+ * @return True if the key is a setting and the value an integer in its range, false otherwise.
+ */
+bool GameConfig::Set(const std::string& assignment)
+{
+    const size_t separator = assignment.find('=');
+    if (separator == std::string::npos)
+    {
+        return false;
+    }
+    const std::string key = assignment.substr(0, separator);
+    const std::string value = assignment.substr(separator + 1);
+    for (const Field& field : FIELDS)
+    {
+        if (key != field.m_Key)
+        {
+            continue;
+        }
+        try
+        {
+            size_t end;
+            const int parsed = std::stoi(value, &end);
+            return end == value.size() && Assign(*this, field, parsed);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Applies the overrides given on the command line.
+ */
+void GameConfig::ApplyOverrides()
+{
+    for (const std::string& assignment : s_Overrides)
+    {
+        Set(assignment);
+    }
+}
+
+/**
+ * @brief Records an override for every session of this run; call before sessions are created.
+ *
+ * @param assignment The setting as `<key>=<value>`.
+ * @return True if the override is valid, false otherwise.
+ */
+bool GameConfig::AddOverride(const std::string& assignment)
+{
+    GameConfig check;
+    if (!check.Set(assignment))
+    {
+        return false;
+    }
+    s_Overrides.push_back(assignment);
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Settings of a game session, stored as one versioned binary file.
+ *
+ * The file starts with a header of the magic, the version that wrote it and the number of setting
+ * bytes that follow, then holds the settings as 32-bit integers in the order of the members below.
+ * Settings are only ever appended, so a file written by an older version loads with the defaults for
+ * the settings it lacks, and a newer file loads the settings this version knows.
+ *
+ * Every setting has a valid range. Values outside it are rejected by Set and ignored when loading, so a
+ * damaged or hand-edited file never reaches the engine.
+ *
+ * Settings can be overridden for one run with `mancala --set <key>=<value>`; overrides are applied when
+ * a session loads its settings and are never written back.
+ */
+struct GameConfig
+{
+    static constexpr char MAGIC[4] = { 'M', 'C', 'F', 'G' };
+    static constexpr int VERSION = 1;
+    static constexpr const char* FILE = "settings/config.dat";
+    static constexpr int MAX_TIME_LIMIT = 60000;
+
+    int m_Ruleset = 0;            // 0 classical, 1 Turkish
+    int m_TimeLimit = 100;        // Minimax time limit in milliseconds, 1 to MAX_TIME_LIMIT
+    int m_OpeningMoveAllowed = 0; // Whether the 2-5 opening is allowed
+    int m_Ponder = 1;             // Search on the player's time
+    int m_ShowEvaluation = 1;     // Print the score and principal variation after AI moves
+
+    bool Load(const std::string& filename);
+    bool LoadLegacy(const std::string& directory);
+    std::string Serialize() const;
+    bool Set(const std::string& assignment);
+    void ApplyOverrides();
+
+    static bool AddOverride(const std::string& assignment);
+
+private:
+    /**
+     * @brief Header of the settings file.
+     */
+    struct Header
+    {
+        char m_Magic[4];
+        int m_Version;
+        int m_Size; // Bytes of settings after the header
+    };
+
+    /**
+     * @brief A setting, in the order of the file.
+     */
+    struct Field
+    {
+        const char* m_Key;        // Name used by overrides
+        const char* m_LegacyFile; // File the setting was stored in before the settings file
+        int GameConfig::* m_Value;
+        int m_Min;                // Smallest valid value
+        int m_Max;                // Largest valid value
+    };
+
+    static const Field FIELDS[5];
+    static std::vector<std::string> s_Overrides;
+
+    bool Parse(const char* data, const size_t& size);
+
+    static bool Assign(GameConfig& config, const Field& field, const int& value);
+};
@@ -4,86 +4,102 @@
 // if you are on windows change "clear" to "cls"
 #define CLEAR_COMMAND "clear"
 
-Game::Game()
+/**
+ * @brief The metrics GetAIMove updates on every engine move, registered once.
+ */
+struct EngineMoveMetrics
+{
+    LatencyHistogram& m_MoveLatency = Metrics::Histogram("mancala_move_latency_seconds", "Time the engine took to choose a move.");
+    MetricCounter& m_Moves = Metrics::Counter("mancala_moves_total", "Moves played by the engine.");
+    MetricCounter& m_Nodes = Metrics::Counter("mancala_search_nodes_total", "Positions searched for engine moves.");
+    MetricGauge& m_Depth = Metrics::Gauge("mancala_search_depth", "Depth reached by the last engine move.");
+    MetricGauge& m_NodesPerSecond = Metrics::Gauge("mancala_search_nodes_per_second", "Search speed of the last engine move.");
+    MetricCounter& m_CacheLookups = Metrics::Counter("mancala_position_cache_lookups_total", "Position cache lookups of engine moves.");
+    MetricCounter& m_CacheHits = Metrics::Counter("mancala_position_cache_hits_total", "Engine moves answered by the position cache.");
+};
+
+static EngineMoveMetrics& GetEngineMoveMetrics()
+{
+    static EngineMoveMetrics metrics;
+    return metrics;
+}
+
+Game::Game() : Game(true)
+{
+}
+
+/**
+ * @brief Creates a session with the saved settings and the game archive loaded.
+ *
+ * @param interactive Shows the menu when true; load tests drive a session without one.
+ * @param directory Directory of the settings, cache and archive files, so concurrent sessions can keep apart.
+ */
+Game::Game(const bool& interactive, const std::filesystem::path& directory) : m_Engine(Minimax::SessionTable()), m_Directory(directory)
 {
     m_Player1 = MINIMAX;
     m_Player2 = MINIMAX;
     m_State = new State();
 
-    cnf_RULESET = 0;              // Classical ruleset
-    cnf_TIME_LIMIT = 100;         // 100ms
-    cnf_OPENING_MOVE_ALLOWED = 0; // Allow
-
+    LoadDatabase();
     ReadSettings();
+    if (interactive)
+    {
+        Menu();
+    }
 }
 
 Game::~Game()
 {
-    // Add any necessary cleanup code here
+    StopPondering();
+    delete m_State;
 }
 
-void Game::ReadSettings()
+/**
+ * @brief Returns the path of a settings, cache or archive file of this session.
+ *
+ * @param file The path relative to the session directory.
+ */
+std::string Game::Path(const std::string& file) const
 {
+    return (m_Directory / file).string();
+}
 
-    // Ruleset settings [Classical, Turkish]
+/**
+ * @brief Loads the settings file and applies the command line overrides.
+ *
+ * A missing settings file is created once from the defaults, or from the one-file-per-setting files of
+ * earlier versions when they are present.
+ */
+void Game::ReadSettings()
+{
     {
-        std::ifstream configFile;
-        configFile.open("./settings/default_ruleset.dat", std::ios::binary);
-
-        if (!configFile)
+        TraceZone zone("load settings");
+        if (!m_Config.Load(Path(GameConfig::FILE)))
         {
-            std::ofstream _configFile;
-            std::filesystem::create_directory("settings");
-            _configFile.open("./settings/default_ruleset.dat", std::ios::binary);
-            _configFile.write((char *)&cnf_RULESET, sizeof(cnf_RULESET));
-            _configFile.close();
-        }
-        else
-        {
-            configFile.read((char *)&cnf_RULESET, sizeof(cnf_RULESET));
-            configFile.close();
+            m_Config.LoadLegacy(Path("settings"));
+            SaveSettings();
         }
+
+        GameConfig session = m_Config;
+        session.ApplyOverrides();
+        cnf_RULESET = session.m_Ruleset;
+        cnf_TIME_LIMIT = session.m_TimeLimit;
+        cnf_OPENING_MOVE_ALLOWED = session.m_OpeningMoveAllowed;
+        cnf_PONDER = session.m_Ponder;
+        cnf_SHOW_EVALUATION = session.m_ShowEvaluation;
     }
 
-    // Minimax algorithm timeout: default 100ms
+    // Evaluation weights written by the tuner, the built-in weights are kept when missing
+    if (Minimax::LoadDefaultWeights(Path("settings/eval_weights.dat")))
     {
-        std::ifstream configFile;
-        configFile.open("./settings/minimax_time_limit.dat", std::ios::binary);
-
-        if (!configFile)
-        {
-            std::ofstream _configFile;
-            _configFile.open("./settings/minimax_time_limit.dat", std::ios::binary);
-            _configFile.write((char *)&cnf_TIME_LIMIT, sizeof(cnf_TIME_LIMIT));
-            _configFile.close();
-        }
-        else
-        {
-            configFile.read((char *)&cnf_TIME_LIMIT, sizeof(cnf_TIME_LIMIT));
-            configFile.close();
-        }
+        m_Engine.SetWeights(Minimax::DefaultWeights());
     }
 
-    // There is particular opening move in classical mancala that gives unfair advantage to the player. User can block this opening.
+    // Network evaluator written by the trainer, replaces the evaluation weights when present
+    if (Minimax::LoadDefaultNetwork(Path("settings/network.dat")))
     {
-        std::ifstream configFile;
-        configFile.open("./settings/opening_move_permission.dat", std::ios::binary);
-
-        if (!configFile)
-        {
-            std::ofstream _configFile;
-            _configFile.open("./settings/opening_move_permission.dat", std::ios::binary);
-            _configFile.write((char *)&cnf_OPENING_MOVE_ALLOWED, sizeof(cnf_OPENING_MOVE_ALLOWED));
-            _configFile.close();
-        }
-        else
-        {
-            configFile.read((char *)&cnf_OPENING_MOVE_ALLOWED, sizeof(cnf_OPENING_MOVE_ALLOWED));
-            configFile.close();
-        }
+        m_Engine.SetNetwork(Minimax::DefaultNetwork());
     }
-
-    Menu();
 }
 
 void Game::Menu()
@@ -157,6 +173,7 @@ void Game::Initialize()
         int turn;
         std::cin >> turn;
 
+        delete m_State; // Discard the previous game
         m_State = new State();
         m_State->ChangeTurn((char)turn);
 
@@ -172,7 +189,7 @@ void Game::Settings()
 
     system(CLEAR_COMMAND);
 
-    std::cout << "0. Change ruleset\n1. Edit time limit for minimax algorithm\n2. Change 2-5 opening move permission\n3. Exit\n\n> ";
+    std::cout << "0. Change ruleset\n1. Edit time limit for minimax algorithm\n2. Change 2-5 opening move permission\n3. Change pondering\n4. Change evaluation display\n5. Exit\n\n> ";
     int option = -1;
     std::cin >> option;
 
@@ -189,25 +206,15 @@ void Game::Settings()
         {
         case 0:
         {
-            cnf_RULESET = 0;
-            {
-                std::ofstream configFile;
-                configFile.open("./settings/default_ruleset.dat", std::ios::binary);
-                configFile.write((char *)&cnf_RULESET, sizeof(cnf_RULESET));
-                configFile.close();
-            }
+            cnf_RULESET = m_Config.m_Ruleset = 0;
+            SaveSettings();
             Settings();
         };
         break;
         case 1:
         {
-            cnf_RULESET = 1;
-            {
-                std::ofstream configFile;
-                configFile.open("./settings/default_ruleset.dat", std::ios::binary);
-                configFile.write((char *)&cnf_RULESET, sizeof(cnf_RULESET));
-                configFile.close();
-            }
+            cnf_RULESET = m_Config.m_Ruleset = 1;
+            SaveSettings();
             Settings();
         };
         break;
@@ -226,12 +233,10 @@ void Game::Settings()
         int _value;
         std::cin >> _value;
 
-        cnf_TIME_LIMIT = _value;
+        if (m_Config.Set(std::format("time_limit={}", _value)))
         {
-            std::ofstream configFile;
-            configFile.open("./settings/minimax_time_limit.dat", std::ios::binary);
-            configFile.write((char *)&cnf_TIME_LIMIT, sizeof(cnf_TIME_LIMIT));
-            configFile.close();
+            cnf_TIME_LIMIT = m_Config.m_TimeLimit;
+            SaveSettings();
         }
 
         Settings();
@@ -244,18 +249,39 @@ void Game::Settings()
         int _value;
         std::cin >> _value;
 
-        cnf_OPENING_MOVE_ALLOWED = _value == 0 ? 1 : 0;
-        {
-            std::ofstream configFile;
-            configFile.open("./settings/opening_move_permission.dat", std::ios::binary);
-            configFile.write((char *)&cnf_OPENING_MOVE_ALLOWED, sizeof(cnf_OPENING_MOVE_ALLOWED));
-            configFile.close();
-        }
+        cnf_OPENING_MOVE_ALLOWED = m_Config.m_OpeningMoveAllowed = _value == 0 ? 1 : 0;
+        SaveSettings();
 
         Settings();
     };
     break;
     case 3:
+    {
+        system(CLEAR_COMMAND);
+        std::cout << "0. Enable pondering\n1. Disable pondering\n\n> ";
+        int _value;
+        std::cin >> _value;
+
+        cnf_PONDER = m_Config.m_Ponder = _value == 0 ? 1 : 0;
+        SaveSettings();
+
+        Settings();
+    };
+    break;
+    case 4:
+    {
+        system(CLEAR_COMMAND);
+        std::cout << "0. Show evaluation score\n1. Hide evaluation score\n\n> ";
+        int _value;
+        std::cin >> _value;
+
+        cnf_SHOW_EVALUATION = m_Config.m_ShowEvaluation = _value == 0 ? 1 : 0;
+        SaveSettings();
+
+        Settings();
+    };
+    break;
+    case 5:
     {
         Menu();
     };
@@ -272,6 +298,7 @@ void Game::Play()
 {
     while (m_State->GameState() != GAMEOVER)
     {
+        TraceZone zone("turn");
         if (m_State->m_Turn == 0)
         {
             if (m_Player1 == PLAYER)
@@ -302,8 +329,21 @@ void Game::Play()
 void Game::GetPlayerMove()
 {
     std::cout << "[PLAYER] Player" << int(m_State->m_Turn + 1) << ": ";
+
+    // Let the engine think about its answers while the player thinks about their move
+    const AgentEnum opponent = m_State->m_Turn == 0 ? m_Player2 : m_Player1;
+    if (cnf_PONDER && opponent == MINIMAX)
+    {
+        StartPondering();
+    }
+
     int move;
-    std::cin >> move; // Get move input from the player
+    {
+        TraceZone zone("player move");
+        std::cin >> move; // Get move input from the player
+    }
+
+    StopPondering();
 
     if (m_State->IsLegal(move))
     {
@@ -319,60 +359,55 @@ void Game::GetPlayerMove()
 
 void Game::GetAIMove(AgentEnum agent)
 {
+    TraceZone zone("engine move");
     if (agent == MINIMAX)
     {
-        Minimax engine;
+        Minimax& engine = m_Engine;
+        EngineMoveMetrics& metrics = GetEngineMoveMetrics();
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const unsigned long long startNodes = engine.Nodes();
         std::cout << "[AI] Player" << int(m_State->m_Turn + 1) << ": ";
 
-        float duration = 0.0; // Initialize duration for time limit
-        char depth = 5;       // Initial depth for minimax search
-        char bestMove = -1;   // Initialize best move
-
-        // Perform iterative deepening search until time limit is reached
-        while (duration < cnf_TIME_LIMIT && depth < 80)
-        {
-            Timer timer(&duration);                      // Start timer
-            bestMove = engine.BestMove(*m_State, depth); // Get best move using minimax with current depth
-            depth++;                                     // Increment depth for next iteration
-        }
+        // Perform iterative deepening search until the time limit stops it
+        SearchOptions options;
+        options.m_MinDepth = 5;
+        options.m_TimeLimit = (float)cnf_TIME_LIMIT;
+        const SearchResult result = SearchHandle::Search(engine, *m_State, options); // Result of the deepest completed search, reused for the evaluation score
+        char bestMove = result.m_BestMove;
+        const char depth = result.m_Depth;
 
-        // Get best move using final depth
+        // Prefer the move cached for this depth, so a position is played the same way in every session
         {
-            if (!std::filesystem::exists("db/"))
-            {
-                std::filesystem::create_directory("db");
-            }
-
-            if (!std::filesystem::exists("db/cache/"))
-            {
-                std::filesystem::create_directory("db/cache");
-            }
-
-            if (!std::filesystem::exists("db/cache/positions.dat"))
+            // Positions are cached in their canonical form, with the move in the canonical frame. The key
+            // packs the dense index of the position with its total number of stones, the search depth and the ruleset
+            const bool mirrored = m_State->m_Turn == 1;
+            const State canonical = m_State->Canonical();
+            const bool indexable = PositionIndex::Indexable(canonical);
+            const unsigned long long position_key = indexable ? PositionIndex::CacheKey(canonical, depth) : 0;
+
+            // Until the cache file is loaded only the positions this session cached are looked up
+            PositionCacheReady();
+
+            auto it = m_Positions.end();
+            if (indexable)
             {
-                std::ofstream temp("db/cache/positions.dat");
-                temp.close();
+                metrics.m_CacheLookups.Add(); // Positions that cannot be cached are not lookups
+                it = m_Positions.find(position_key);
             }
-
-            std::unordered_map<unsigned long long int, char>
-                positions;
-
-            hafif::deserialize_umap_from_file(positions, "db/cache/positions.dat");
-
-            std::string position_str = m_State->GetStateString(depth);
-            std::hash<std::string> hash_fn;
-            auto position_hash = hash_fn(position_str);
-
-            if (positions.find(position_hash) != positions.end())
+            if (it != m_Positions.end() && m_State->IsLegal(mirrored ? State::MirrorMove(it->second) : it->second))
             {
-                bestMove = positions[position_hash];
+                metrics.m_CacheHits.Add();
+                bestMove = mirrored ? State::MirrorMove(it->second) : it->second;
             }
-            else
+            else if (indexable)
             {
-
-                bestMove = engine.BestMove(*m_State, depth);
-                positions[position_hash] = bestMove;
-                hafif::serialize_umap_to_file(positions, "db/cache/positions.dat");
+                // The file is a sequence of key and move pairs where later pairs win, so one pair is appended
+                TraceZone zone("save position cache");
+                const char cachedMove = mirrored ? State::MirrorMove(bestMove) : bestMove;
+                m_Positions[position_key] = cachedMove;
+                std::string record(reinterpret_cast<const char*>(&position_key), sizeof(position_key));
+                record.push_back(cachedMove);
+                m_Persistence.Append(Path(POSITIONS_FILE), std::move(record));
             }
         }
 
@@ -385,6 +420,7 @@ void Game::GetAIMove(AgentEnum agent)
 
             m_State->MakeMove(4); // Make the move
             history.push_back(4); // Record the move in the history
+            bestMove = 4;
         }
         else
         {
@@ -396,71 +432,189 @@ void Game::GetAIMove(AgentEnum agent)
             history.push_back(bestMove); // Record the move in the history
         }
 
-        float score = engine.EvaluationScore(*m_State);
+        // The evaluation printout below is not part of the move
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const unsigned long long nodes = engine.Nodes() - startNodes;
+        metrics.m_MoveLatency.Record((unsigned long long)(elapsed.count() * 1e6));
+        metrics.m_Moves.Add();
+        metrics.m_Nodes.Add(nodes);
+        metrics.m_Depth.Set(depth);
+        metrics.m_NodesPerSecond.Set(nodes / std::max(elapsed.count(), 1e-6));
 
-        std::cout << "evaluation score: " << score << std::endl;
+        if (cnf_SHOW_EVALUATION)
+        {
+            // The root score of the search is the score of the position after its best move.
+            // Cached or forced moves fall back to the transposition table.
+            if (bestMove == result.m_BestMove)
+            {
+                std::cout << "evaluation score: " << result.m_Score << std::endl;
+                std::cout << "principal variation:";
+                for (int i = 0; i < result.m_VariationLength; ++i)
+                {
+                    std::cout << " " << (int)result.m_PrincipalVariation[i];
+                }
+                std::cout << std::endl;
+            }
+            else
+            {
+                std::cout << "evaluation score: " << engine.EvaluationScore(*m_State) << std::endl;
+            }
+        }
 
         m_State->Print(); // Print the updated game state
     }
 }
 
-void Game::SaveGame()
+/**
+ * @brief Starts searching the positions the engine may face after the player's move.
+ *
+ * The search runs on a scheduler thread and fills the transposition table of m_Engine, so
+ * GetAIMove starts from a warm table once the player has moved.
+ */
+void Game::StartPondering()
 {
-    const char BEGINNING_OF_GAME = 0xFE; // beginning-of-game flag
-    const char END_OF_GAME = 0xFF;       // end-of-game flag
-    int gamesCount = 0;                  // number of games played
+    StopPondering();
+
+    SearchOptions options;
+    options.m_MinDepth = 5;
+    options.m_Priority = PRIORITY_LOW;
+    m_Ponder = SearchHandle::Start(m_Engine, PonderPositions(), options);
+}
 
-    // Read the number of games played from file or initialize to zero
+/**
+ * @brief Cancels the background search started by StartPondering and waits for it to finish.
+ */
+void Game::StopPondering()
+{
+    if (m_Ponder.Valid())
     {
-        if (!std::filesystem::exists("db/"))
+        m_Ponder.Cancel();
+        m_Ponder.Wait();
+        m_Ponder = SearchHandle();
+    }
+}
+
+/**
+ * @brief Lists the positions the player's replies lead to, the reply the engine expects first.
+ *
+ * Pondering searches them in round-robin with increasing depth until the player has moved.
+ *
+ * @return The positions after every reply that does not end the game.
+ */
+std::vector<State> Game::PonderPositions() const
+{
+    MoveList replies = m_State->LegalMoves();
+
+    // Search the expected reply first
+    {
+        TranspositionEntry entry;
+        if (m_Engine.ProbeTable(*m_State, entry))
         {
-            std::filesystem::create_directory("db");
+            replies.MoveToFront(entry.m_BestMove);
         }
+    }
 
-        if (!std::filesystem::exists("db/games/"))
+    std::vector<State> nextStates;
+    for (char reply : replies)
+    {
+        State nextState = m_State->NextState(reply);
+        if (nextState.GameState() != GAMEOVER)
         {
-            std::filesystem::create_directory("db/games");
+            nextStates.push_back(nextState);
         }
+    }
+    return nextStates;
+}
 
-        if (!std::filesystem::exists("db/games/count.dat"))
+/**
+ * @brief Starts loading the position cache and loads the number of saved games, once per session.
+ *
+ * The cache file grows with every game played, so it is read on a background thread and the session
+ * is playable at once; moves are searched without the cache until it is loaded. Both are kept in
+ * memory afterwards, so moves and saves never read files.
+ */
+void Game::LoadDatabase()
+{
+    m_PositionsLoad = std::async(std::launch::async, [file = Path(POSITIONS_FILE)]() {
+        TraceZone zone("load position cache");
+        std::unordered_map<unsigned long long, char> positions;
+        if (std::filesystem::exists(file))
         {
-            std::ofstream temp("db/games/count.dat", std::ios::binary);
-            temp.write((char *)&gamesCount, sizeof(gamesCount));
-            temp.close();
+            hafif::deserialize_umap_from_file(positions, file);
         }
-        else
+        return positions;
+    });
+
+    m_GamesCount = 0;
+    std::ifstream countFile(Path(GAMES_COUNT_FILE), std::ios::binary);
+    if (countFile)
+    {
+        countFile.read((char *)&m_GamesCount, sizeof(m_GamesCount));
+    }
+}
+
+/**
+ * @brief Takes over the position cache once its background load has finished.
+ *
+ * Positions cached by this session while the file was loading are newer than the file and are kept.
+ *
+ * @return True if the cache is loaded, false while it is still loading.
+ */
+bool Game::PositionCacheReady()
+{
+    if (m_PositionsLoad.valid())
+    {
+        if (m_PositionsLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
         {
-            std::ifstream temp("db/games/count.dat", std::ios::binary);
-            temp.read((char *)&gamesCount, sizeof(gamesCount));
-            temp.close();
+            return false;
         }
+        std::unordered_map<unsigned long long, char> loaded = m_PositionsLoad.get();
+        for (const auto& [key, move] : m_Positions)
+        {
+            loaded[key] = move;
+        }
+        m_Positions = std::move(loaded);
     }
+    return true;
+}
+
+/**
+ * @brief Queues the saved settings to be written to the settings file.
+ */
+void Game::SaveSettings()
+{
+    m_Persistence.Replace(Path(GameConfig::FILE), m_Config.Serialize());
+}
+
+/**
+ * @brief Queues the finished game for the archive.
+ *
+ * The game file and the updated count are written by the persistence thread.
+ */
+void Game::SaveGame()
+{
+    TraceZone zone("save game");
+    const char BEGINNING_OF_GAME = 0xFE; // beginning-of-game flag
+    const char END_OF_GAME = 0xFF;       // end-of-game flag
 
     // Generate file name based on game count
-    std::string fileName = "./db/games/" + GetFileNameWithLeadingZeros(gamesCount) + ".dat";
+    std::string fileName = Path("db/games/" + GetFileNameWithLeadingZeros(m_GamesCount) + ".dat");
 
     // Write game history to file
     {
-        std::ofstream temp(fileName, std::ios::binary | std::ios::app);
-        temp.put((char)m_State->m_Ruleset);
-        temp.put(BEGINNING_OF_GAME);
-        for (char move : history)
-        {
-            temp.put(move); // Write each move to file
-        };
-        temp.put(END_OF_GAME);
-        temp.close();
+        std::string record;
+        record.push_back((char)m_State->m_Ruleset);
+        record.push_back(BEGINNING_OF_GAME);
+        record.append(history.begin(), history.end());
+        record.push_back(END_OF_GAME);
+        m_Persistence.Append(fileName, std::move(record));
     }
 
     std::cout << "Game saved successfully!\n";
 
     // Update games count and write it back to file
-    {
-        gamesCount += 1;
-        std::ofstream temp("db/games/count.dat", std::ios::binary);
-        temp.write((char *)&gamesCount, sizeof(gamesCount));
-        temp.close();
-    }
+    m_GamesCount += 1;
+    m_Persistence.Replace(Path(GAMES_COUNT_FILE), std::string((const char *)&m_GamesCount, sizeof(m_GamesCount)));
 }
 
 std::string Game::GetFileNameWithLeadingZeros(int fileName)
@@ -2,10 +2,18 @@
 
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <stdio.h>
 
+#include "game-config.h"
 #include "mancala-engine.h"
+#include "metrics.h"
+#include "persistence-queue.h"
+#include "position-index.h"
+#include "search-handle.h"
 #include "state.h"
 #include "timer.h"
 
@@ -19,22 +27,48 @@ enum AgentEnum
 
 class Game
 {
+    friend class LoadTest;
+
 public:
     Game();
 
     ~Game();
 
 private:
+    Game(const bool& interactive, const std::filesystem::path& directory = ".");
+
     State* m_State; // Game state
     AgentEnum m_Player1; 
     AgentEnum m_Player2;
+    Minimax m_Engine;            // Kept for the whole session so its transposition table stays warm
+    SearchHandle m_Ponder;       // Searches on the opponent's time while waiting for player input
+    PersistenceQueue m_Persistence;                          // Writes files off the move path
+    std::unordered_map<unsigned long long, char> m_Positions; // Position cache, loaded once per session
+    std::future<std::unordered_map<unsigned long long, char>> m_PositionsLoad; // Loads the cache file in the background
+    int m_GamesCount;                                        // Games in the archive, loaded once per session
+    std::filesystem::path m_Directory;                       // Directory the settings, cache and archive files are in
+
+    static constexpr const char* POSITIONS_FILE = PositionIndex::CACHE_FILE;
+    static constexpr const char* GAMES_COUNT_FILE = "db/games/count.dat";
+
+    GameConfig m_Config; // Saved settings, without the command line overrides
 
     int cnf_TIME_LIMIT; // default 100ms
     int cnf_OPENING_MOVE_ALLOWED;
     int cnf_RULESET;
+    int cnf_PONDER; // default 1 (enabled)
+    int cnf_SHOW_EVALUATION; // default 1 (show)
+
+    std::string Path(const std::string& file) const;
 
     void ReadSettings();
 
+    void LoadDatabase();
+
+    bool PositionCacheReady();
+
+    void SaveSettings();
+
     void Menu();
 
     void Initialize();
@@ -47,6 +81,12 @@ private:
 
     void GetAIMove(AgentEnum agent);
 
+    void StartPondering();
+
+    void StopPondering();
+
+    std::vector<State> PonderPositions() const;
+
     void SaveGame();
 
     std::string GetFileNameWithLeadingZeros(int fileName);
@@ -0,0 +1,267 @@
+#include "load-test.h"
+#include "allocation-tracker.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Constructs a load test.
+ *
+ * @param config Settings of the test.
+ */
+LoadTest::LoadTest(const LoadTestConfig& config) : m_Config(config)
+{
+    if (m_Config.m_MaxGames <= 0)
+    {
+        m_Config.m_MaxGames = 4 * (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (m_Config.m_TimeLimits.empty())
+    {
+        m_Config.m_TimeLimits = { 100 };
+    }
+    m_Config.m_MaxThinkTime = std::max(m_Config.m_MinThinkTime, m_Config.m_MaxThinkTime);
+}
+
+/**
+ * @brief Runs the concurrency levels in the working directory of the sessions and prints one row per level.
+ *
+ * @return The highest number of concurrent games that met the latency SLO, 0 if none did.
+ */
+int LoadTest::Run()
+{
+    std::filesystem::create_directories(m_Config.m_Directory);
+    std::filesystem::current_path(m_Config.m_Directory);
+
+    std::cout << std::format("load test in {}: up to {} games, {} ms per level, {:.0f}% with a human, p99 SLO {} ms\n\n",
+        std::filesystem::current_path().string(), m_Config.m_MaxGames, m_Config.m_LevelDuration, 100.0F * m_Config.m_HumanShare, m_Config.m_LatencySlo);
+    std::cout << std::format("{:>6}{:>12}{:>11}{:>9}{:>9}{:>9}{:>9}{:>7}{:>10}{:>6}\n",
+        "games", "AI moves/s", "games/min", "p50 ms", "p95 ms", "p99 ms", "max ms", "CPU", "MB/game", "SLO");
+
+    int withinSlo = 0;
+    for (int games = 1; games <= m_Config.m_MaxGames; games = games < m_Config.m_MaxGames ? std::min(2 * games, m_Config.m_MaxGames) : games + 1)
+    {
+        // The sessions print every move, which would drown the report and serialize them on the terminal
+        std::cout << std::flush;
+#if defined(__linux__)
+        const int output = dup(STDOUT_FILENO);
+        const int discard = open("/dev/null", O_WRONLY);
+        dup2(discard, STDOUT_FILENO);
+        close(discard);
+#endif
+        const LevelResult result = RunLevel(games);
+        std::cout << std::flush;
+#if defined(__linux__)
+        dup2(output, STDOUT_FILENO);
+        close(output);
+#endif
+
+        const bool met = result.m_Moves > 0 && result.m_Percentiles[2] <= m_Config.m_LatencySlo;
+        std::cout << std::format("{:>6}{:>12.1f}{:>11.1f}{:>9.1f}{:>9.1f}{:>9.1f}{:>9.1f}{:>6.0f}%{:>10.1f}{:>6}\n",
+            result.m_Games, result.m_Moves / result.m_Seconds, 60.0 * result.m_Finished / result.m_Seconds, result.m_Percentiles[0],
+            result.m_Percentiles[1], result.m_Percentiles[2], result.m_Percentiles[3], 100.0 * result.m_CpuUtilization,
+            result.m_MemoryPerGame, met ? "ok" : "broken") << std::flush;
+
+        if (!met)
+        {
+            break;
+        }
+        withinSlo = games;
+    }
+    return withinSlo;
+}
+
+/**
+ * @brief Runs the given number of concurrent game sessions for the duration of a level.
+ *
+ * @param games Number of concurrent games.
+ * @return What the level measured.
+ */
+LoadTest::LevelResult LoadTest::RunLevel(const int& games)
+{
+    const size_t baseline = AllocationTracker::ResidentBytes();
+
+    // Sessions are created one after another, as loading the settings updates the engine defaults
+    std::vector<std::unique_ptr<Game>> sessions;
+    for (int i = 0; i < games; ++i)
+    {
+        sessions.push_back(std::unique_ptr<Game>(new Game(false, SessionDirectory(i))));
+    }
+
+    std::vector<SessionStats> stats(games);
+    std::vector<std::thread> threads;
+    std::random_device seed;
+    const double startCpu = CpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(m_Config.m_LevelDuration);
+    for (int i = 0; i < games; ++i)
+    {
+        threads.emplace_back(&LoadTest::RunSession, this, std::ref(*sessions[i]), std::mt19937(seed()), deadline, std::ref(stats[i]));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    LevelResult result = {};
+    result.m_Games = games;
+    result.m_Seconds = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    result.m_CpuUtilization = (CpuSeconds() - startCpu) / result.m_Seconds / std::max(1u, std::thread::hardware_concurrency());
+
+    // Measured before the sessions are destroyed, with their tables touched and caches grown
+    const size_t resident = AllocationTracker::ResidentBytes();
+    result.m_MemoryPerGame = resident > baseline ? (double)(resident - baseline) / games / (1024.0 * 1024.0) : 0.0;
+    sessions.clear(); // Waits for the pending archive and cache writes
+
+    std::vector<float> latencies;
+    for (const SessionStats& session : stats)
+    {
+        latencies.insert(latencies.end(), session.m_Latencies.begin(), session.m_Latencies.end());
+        result.m_Finished += session.m_Games;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    result.m_Moves = latencies.size();
+
+    const double quantiles[] = { 0.5, 0.95, 0.99, 1.0 };
+    for (int i = 0; i < 4 && !latencies.empty(); ++i)
+    {
+        result.m_Percentiles[i] = latencies[std::min(latencies.size() - 1, (size_t)(quantiles[i] * latencies.size()))];
+    }
+    return result;
+}
+
+/**
+ * @brief Returns the directory of a session, created on first use from the settings and position cache of the test.
+ *
+ * Every session keeps its own archive, count and cache files, so concurrent sessions never write the same file.
+ * A session of a later level reuses the directory of the same session of the level before.
+ *
+ * @param session Index of the session in its level.
+ * @return The directory, relative to the working directory of the test.
+ */
+std::filesystem::path LoadTest::SessionDirectory(const int& session)
+{
+    const std::filesystem::path directory = std::format("session-{}", session);
+    if (!std::filesystem::exists(directory))
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory);
+        if (std::filesystem::exists("settings"))
+        {
+            std::filesystem::copy("settings", directory / "settings", std::filesystem::copy_options::recursive, error);
+        }
+        if (std::filesystem::exists(Game::POSITIONS_FILE))
+        {
+            const std::filesystem::path cache = directory / Game::POSITIONS_FILE;
+            std::filesystem::create_directories(cache.parent_path());
+            std::filesystem::copy_file(Game::POSITIONS_FILE, cache, error);
+        }
+    }
+    return directory;
+}
+
+/**
+ * @brief Plays games on one session until the deadline, timing every AI move.
+ *
+ * A game still running at the deadline is abandoned without being saved.
+ *
+ * @param game The session.
+ * @param generator Draws the game settings, think times and human moves.
+ * @param deadline End of the level.
+ * @param stats Receives the measurements of the session.
+ */
+void LoadTest::RunSession(Game& game, std::mt19937 generator, const std::chrono::steady_clock::time_point& deadline, SessionStats& stats)
+{
+    std::uniform_int_distribution<int> thinkTime(m_Config.m_MinThinkTime, m_Config.m_MaxThinkTime);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        StartGame(game, generator);
+        while (game.m_State->GameState() != GAMEOVER && std::chrono::steady_clock::now() < deadline)
+        {
+            const AgentEnum agent = game.m_State->m_Turn == 0 ? game.m_Player1 : game.m_Player2;
+            if (agent == MINIMAX)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                game.GetAIMove(MINIMAX);
+                stats.m_Latencies.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+                continue;
+            }
+
+            // A simulated human thinks while the engine ponders, as in Game::GetPlayerMove
+            if (game.cnf_PONDER)
+            {
+                game.StartPondering();
+            }
+            std::this_thread::sleep_until(std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(thinkTime(generator))));
+            game.StopPondering();
+
+            const MoveList legalMoves = game.m_State->LegalMoves();
+            const char move = legalMoves[generator() % legalMoves.size()];
+            game.m_State->MakeMove(move);
+            game.history.push_back(move);
+        }
+
+        if (game.m_State->GameState() == GAMEOVER)
+        {
+            game.SaveGame();
+            stats.m_Games++;
+        }
+    }
+}
+
+/**
+ * @brief Sets a session up for a new game drawn from the configured mix, as Game::Initialize does from the menu.
+ */
+void LoadTest::StartGame(Game& game, std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+    const bool human = uniform(generator) < m_Config.m_HumanShare;
+    const int humanSide = (int)(generator() % 2);
+    game.m_Player1 = human && humanSide == 0 ? PLAYER : MINIMAX;
+    game.m_Player2 = human && humanSide == 1 ? PLAYER : MINIMAX;
+    game.cnf_RULESET = uniform(generator) < m_Config.m_TurkishShare ? 1 : 0;
+    game.cnf_TIME_LIMIT = m_Config.m_TimeLimits[generator() % m_Config.m_TimeLimits.size()];
+
+    delete game.m_State; // Discard the previous game
+    game.m_State = new State();
+    game.m_State->ChangeTurn((char)(generator() % 2));
+    game.m_State->ChangeRuleset((char)game.cnf_RULESET);
+    game.history.clear();
+}
+
+/**
+ * @brief Returns the processor time the process has used on all its threads.
+ *
+ * @return The user and system time in seconds.
+ */
+double LoadTest::CpuSeconds()
+{
+#if defined(__linux__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+    return (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * @brief Runs a load test and reports how many concurrent games met the latency SLO.
+ *
+ * @param config Settings of the test.
+ */
+void LoadTest::Start(const LoadTestConfig& config)
+{
+    LoadTest test(config);
+    const int games = test.Run();
+    std::cout << std::format("\nhighest concurrency within the p99 SLO of {} ms: {} games\n", test.m_Config.m_LatencySlo, games);
+}
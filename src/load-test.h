@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "game.h"
+
+/**
+ * @brief Settings of a load test.
+ */
+struct LoadTestConfig
+{
+	int m_MaxGames = 0;                             // Largest number of concurrent games, 0 for four per core
+	int m_LevelDuration = 10000;                    // Milliseconds every concurrency level runs
+	float m_HumanShare = 0.5F;                      // Share of games with a simulated human on one side
+	int m_MinThinkTime = 500;                       // Think time of a simulated human in milliseconds, drawn per move
+	int m_MaxThinkTime = 3000;
+	std::vector<int> m_TimeLimits = { 50, 100, 200 }; // AI time limits in milliseconds, one drawn per game
+	float m_TurkishShare = 0.5F;                    // Share of games played with the Turkish ruleset
+	float m_LatencySlo = 500.0F;                    // Highest acceptable 99th percentile move latency in milliseconds
+	std::string m_Directory = "loadtest";           // Working directory of the simulated sessions
+};
+
+/**
+ * @brief Simulates concurrent production games to find how many one host can serve within the latency SLO.
+ *
+ * Every simulated game is a Game session on its own thread, driven through the same GetAIMove, pondering
+ * and SaveGame path as an interactive session, so it searches on the shared search scheduler, uses the
+ * position cache and writes the archive. Games draw their ruleset, AI time limit and whether a simulated
+ * human plays one side from the configured mix; a human sleeps for a random think time, while the engine
+ * ponders, and then plays a random legal move. Finished games are saved and the session starts the next.
+ *
+ * The number of concurrent games doubles from 1 until the maximum or until the 99th percentile move
+ * latency breaks the SLO. Every level reports AI move throughput, finished games, move latency
+ * percentiles, CPU utilization over all cores and resident memory per game.
+ *
+ * The test runs in its own directory, so the settings, cache and archive of the real sessions are left
+ * alone, and every simulated session keeps its files in a subdirectory of it, so concurrent sessions never
+ * write the same file. A session directory starts with a copy of the settings and position cache of the
+ * test directory; copy a position cache there to test with a warm one. Output of the sessions is discarded.
+ */
+class LoadTest
+{
+private:
+	/**
+	 * @brief What one simulated game session measured.
+	 */
+	struct SessionStats
+	{
+		std::vector<float> m_Latencies; // AI move latencies in milliseconds
+		unsigned long long m_Games = 0;  // Games finished and saved
+	};
+
+	/**
+	 * @brief What one concurrency level measured.
+	 */
+	struct LevelResult
+	{
+		int m_Games;                  // Concurrent games
+		double m_Seconds;
+		unsigned long long m_Moves;   // AI moves
+		unsigned long long m_Finished;
+		float m_Percentiles[4];       // 50th, 95th and 99th percentile and maximum move latency in milliseconds
+		double m_CpuUtilization;      // Share of all cores used by the process
+		double m_MemoryPerGame;       // Resident megabytes the sessions added, per game
+	};
+
+	LoadTestConfig m_Config;
+
+	LevelResult RunLevel(const int& games);
+	std::filesystem::path SessionDirectory(const int& session);
+	void RunSession(Game& game, std::mt19937 generator, const std::chrono::steady_clock::time_point& deadline, SessionStats& stats);
+	void StartGame(Game& game, std::mt19937& generator);
+
+	static double CpuSeconds();
+
+public:
+	LoadTest(const LoadTestConfig& config);
+
+	int Run();
+
+	static void Start(const LoadTestConfig& config);
+};
@@ -1,13 +1,250 @@
-﻿#include <memory>
+﻿#include <cctype>
+#include <climits>
+#include <memory>
+#include "engine-server.h"
 #include "game.h"
+#include "game-annotator.h"
+#include "load-test.h"
+#include "metrics.h"
 #include "openings-book.h"
 #include "state-analyzer.h"
+#include "evaluation-tuner.h"
+#include "network-trainer.h"
+#include "self-play-generator.h"
+#include "shared-table-benchmark.h"
+#include "state-batch.h"
+#include "task-benchmark.h"
+#include "tracer.h"
 
-int main()
+/**
+ * @brief Parses a command line integer within a range.
+ *
+ * @return True if the whole text is an integer from min to max, false otherwise.
+ */
+static bool ParseInteger(const std::string& text, const int& min, const int& max, int& value)
 {
+    try
+    {
+        size_t end;
+        const int parsed = std::stoi(text, &end);
+        if (end != text.size() || parsed < min || parsed > max)
+        {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    // Zone tracing, viewable in Perfetto: mancala --trace <file> [command ...]
+    if (args.size() >= 2 && args[0] == "--trace")
+    {
+        Tracer::Start(args[1]);
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
+    // Prometheus metrics export: mancala --metrics <file | unix:socket path> [interval ms] [command ...]
+    if (args.size() >= 2 && args[0] == "--metrics")
+    {
+        const bool hasInterval = args.size() >= 3 && !args[2].empty() && std::isdigit((unsigned char)args[2][0]);
+        Metrics::Start(args[1], hasInterval ? std::stoi(args[2]) : 10000);
+        args.erase(args.begin(), args.begin() + (hasInterval ? 3 : 2));
+    }
+
+    // Transposition table shared with other engine processes: mancala --shared-table <name> [table MB] [huge] [command ...]
+    if (args.size() >= 2 && args[0] == "--shared-table")
+    {
+        const std::string name = args[1];
+        const bool hasSize = args.size() >= 3 && !args[2].empty() && std::isdigit((unsigned char)args[2][0]);
+        const size_t megabytes = hasSize ? std::stoull(args[2]) : 256;
+        args.erase(args.begin(), args.begin() + (hasSize ? 3 : 2));
+        const bool hugePages = !args.empty() && args[0] == "huge";
+        if (hugePages)
+        {
+            args.erase(args.begin());
+        }
+        Minimax::OpenSharedTable(name, megabytes, hugePages);
+    }
+
+    // Session settings for this run only, the settings file is left unchanged: mancala --set <key>=<value> [--set ...] [command ...]
+    while (args.size() >= 2 && args[0] == "--set")
+    {
+        if (!GameConfig::AddOverride(args[1]))
+        {
+            std::cerr << std::format("Unknown setting or value out of range: {}\n", args[1]);
+            return 1;
+        }
+        args.erase(args.begin(), args.begin() + 2);
+    }
+
+    // Offline evaluation tuning: mancala tune [threads] [epochs] [label depth]
+    if (!args.empty() && args[0] == "tune")
+    {
+        const int threads = args.size() > 1 ? std::stoi(args[1]) : (int)std::thread::hardware_concurrency();
+        const int epochs = args.size() > 2 ? std::stoi(args[2]) : 1000;
+        const char labelDepth = args.size() > 3 ? (char)std::stoi(args[3]) : 0;
+        EvaluationTuner::Start(threads, epochs, labelDepth);
+        return 0;
+    }
+
+    // Network evaluator training: mancala train-network [games] [depth] [epochs] [threads]
+    if (!args.empty() && args[0] == "train-network")
+    {
+        const int games = args.size() > 1 ? std::stoi(args[1]) : 1000;
+        const char depth = args.size() > 2 ? (char)std::stoi(args[2]) : 3;
+        const int epochs = args.size() > 3 ? std::stoi(args[3]) : 60;
+        const int threads = args.size() > 4 ? std::stoi(args[4]) : (int)std::thread::hardware_concurrency();
+        NetworkTrainer::Start(games, depth, epochs, threads);
+        return 0;
+    }
+
+    // Resumable opening book build: mancala book <config file>
+    if (args.size() >= 2 && args[0] == "book")
+    {
+        return OpeningsBookGenerator::Start(args[1]);
+    }
+
+    // Multi-PV analysis: mancala analyze <board> <turn> [ruleset] [time limit ms] [lines]
+    if (args.size() >= 3 && args[0] == "analyze")
+    {
+        State* state = new State();
+        std::string error;
+        if (!StateAnalyzer::ParsePosition(args[1], args[2], args.size() > 3 ? args[3] : "", *state, error))
+        {
+            std::cout << "Invalid position: " << error << "\n";
+            delete state;
+            return 1;
+        }
+
+        int timeLimit = 1000, lines = MultiPVResult::MAX_LINES;
+        if ((args.size() > 4 && !ParseInteger(args[4], 1, GameConfig::MAX_TIME_LIMIT, timeLimit))
+            || (args.size() > 5 && !ParseInteger(args[5], 1, MultiPVResult::MAX_LINES, lines)))
+        {
+            std::cout << std::format("The time limit must be 1 to {} ms and the lines 1 to {}\n", GameConfig::MAX_TIME_LIMIT, MultiPVResult::MAX_LINES);
+            return 1;
+        }
+        StateAnalyzer::AnalyzeState(state, timeLimit, lines);
+        delete state;
+        return 0;
+    }
+
+    // Proof-number solver: mancala solve <board> <turn> [ruleset] [time limit ms] [node limit]
+    if (args.size() >= 3 && args[0] == "solve")
+    {
+        State* state = new State();
+        std::string error;
+        if (!StateAnalyzer::ParsePosition(args[1], args[2], args.size() > 3 ? args[3] : "", *state, error))
+        {
+            std::cout << "Invalid position: " << error << "\n";
+            delete state;
+            return 1;
+        }
+
+        int timeLimit = 10000, nodeLimit = 10000000;
+        if ((args.size() > 4 && !ParseInteger(args[4], 1, INT_MAX, timeLimit)) || (args.size() > 5 && !ParseInteger(args[5], 1, INT_MAX, nodeLimit)))
+        {
+            std::cout << "The time and node limits must be positive integers\n";
+            return 1;
+        }
+        StateAnalyzer::SolveState(state, timeLimit, (unsigned long long)nodeLimit);
+        delete state;
+        return 0;
+    }
+
+    // Training data generation: mancala selfplay [games] [depth] [sample rate] [threads] [node limit]
+    if (!args.empty() && args[0] == "selfplay")
+    {
+        SelfPlayConfig config;
+        config.m_Games = args.size() > 1 ? std::stoi(args[1]) : config.m_Games;
+        config.m_Depth = args.size() > 2 ? (char)std::stoi(args[2]) : config.m_Depth;
+        config.m_SampleRate = args.size() > 3 ? std::stof(args[3]) : config.m_SampleRate;
+        config.m_Threads = args.size() > 4 ? std::stoi(args[4]) : config.m_Threads;
+        config.m_NodeLimit = args.size() > 5 ? std::stoull(args[5]) : config.m_NodeLimit;
+        SelfPlayGenerator::Start(config);
+        return 0;
+    }
+
+    // Blunder annotation of the game archive: mancala annotate [node limit] [threads] [directory]
+    if (!args.empty() && args[0] == "annotate")
+    {
+        AnnotatorConfig config;
+        config.m_NodeLimit = args.size() > 1 ? std::stoull(args[1]) : config.m_NodeLimit;
+        config.m_Threads = args.size() > 2 ? std::stoi(args[2]) : config.m_Threads;
+        config.m_Directory = args.size() > 3 ? args[3] : config.m_Directory;
+        GameAnnotator::Start(config);
+        return 0;
+    }
+
+    // Batch move generation throughput: mancala bench-batch [boards] [rounds]
+    if (!args.empty() && args[0] == "bench-batch")
+    {
+        const size_t boards = args.size() > 1 ? std::stoull(args[1]) : 100000;
+        const int rounds = args.size() > 2 ? std::stoi(args[2]) : 100;
+        StateBatch::Benchmark(boards, rounds);
+        return 0;
+    }
+
+
+    // Shared transposition table benchmark: mancala bench-shared-table [processes] [positions] [depth] [table MB]
+    if (!args.empty() && args[0] == "bench-shared-table")
+    {
+        const int processes = args.size() > 1 ? std::stoi(args[1]) : 8;
+        const int positions = args.size() > 2 ? std::stoi(args[2]) : 100;
+        const char depth = args.size() > 3 ? (char)std::stoi(args[3]) : 9;
+        const size_t megabytes = args.size() > 4 ? std::stoull(args[4]) : 64;
+        SharedTableBenchmark::Start(processes, positions, depth, megabytes);
+        return 0;
+    }
+
+    // Work-stealing scheduler scaling on mixed-depth searches: mancala bench-tasks [jobs] [max threads]
+    if (!args.empty() && args[0] == "bench-tasks")
+    {
+        const int jobs = args.size() > 1 ? std::stoi(args[1]) : 500;
+        const int threads = args.size() > 2 ? std::stoi(args[2]) : 0;
+        TaskBenchmark::Start(jobs, threads);
+        return 0;
+    }
+
+    // Batch position analysis: mancala analyze-batch <positions file> [depth] [threads]
+    if (args.size() >= 2 && args[0] == "analyze-batch")
+    {
+        const char depth = args.size() > 2 ? (char)std::stoi(args[2]) : 10;
+        const int threads = args.size() > 3 ? std::stoi(args[3]) : 0;
+        StateAnalyzer::AnalyzeBatch(args[1], depth, threads);
+        return 0;
+    }
+
+    // Load test of concurrent game sessions: mancala load-test [max games] [seconds per level] [human share] [p99 SLO ms]
+    if (!args.empty() && args[0] == "load-test")
+    {
+        LoadTestConfig config;
+        config.m_MaxGames = args.size() > 1 ? std::stoi(args[1]) : config.m_MaxGames;
+        config.m_LevelDuration = args.size() > 2 ? (int)(1000.0F * std::stof(args[2])) : config.m_LevelDuration;
+        config.m_HumanShare = args.size() > 3 ? std::stof(args[3]) : config.m_HumanShare;
+        config.m_LatencySlo = args.size() > 4 ? std::stof(args[4]) : config.m_LatencySlo;
+        LoadTest::Start(config);
+        return 0;
+    }
+
+    // Multi-session engine server: mancala serve [socket path] [workers] [table MB]
+    if (!args.empty() && args[0] == "serve")
+    {
+        ServerConfig config;
+        config.m_SocketPath = args.size() > 1 ? args[1] : config.m_SocketPath;
+        config.m_Workers = args.size() > 2 ? std::stoi(args[2]) : config.m_Workers;
+        config.m_TableMegabytes = args.size() > 3 ? std::stoull(args[3]) : config.m_TableMegabytes;
+        return EngineServer::Start(config);
+    }
+
     std::unique_ptr<Game> game = std::make_unique<Game>();
-    /*std::unique_ptr<OpeningsBookGenerator> book = std::make_unique<OpeningsBookGenerator>();
-    book->Generate();*/
     /*StateAnalyzer::Start();*/
     return 0;
 }
\ No newline at end of file
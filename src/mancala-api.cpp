@@ -0,0 +1,362 @@
+#include "mancala-api.h"
+#include "mancala-engine.h"
+#include "search-handle.h"
+
+#include <limits>
+#include <new>
+
+/**
+ * @brief The state behind an engine handle.
+ */
+struct mancala_engine
+{
+    Minimax m_Engine;
+
+    mancala_engine(const size_t& tableMegabytes)
+        : m_Engine(tableMegabytes > 0 ? std::make_shared<TranspositionTable>(tableMegabytes) : std::make_shared<TranspositionTable>())
+    {
+    }
+};
+
+/**
+ * @brief Converts between the C structs of the library and the engine's classes.
+ */
+class MancalaApi
+{
+public:
+    /**
+     * @brief Checks that a C position describes a board the engine can play.
+     */
+    static bool IsValid(const mancala_position* position)
+    {
+        if (position == nullptr || (position->turn != 0 && position->turn != 1) ||
+            (position->ruleset != MANCALA_RULESET_CLASSIC && position->ruleset != MANCALA_RULESET_TURKISH))
+        {
+            return false;
+        }
+
+        int stones = 0;
+        for (int pit = 0; pit < MANCALA_PITS; ++pit)
+        {
+            if (position->board[pit] < 0)
+            {
+                return false;
+            }
+            stones += position->board[pit];
+        }
+        return stones == ClassicGeometry::TOTAL;
+    }
+
+    static State ToState(const mancala_position& position)
+    {
+        State state;
+        for (int pit = 0; pit < MANCALA_PITS; ++pit)
+        {
+            state.m_Board[pit] = (char)position.board[pit];
+        }
+        state.m_Turn = (char)position.turn;
+        state.m_Ruleset = (char)position.ruleset;
+        return state;
+    }
+
+    static void FromState(const State& state, mancala_position& position)
+    {
+        for (int pit = 0; pit < MANCALA_PITS; ++pit)
+        {
+            position.board[pit] = (int8_t)state.m_Board[pit];
+        }
+        position.turn = (int8_t)state.m_Turn;
+        position.ruleset = (int8_t)state.m_Ruleset;
+    }
+
+    /**
+     * @brief Writes the legal moves of a valid position.
+     *
+     * @return The number of moves, 0 once the game is over.
+     */
+    static int LegalMoves(const State& state, int8_t* moves)
+    {
+        if (state.GameState() == GAMEOVER)
+        {
+            return 0;
+        }
+
+        const MoveList legalMoves = state.LegalMoves();
+        for (size_t i = 0; i < legalMoves.size(); ++i)
+        {
+            moves[i] = (int8_t)legalMoves[i];
+        }
+        return (int)legalMoves.size();
+    }
+
+    static int MakeMove(mancala_position& position, const int& move)
+    {
+        State state = ToState(position);
+        if (state.GameState() == GAMEOVER)
+        {
+            return MANCALA_ERROR_GAME_OVER;
+        }
+        if (move < 0 || move >= MANCALA_PITS || !state.IsLegal((char)move))
+        {
+            return MANCALA_ERROR_ILLEGAL_MOVE;
+        }
+
+        state.MakeMove((char)move);
+        FromState(state, position);
+        return MANCALA_OK;
+    }
+
+    static int GameOver(const State& state, int* winner)
+    {
+        if (winner != nullptr)
+        {
+            *winner = state.GetWinner();
+        }
+        return state.GameState() == GAMEOVER ? 1 : 0;
+    }
+
+    /**
+     * @brief Searches a valid position to a fixed depth or by iterative deepening until the time limit stops it.
+     */
+    static void Search(Minimax& engine, const State& state, const int& depth, const int& timeLimit, mancala_search_result& result)
+    {
+        result = { -1, 0, 0.0F, 0 };
+        if (state.GameState() == GAMEOVER)
+        {
+            result.score = engine.StaticEvaluation(state);
+            return;
+        }
+
+        const int maxDepth = std::clamp(depth, 1, SearchResult::MAX_VARIATION - 1);
+        if (timeLimit <= 0)
+        {
+            Store(engine.Search(state, (char)maxDepth), result);
+            return;
+        }
+
+        SearchOptions options;
+        options.m_MaxDepth = (char)maxDepth;
+        options.m_TimeLimit = (float)timeLimit;
+        Store(SearchHandle::Search(engine, state, options), result);
+    }
+
+private:
+    static void Store(const SearchResult& search, mancala_search_result& result)
+    {
+        result.best_move = search.m_BestMove;
+        result.depth = search.m_Depth;
+        result.score = search.m_Score;
+        result.nodes = search.m_Nodes;
+    }
+};
+
+extern "C" {
+
+MANCALA_API int mancala_api_version(void)
+{
+    return MANCALA_API_VERSION;
+}
+
+MANCALA_API int mancala_position_init(mancala_position* position, int ruleset)
+{
+    if (position == nullptr || (ruleset != MANCALA_RULESET_CLASSIC && ruleset != MANCALA_RULESET_TURKISH))
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    State state;
+    state.ChangeRuleset((char)ruleset);
+    MancalaApi::FromState(state, *position);
+    return MANCALA_OK;
+}
+
+MANCALA_API int mancala_position_validate(const mancala_position* position)
+{
+    return MancalaApi::IsValid(position) ? MANCALA_OK : MANCALA_ERROR_INVALID_ARGUMENT;
+}
+
+MANCALA_API int mancala_legal_moves(const mancala_position* position, int8_t* moves)
+{
+    if (!MancalaApi::IsValid(position) || moves == nullptr)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+    return MancalaApi::LegalMoves(MancalaApi::ToState(*position), moves);
+}
+
+MANCALA_API int mancala_make_move(mancala_position* position, int move)
+{
+    if (!MancalaApi::IsValid(position))
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+    return MancalaApi::MakeMove(*position, move);
+}
+
+MANCALA_API int mancala_game_over(const mancala_position* position, int* winner)
+{
+    if (!MancalaApi::IsValid(position))
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    return MancalaApi::GameOver(MancalaApi::ToState(*position), winner);
+}
+
+MANCALA_API mancala_engine* mancala_engine_create(size_t table_megabytes)
+{
+    try
+    {
+        return new mancala_engine(table_megabytes);
+    }
+    catch (const std::exception&)
+    {
+        return nullptr; // No exception crosses the C boundary
+    }
+}
+
+MANCALA_API void mancala_engine_destroy(mancala_engine* engine)
+{
+    delete engine;
+}
+
+MANCALA_API int mancala_engine_clear(mancala_engine* engine)
+{
+    if (engine == nullptr)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+    engine->m_Engine.GetTranspositionTable()->Clear();
+    return MANCALA_OK;
+}
+
+MANCALA_API int mancala_evaluate(mancala_engine* engine, const mancala_position* position, float* score)
+{
+    if (engine == nullptr || !MancalaApi::IsValid(position) || score == nullptr)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+    *score = engine->m_Engine.StaticEvaluation(MancalaApi::ToState(*position));
+    return MANCALA_OK;
+}
+
+MANCALA_API int mancala_search(mancala_engine* engine, const mancala_position* position, int depth, int time_limit_ms, mancala_search_result* result)
+{
+    if (engine == nullptr || !MancalaApi::IsValid(position) || result == nullptr)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+    MancalaApi::Search(engine->m_Engine, MancalaApi::ToState(*position), depth, time_limit_ms, *result);
+    return MANCALA_OK;
+}
+
+MANCALA_API int mancala_legal_moves_batch(const mancala_position* positions, size_t count, int8_t* moves, int32_t* counts)
+{
+    if ((positions == nullptr || moves == nullptr) && count > 0)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    int status = MANCALA_OK;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int8_t* positionMoves = moves + i * MANCALA_MAX_MOVES;
+        int moveCount = -1;
+        if (MancalaApi::IsValid(&positions[i]))
+        {
+            moveCount = MancalaApi::LegalMoves(MancalaApi::ToState(positions[i]), positionMoves);
+        }
+        else
+        {
+            status = MANCALA_ERROR_INVALID_ARGUMENT;
+        }
+
+        for (int move = std::max(moveCount, 0); move < MANCALA_MAX_MOVES; ++move)
+        {
+            positionMoves[move] = -1;
+        }
+        if (counts != nullptr)
+        {
+            counts[i] = moveCount;
+        }
+    }
+    return status;
+}
+
+MANCALA_API int mancala_make_move_batch(mancala_position* positions, const int32_t* moves, size_t count, int32_t* statuses)
+{
+    if ((positions == nullptr || moves == nullptr) && count > 0)
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    int status = MANCALA_OK;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int moveStatus = MancalaApi::IsValid(&positions[i]) ? MancalaApi::MakeMove(positions[i], moves[i]) : MANCALA_ERROR_INVALID_ARGUMENT;
+        if (status == MANCALA_OK)
+        {
+            status = moveStatus;
+        }
+        if (statuses != nullptr)
+        {
+            statuses[i] = moveStatus;
+        }
+    }
+    return status;
+}
+
+MANCALA_API int mancala_evaluate_batch(mancala_engine* engine, const mancala_position* positions, size_t count, float* scores)
+{
+    if (engine == nullptr || ((positions == nullptr || scores == nullptr) && count > 0))
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    int status = MANCALA_OK;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (MancalaApi::IsValid(&positions[i]))
+        {
+            scores[i] = engine->m_Engine.StaticEvaluation(MancalaApi::ToState(positions[i]));
+        }
+        else
+        {
+            scores[i] = std::numeric_limits<float>::quiet_NaN();
+            status = MANCALA_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    return status;
+}
+
+MANCALA_API int mancala_search_batch(mancala_engine* engine, const mancala_position* positions, size_t count, int depth, int time_limit_ms, int32_t* moves, float* scores)
+{
+    if (engine == nullptr || ((positions == nullptr || moves == nullptr) && count > 0))
+    {
+        return MANCALA_ERROR_INVALID_ARGUMENT;
+    }
+
+    int status = MANCALA_OK;
+    mancala_search_result result;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (MancalaApi::IsValid(&positions[i]))
+        {
+            MancalaApi::Search(engine->m_Engine, MancalaApi::ToState(positions[i]), depth, time_limit_ms, result);
+        }
+        else
+        {
+            result = { -1, 0, std::numeric_limits<float>::quiet_NaN(), 0 };
+            status = MANCALA_ERROR_INVALID_ARGUMENT;
+        }
+
+        moves[i] = result.best_move;
+        if (scores != nullptr)
+        {
+            scores[i] = result.score;
+        }
+    }
+    return status;
+}
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+/**
+ * @file mancala-api.h
+ * @brief Stable C interface of libmancala.
+ *
+ * Positions are plain structs owned by the caller. Engines are opaque handles that keep a transposition
+ * table between calls, so consecutive searches of related positions reuse earlier work. Functions that
+ * take no engine are safe to call from any thread; an engine must be used by one thread at a time, so
+ * multithreaded callers create one engine per thread.
+ *
+ * The batch entry points take arrays of positions and fill caller-provided arrays of moves and scores.
+ * They allocate nothing per position, so a single call amortizes the call overhead over thousands of
+ * queries.
+ *
+ * Moves are pit indices: 0 to 5 for player 1 and 7 to 12 for player 2. Scores are from player 1's point
+ * of view; won positions score MANCALA_WIN_SCORE plus the store difference.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(MANCALA_BUILD_LIBRARY)
+#define MANCALA_API __declspec(dllexport)
+#else
+#define MANCALA_API __declspec(dllimport)
+#endif
+#else
+#define MANCALA_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MANCALA_API_VERSION 1     /* Changes whenever a declaration of this file changes incompatibly */
+#define MANCALA_PITS 14           /* Pits 0-5 and store 6 for player 1, pits 7-12 and store 13 for player 2 */
+#define MANCALA_MAX_MOVES 6       /* A player never has more legal moves than pits on their side */
+#define MANCALA_WIN_SCORE 9000.0f
+
+/**
+ * @brief Status codes returned by the functions of the library.
+ */
+typedef enum mancala_status
+{
+	MANCALA_OK = 0,
+	MANCALA_ERROR_INVALID_ARGUMENT = -1, /* Null pointer, or a position that is not a valid board */
+	MANCALA_ERROR_ILLEGAL_MOVE = -2,
+	MANCALA_ERROR_GAME_OVER = -3
+} mancala_status;
+
+/**
+ * @brief Rulesets a position is played with.
+ */
+typedef enum mancala_ruleset
+{
+	MANCALA_RULESET_CLASSIC = 0,
+	MANCALA_RULESET_TURKISH = 1
+} mancala_ruleset;
+
+/**
+ * @brief A position: stones in every pit, the player to move and the ruleset.
+ */
+typedef struct mancala_position
+{
+	int8_t board[MANCALA_PITS];
+	int8_t turn;    /* 0 for player 1, 1 for player 2 */
+	int8_t ruleset; /* A mancala_ruleset */
+} mancala_position;
+
+/**
+ * @brief The outcome of a search.
+ */
+typedef struct mancala_search_result
+{
+	int32_t best_move; /* -1 when the position is over */
+	int32_t depth;     /* Depth of the last completed iteration */
+	float score;
+	uint64_t nodes;    /* Positions searched by the call */
+} mancala_search_result;
+
+typedef struct mancala_engine mancala_engine;
+
+/** @brief Returns MANCALA_API_VERSION of the library, to check it against the header at run time. */
+MANCALA_API int mancala_api_version(void);
+
+/** @brief Sets a position to the start of a game of the given ruleset. */
+MANCALA_API int mancala_position_init(mancala_position* position, int ruleset);
+
+/**
+ * @brief Checks that a position holds 48 stones in non-negative counts and a valid turn and ruleset.
+ *
+ * @return MANCALA_OK for a valid position, MANCALA_ERROR_INVALID_ARGUMENT otherwise.
+ */
+MANCALA_API int mancala_position_validate(const mancala_position* position);
+
+/**
+ * @brief Writes the legal moves of a position.
+ *
+ * @param moves Receives up to MANCALA_MAX_MOVES pit indices.
+ * @return The number of moves written, 0 when the game is over, or a negative status.
+ */
+MANCALA_API int mancala_legal_moves(const mancala_position* position, int8_t* moves);
+
+/**
+ * @brief Plays a move on a position in place.
+ *
+ * @return MANCALA_OK, or MANCALA_ERROR_ILLEGAL_MOVE / MANCALA_ERROR_GAME_OVER leaving the position unchanged.
+ */
+MANCALA_API int mancala_make_move(mancala_position* position, int move);
+
+/**
+ * @brief Reports whether a game is over and who won.
+ *
+ * @param winner Receives 0 or 1 for the winning player, 2 for a draw or a game still being played. May be null.
+ * @return 1 if the game is over, 0 if it is still being played, or a negative status.
+ */
+MANCALA_API int mancala_game_over(const mancala_position* position, int* winner);
+
+/**
+ * @brief Creates an engine with its own transposition table.
+ *
+ * @param table_megabytes Size of the table, 0 for the default.
+ * @return The engine, or null if it could not be created.
+ */
+MANCALA_API mancala_engine* mancala_engine_create(size_t table_megabytes);
+
+/** @brief Destroys an engine. Null is ignored. */
+MANCALA_API void mancala_engine_destroy(mancala_engine* engine);
+
+/** @brief Forgets every position the engine's transposition table holds. */
+MANCALA_API int mancala_engine_clear(mancala_engine* engine);
+
+/**
+ * @brief Evaluates a position without searching.
+ *
+ * @param score Receives the static evaluation.
+ */
+MANCALA_API int mancala_evaluate(mancala_engine* engine, const mancala_position* position, float* score);
+
+/**
+ * @brief Searches a position.
+ *
+ * With a time limit, iterative deepening stops the running iteration when the limit is reached and returns
+ * the result of the last completed one. The first iteration always completes, so a move is returned.
+ *
+ * @param depth Maximum depth, 1 to 79.
+ * @param time_limit_ms Time budget in milliseconds, 0 to search straight to the depth limit.
+ * @param result Receives the best move, score, depth reached and nodes searched.
+ */
+MANCALA_API int mancala_search(mancala_engine* engine, const mancala_position* position, int depth, int time_limit_ms, mancala_search_result* result);
+
+/**
+ * @brief Writes the legal moves of many positions.
+ *
+ * @param moves Receives MANCALA_MAX_MOVES entries per position, unused entries set to -1.
+ * @param counts Receives the number of legal moves of every position. May be null.
+ * @return MANCALA_OK, or MANCALA_ERROR_INVALID_ARGUMENT if any position is invalid (its counts entry is -1).
+ */
+MANCALA_API int mancala_legal_moves_batch(const mancala_position* positions, size_t count, int8_t* moves, int32_t* counts);
+
+/**
+ * @brief Plays one move on each of many positions in place.
+ *
+ * @param statuses Receives the status of every move. May be null.
+ * @return MANCALA_OK if every move was played, otherwise the status of the first move that was not.
+ */
+MANCALA_API int mancala_make_move_batch(mancala_position* positions, const int32_t* moves, size_t count, int32_t* statuses);
+
+/**
+ * @brief Evaluates many positions without searching.
+ *
+ * @param scores Receives one score per position, NaN for an invalid position.
+ */
+MANCALA_API int mancala_evaluate_batch(mancala_engine* engine, const mancala_position* positions, size_t count, float* scores);
+
+/**
+ * @brief Searches many positions with the same limits, in order, sharing the engine's transposition table.
+ *
+ * @param moves Receives the best move of every position, -1 for a finished or invalid position.
+ * @param scores Receives the score of every position. May be null.
+ * @return MANCALA_OK, or MANCALA_ERROR_INVALID_ARGUMENT if any position is invalid.
+ */
+MANCALA_API int mancala_search_batch(mancala_engine* engine, const mancala_position* positions, size_t count, int depth, int time_limit_ms, int32_t* moves, float* scores);
+
+#ifdef __cplusplus
+}
+#endif
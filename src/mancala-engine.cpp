@@ -1,14 +1,39 @@
 #include "mancala-engine.h"
 #include "timer.h"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+
+EvaluationWeights Minimax::s_DefaultWeights;
+std::shared_ptr<const NetworkEvaluator> Minimax::s_DefaultNetwork;
+std::shared_ptr<TranspositionTable> Minimax::s_SharedTable;
+
+
+/**
+ * @brief Constructs a Minimax object that searches with the given transposition table.
+ *
+ * The engine creates its own endgame table of EXACT_TABLE_SIZE megabytes.
+ *
+ * @param table The transposition table to read from and write to.
+ */
+Minimax::Minimax(const std::shared_ptr<TranspositionTable>& table) : Minimax(table, std::make_shared<TranspositionTable>(EXACT_TABLE_SIZE))
+{
+}
 
 /**
- * @brief Constructs a Minimax object.
+ * @brief Constructs a Minimax object that shares an existing transposition table and endgame table.
  *
- * This constructor initializes a Minimax object.
+ * Both tables can be shared by engines searching on different threads.
+ *
+ * @param table The transposition table to read from and write to.
+ * @param exactTable The table of exact endgame results to read from and write to.
  */
-Minimax::Minimax()
+Minimax::Minimax(const std::shared_ptr<TranspositionTable>& table, const std::shared_ptr<TranspositionTable>& exactTable) : m_Table(table), m_Stop(false), m_Deadline(std::chrono::steady_clock::time_point::max()), m_NodeLimit(ULLONG_MAX), m_Nodes(0), m_TableHits(0), m_Weights(s_DefaultWeights), m_Network(s_DefaultNetwork), m_Ply(0),
+    m_ExactTable(exactTable), m_ExactThreshold(DEFAULT_EXACT_THRESHOLD)
 {
+    m_Accumulators.resize(MAX_PLY);
     m_Ruleset = 0;
 }
 
@@ -35,43 +60,374 @@ Minimax::~Minimax()
  */
 float Minimax::minimax(const State& state, const char& depth, const float& alpha, const float& beta, const char& maximizingPlayer)
 {
+    // Few stones left: search to the end of the game with the final store difference as the score
+    if (state.TotalStones(0, 6) + state.TotalStones(7, 13) <= m_ExactThreshold)
+    {
+        return ExactScore(state, alpha, beta);
+    }
+
     if (depth == 0 || state.GameState() == GAMEOVER)
     {
         return Evaluate(state);
     }
 
+    if (m_Stop.load(std::memory_order_relaxed))
+    {
+        return 0.0F; // The search was aborted, the caller discards this value
+    }
+
+    if (++m_Nodes % LIMIT_CHECK_INTERVAL == 0)
+    {
+        CheckLimits();
+    }
+
+    float _alpha = alpha, _beta = beta;
+    char tableMove = -1;
+
+    // Reuse the result of an earlier search of this position
+    {
+        TranspositionEntry entry;
+        if (ProbeTable(state, entry))
+        {
+            m_TableHits++;
+            tableMove = entry.m_BestMove;
+            if (entry.m_Depth >= depth)
+            {
+                if (entry.m_Bound == EXACT)
+                {
+                    return entry.m_Score;
+                }
+                else if (entry.m_Bound == LOWER_BOUND)
+                {
+                    _alpha = std::max(_alpha, entry.m_Score);
+                }
+                else
+                {
+                    _beta = std::min(_beta, entry.m_Score);
+                }
+
+                if (_alpha >= _beta)
+                {
+                    return entry.m_Score;
+                }
+            }
+        }
+    }
+
+    const float searchAlpha = _alpha, searchBeta = _beta; // Window the children are searched with
+    MoveList legalMoves = state.LegalMoves();
+    OrderMoves(legalMoves, tableMove);
+
+    float value;
+    char bestMove = -1;
     if (maximizingPlayer)
     {
-        float value = -9999.0F, _alpha = alpha, _beta = beta;
-        std::vector<char> legalMoves = state.LegalMoves();
+        value = -9999.0F;
         for (const char& move : legalMoves)
         {
             const State& nextState = state.NextState(move);
-            value = std::max(value, minimax(nextState, depth - 1, _alpha, _beta, nextState.m_Turn == 0));
+            PushPosition(state, nextState);
+            const float val = minimax(nextState, depth - 1, _alpha, _beta, nextState.m_Turn == 0);
+            PopPosition();
+            if (val > value || bestMove == -1)
+            {
+                value = val;
+                bestMove = move;
+            }
             if (value >= _beta)
             {
                 break;
             }
             _alpha = std::max(_alpha, value);
         }
-        return value;
     }
     else
     {
-        float value = 9999.0F, _alpha = alpha, _beta = beta;
-        std::vector<char> legalMoves = state.LegalMoves();
+        value = 9999.0F;
         for (const char& move : legalMoves)
         {
             const State& nextState = state.NextState(move);
-            value = std::min(value, minimax(nextState, depth - 1, _alpha, _beta, nextState.m_Turn == 0));
+            PushPosition(state, nextState);
+            const float val = minimax(nextState, depth - 1, _alpha, _beta, nextState.m_Turn == 0);
+            PopPosition();
+            if (val < value || bestMove == -1)
+            {
+                value = val;
+                bestMove = move;
+            }
+            if (value <= _alpha)
+            {
+                break;
+            }
+            _beta = std::min(_beta, value);
+        }
+    }
+
+    if (!m_Stop.load(std::memory_order_relaxed))
+    {
+        const BoundEnum bound = value <= searchAlpha ? UPPER_BOUND : (value >= searchBeta ? LOWER_BOUND : EXACT);
+        StoreTable(state, value, depth, bestMove, bound);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Maps a final store difference to the score scale of the search.
+ *
+ * Wins and losses are pushed beyond every heuristic score while keeping their margin.
+ *
+ * @param difference Player 1's store minus player 2's at the end of the game.
+ * @return The score of the game result.
+ */
+float Minimax::ExactToScore(const int& difference)
+{
+    if (difference > 0)
+    {
+        return WIN_SCORE + difference;
+    }
+    else if (difference < 0)
+    {
+        return -WIN_SCORE + difference;
+    }
+    return 0.0F;
+}
+
+/**
+ * @brief Scores an endgame position by searching it to the end.
+ *
+ * The alpha-beta window is translated to store differences so the exact search prunes as tightly as
+ * the caller's window allows.
+ *
+ * @param state The endgame position.
+ * @param alpha The alpha value of the caller.
+ * @param beta The beta value of the caller.
+ * @return The score of the final store difference, a bound when outside the window.
+ */
+float Minimax::ExactScore(const State& state, const float& alpha, const float& beta)
+{
+    // The final difference lies within the stones in play; one past it stands for "no such difference"
+    const float total = (float)(state.TotalStones(0, 6) + state.TotalStones(7, 13) + state.m_Board[6] + state.m_Board[13]);
+
+    // Inverts ExactToScore: the largest difference scoring at most alpha, the smallest difference scoring at least beta
+    float exactAlpha = alpha >= WIN_SCORE + 1.0F ? std::floor(alpha - WIN_SCORE) : alpha >= 0.0F ? 0.0F : std::min(-1.0F, std::floor(alpha + WIN_SCORE));
+    float exactBeta = beta <= -WIN_SCORE - 1.0F ? std::ceil(beta + WIN_SCORE) : beta <= 0.0F ? 0.0F : std::max(1.0F, std::ceil(beta - WIN_SCORE));
+    exactAlpha = std::clamp(exactAlpha, -total - 1.0F, total);
+    exactBeta = std::clamp(exactBeta, -total, total + 1.0F);
+
+    return ExactToScore(ExactSearch(state, (int)exactAlpha, (int)exactBeta));
+}
+
+/**
+ * @brief Searches an endgame position with the final store difference as its value.
+ *
+ * The game is played until every stone is in a store, even after one store passed a majority. The stones still
+ * on the board bound the final difference, which prunes every position whose bound is outside the window.
+ *
+ * @param state The endgame position.
+ * @param alpha Lower end of the window, in stones.
+ * @param beta Upper end of the window, in stones.
+ * @return The final store difference (player 1 minus player 2), a bound when outside the window.
+ */
+int Minimax::ExactSearch(const State& state, const int& alpha, const int& beta)
+{
+    const int difference = state.m_Board[6] - state.m_Board[13];
+    const int remaining = state.TotalStones(0, 6) + state.TotalStones(7, 13);
+
+    if (remaining == 0)
+    {
+        return difference;
+    }
+    if (difference + remaining <= alpha)
+    {
+        return difference + remaining; // Even taking every remaining stone does not reach alpha
+    }
+    if (difference - remaining >= beta)
+    {
+        return difference - remaining; // Even losing every remaining stone stays above beta
+    }
+
+    if (m_Stop.load(std::memory_order_relaxed))
+    {
+        return 0; // The search was aborted, the caller discards this value
+    }
+
+    if (++m_Nodes % LIMIT_CHECK_INTERVAL == 0)
+    {
+        CheckLimits();
+    }
+
+    MoveList legalMoves = state.LegalMoves();
+    if (legalMoves.empty())
+    {
+        // Only reachable from an edited board: the player to move has no stones, the rest is swept
+        const int opponentStones = state.m_Turn == 0 ? state.TotalStones(7, 13) : state.TotalStones(0, 6);
+        const int sweptToPlayer1 = (state.m_Ruleset == 1) == (state.m_Turn == 0) ? opponentStones : -opponentStones;
+        return difference + sweptToPlayer1;
+    }
+
+    int _alpha = alpha, _beta = beta;
+    char tableMove = -1;
+    {
+        TranspositionEntry entry;
+        if (m_ExactTable->Probe(state, entry))
+        {
+            tableMove = entry.m_BestMove;
+            if (entry.m_Bound == EXACT)
+            {
+                return (int)entry.m_Score;
+            }
+            else if (entry.m_Bound == LOWER_BOUND)
+            {
+                _alpha = std::max(_alpha, (int)entry.m_Score);
+            }
+            else
+            {
+                _beta = std::min(_beta, (int)entry.m_Score);
+            }
+
+            if (_alpha >= _beta)
+            {
+                return (int)entry.m_Score;
+            }
+        }
+    }
+
+    const int searchAlpha = _alpha, searchBeta = _beta;
+    OrderMoves(legalMoves, tableMove);
+
+    const bool maximizingPlayer = state.m_Turn == 0;
+    int value = maximizingPlayer ? difference - remaining : difference + remaining;
+    char bestMove = -1;
+    for (const char& move : legalMoves)
+    {
+        const int val = ExactSearch(state.NextState(move), _alpha, _beta);
+        if (bestMove == -1 || (maximizingPlayer ? val > value : val < value))
+        {
+            value = val;
+            bestMove = move;
+        }
+
+        if (maximizingPlayer)
+        {
+            if (value >= _beta)
+            {
+                break;
+            }
+            _alpha = std::max(_alpha, value);
+        }
+        else
+        {
             if (value <= _alpha)
             {
                 break;
             }
             _beta = std::min(_beta, value);
         }
-        return value;
     }
+
+    if (!m_Stop.load(std::memory_order_relaxed))
+    {
+        const BoundEnum bound = value <= searchAlpha ? UPPER_BOUND : (value >= searchBeta ? LOWER_BOUND : EXACT);
+        m_ExactTable->Store(state, (float)value, 0, bestMove, bound);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Sets how few stones have to be left on the board for the exact endgame search to take over.
+ *
+ * @param stones The number of stones on the board (stores excluded), 0 disables the exact search.
+ */
+void Minimax::SetExactThreshold(const int& stones)
+{
+    m_ExactThreshold = stones;
+}
+
+/**
+ * @brief Makes the given position the root of the search stack.
+ *
+ * @param state The position the search starts from.
+ */
+void Minimax::SetRoot(const State& state)
+{
+    m_Ply = 0;
+    if (m_Network)
+    {
+        m_Network->Refresh(state, m_Accumulators[0]);
+    }
+}
+
+/**
+ * @brief Descends one ply into the search tree.
+ *
+ * When the network evaluator is used, the first layer of the child is derived from the parent by
+ * updating only the pits the move changed.
+ *
+ * @param state The position before the move.
+ * @param nextState The position after the move.
+ */
+void Minimax::PushPosition(const State& state, const State& nextState)
+{
+    if (m_Network)
+    {
+        m_Network->Update(m_Accumulators[m_Ply], state, nextState, m_Accumulators[m_Ply + 1]);
+    }
+    m_Ply++;
+}
+
+/**
+ * @brief Returns to the parent position after a child was searched.
+ */
+void Minimax::PopPosition()
+{
+    m_Ply--;
+}
+
+/**
+ * @brief Looks a position up in the transposition table.
+ *
+ * The table shares one entry between a position and its player-swapped mirror, which holds as long as
+ * the evaluation scores the mirror with the opposite sign, as the weighted features do. The network
+ * evaluator sees absolute pits and the turn and is not trained on mirrored positions, so while one is
+ * loaded positions are kept under their own key.
+ *
+ * @param state The position to look up.
+ * @param entry Receives the stored entry, in the frame of the position.
+ * @return True if the position was found, false otherwise.
+ */
+bool Minimax::ProbeTable(const State& state, TranspositionEntry& entry) const
+{
+    return m_Network ? m_Table->Probe(state.Hash(), entry) : m_Table->Probe(state, entry);
+}
+
+/**
+ * @brief Stores a search result in the transposition table, under the key ProbeTable looks it up by.
+ */
+void Minimax::StoreTable(const State& state, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound)
+{
+    if (m_Network)
+    {
+        m_Table->Store(state.Hash(), score, depth, bestMove, bound);
+    }
+    else
+    {
+        m_Table->Store(state, score, depth, bestMove, bound);
+    }
+}
+
+/**
+ * @brief Moves the given move to the front of the move list.
+ *
+ * Searching the best move of a previous search first produces the most cutoffs.
+ *
+ * @param moves The legal moves of a position.
+ * @param firstMove The move to search first, -1 to keep the original order.
+ */
+void Minimax::OrderMoves(MoveList& moves, const char& firstMove) const
+{
+    moves.MoveToFront(firstMove);
 }
 
 /**
@@ -84,53 +440,220 @@ float Minimax::minimax(const State& state, const char& depth, const float& alpha
  */
 float Minimax::Evaluate(const State& state)
 {
-    if (state.m_Board[6] > 24)
+    if (state.m_Board[6] > ClassicGeometry::MAJORITY)
+    {
+        return WIN_SCORE + (state.m_Board[6] - state.m_Board[13]); // Wins are ranked by their margin
+    }
+    else if (state.m_Board[13] > ClassicGeometry::MAJORITY)
     {
-        return 9999;
+        return -WIN_SCORE + (state.m_Board[6] - state.m_Board[13]);
     }
-    else if (state.m_Board[13] > 24)
+    else if (m_Network)
     {
-        return -9999;
+        return m_Network->Evaluate(m_Accumulators[m_Ply]);
     }
     else {
-        int ourStoreIndex = 6 + state.m_Turn * 7;
-        int opponentsStoreIndex = 6 + (1-state.m_Turn) * 7;
-        int ourCaptureOpportunities = 0;
-        int opponentsCaptureOpportunities = 0;
+        float features[FEATURE_COUNT];
+        Features(state, features);
 
-        State* copyState = new State();
-        copyState->m_Board = state.m_Board;
-        copyState->m_Ruleset = state.m_Ruleset;
-        copyState->m_Turn = state.m_Turn;
-
-        std::vector<char> legalMoves = copyState->LegalMoves();
-        std::vector<State*> nextStates = {};
-        for (char move : legalMoves)
-        {
-            auto nextState = copyState->NextState(move);
-            nextStates.push_back(&nextState);
-        }
-        for (const State* _state : nextStates)
+        float score = 0.0F;
+        for (int i = 0; i < FEATURE_COUNT; ++i)
         {
-            ourCaptureOpportunities += _state->m_Board[ourStoreIndex] - copyState->m_Board[ourStoreIndex];
+            score += m_Weights.m_Weights[i] * features[i];
         }
+        return score;
+    }
+}
 
-        copyState->m_Turn = 1 - state.m_Turn;
-        legalMoves = copyState->LegalMoves();
-        nextStates = {};
-        for (char move : legalMoves)
-        {
-            auto nextState = copyState->NextState(move);
-            nextStates.push_back(&nextState);
-        }
-        for (const State* _state : nextStates)
+/**
+ * @brief Extracts the evaluation features of a position.
+ *
+ * Every feature is a difference between player 1 and player 2, so the weighted sum of the features
+ * is a score from player 1's point of view regardless of whose turn it is.
+ *
+ * @param state The game state to extract the features from.
+ * @param features Receives FEATURE_COUNT feature values, indexed by FeatureEnum.
+ */
+void Minimax::Features(const State& state, float* features)
+{
+    State copyState = state;
+    int storeGains[2] = { 0, 0 }; // Stones each player can bring into their store with one move
+    int extraTurns[2] = { 0, 0 }; // Moves that let each player move again
+
+    for (int player = 0; player < 2; ++player)
+    {
+        const int storeIndex = 6 + player * 7;
+        copyState.m_Turn = (char)player;
+        for (char move : copyState.LegalMoves())
         {
-            opponentsCaptureOpportunities += _state->m_Board[opponentsStoreIndex] - copyState->m_Board[opponentsStoreIndex];
+            const State nextState = copyState.NextState(move);
+            storeGains[player] += nextState.m_Board[storeIndex] - copyState.m_Board[storeIndex];
+            extraTurns[player] += nextState.m_Turn == player ? 1 : 0;
         }
+    }
+
+    features[STORE_DIFFERENCE] = (float)(state.m_Board[6] - state.m_Board[13]);
+    features[CAPTURE_OPPORTUNITIES] = (float)(storeGains[0] - storeGains[1]);
+    features[SIDE_STONES] = (float)(state.TotalStones(0, 6) - state.TotalStones(7, 13));
+    features[EXTRA_TURNS] = (float)(extraTurns[0] - extraTurns[1]);
+}
+
+/**
+ * @brief Replaces the evaluation weights of this engine.
+ *
+ * @param weights The weights to evaluate positions with.
+ */
+void Minimax::SetWeights(const EvaluationWeights& weights)
+{
+    m_Weights = weights;
+}
+
+/**
+ * @brief Returns the evaluation weights of this engine.
+ *
+ * @return The weights positions are evaluated with.
+ */
+const EvaluationWeights& Minimax::GetWeights() const
+{
+    return m_Weights;
+}
 
-        return (1 - 2 * state.m_Turn) * 0.8 * (state.m_Board[ourStoreIndex] - state.m_Board[opponentsStoreIndex]) + (1 - 2 * state.m_Turn)* 0.2 * (ourCaptureOpportunities - opponentsCaptureOpportunities);
+/**
+ * @brief Loads the weights every engine constructed afterwards starts with.
+ *
+ * @param filename Path of a weights file written by EvaluationWeights::Save.
+ * @return True if the file was read, false if the built-in weights are kept.
+ */
+bool Minimax::LoadDefaultWeights(const std::string& filename)
+{
+    return s_DefaultWeights.Load(filename);
+}
+
+/**
+ * @brief Replaces the network evaluator of this engine.
+ *
+ * @param network The network to evaluate positions with, nullptr to use the evaluation weights.
+ */
+void Minimax::SetNetwork(const std::shared_ptr<const NetworkEvaluator>& network)
+{
+    m_Network = network;
+}
+
+/**
+ * @brief Loads the network every engine constructed afterwards evaluates with.
+ *
+ * @param filename Path of a network file written by NetworkEvaluator::Save.
+ * @return True if the network was loaded, false if engines keep using the evaluation weights.
+ */
+bool Minimax::LoadDefaultNetwork(const std::string& filename)
+{
+    std::shared_ptr<NetworkEvaluator> network = std::make_shared<NetworkEvaluator>();
+    if (!network->Load(filename))
+    {
+        return false;
+    }
+
+    s_DefaultNetwork = network;
+    return true;
+}
+
+/**
+ * @brief Returns the network every engine starts with.
+ *
+ * @return The default network, nullptr when none was loaded.
+ */
+const std::shared_ptr<const NetworkEvaluator>& Minimax::DefaultNetwork()
+{
+    return s_DefaultNetwork;
+}
+
+/**
+ * @brief Opens the shared-memory transposition table SessionTable hands out afterwards.
+ *
+ * Engines in every process that opens the same name share their search results.
+ *
+ * @param name Name of the shared-memory segment.
+ * @param sizeInMegabytes Size of the table if this process creates it.
+ * @param hugePages Whether to ask for huge pages.
+ * @return True if the table is shared, false if it fell back to memory private to this process.
+ */
+bool Minimax::OpenSharedTable(const std::string& name, const size_t& sizeInMegabytes, const bool& hugePages)
+{
+    s_SharedTable = std::make_shared<TranspositionTable>(name, sizeInMegabytes, hugePages);
+    return s_SharedTable->Shared();
+}
+
+/**
+ * @brief Returns the table of an engine that plays or analyzes for the user.
+ *
+ * Such engines search with the shared-memory table once OpenSharedTable has opened one. Engines of
+ * offline jobs create tables sized for their work instead.
+ *
+ * @param sizeInMegabytes Size of the table created when no shared table is open.
+ * @return The shared table, or a new table private to the caller.
+ */
+std::shared_ptr<TranspositionTable> Minimax::SessionTable(const size_t& sizeInMegabytes)
+{
+    return s_SharedTable ? s_SharedTable : std::make_shared<TranspositionTable>(sizeInMegabytes);
+}
+
+/**
+ * @brief Returns the weights every engine starts with.
+ *
+ * @return The default evaluation weights.
+ */
+const EvaluationWeights& Minimax::DefaultWeights()
+{
+    return s_DefaultWeights;
+}
+
+/**
+ * @brief Reads weights from a binary file.
+ *
+ * The file holds the feature count followed by one float per feature. Files written for a
+ * different feature count are rejected.
+ *
+ * @param filename Path of the weights file.
+ * @return True if the weights were read, false otherwise.
+ */
+bool EvaluationWeights::Load(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
     }
- }
+
+    int count = 0;
+    float weights[FEATURE_COUNT];
+    if (!file.read((char*)&count, sizeof(count)) || count != FEATURE_COUNT || !file.read((char*)weights, sizeof(weights)))
+    {
+        return false;
+    }
+
+    std::copy(weights, weights + FEATURE_COUNT, m_Weights);
+    return true;
+}
+
+/**
+ * @brief Writes the weights to a binary file.
+ *
+ * @param filename Path of the weights file.
+ * @return True if the file was written, false otherwise.
+ */
+bool EvaluationWeights::Save(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    const int count = FEATURE_COUNT;
+    file.write((const char*)&count, sizeof(count));
+    file.write((const char*)m_Weights, sizeof(m_Weights));
+    return (bool)file;
+}
 
 /**
  * @brief Calculates the best move using the Minimax algorithm.
@@ -143,69 +666,292 @@ float Minimax::Evaluate(const State& state)
  */
 char Minimax::BestMove(const State& state, const char& depth, const bool &log)
 {
-    std::vector<char> legalMoves = state.LegalMoves();
+    return Search(state, depth, log).m_BestMove;
+}
 
-    if (state.m_Turn == 0)
-    {
-        float bestValue = -9999.0F;
-        char bestMove = -1;
+/**
+ * @brief Searches the position and reports the best move together with its score and principal variation.
+ *
+ * The root score is the minimax value of the position reached by the best move, so callers can use it as
+ * the evaluation of the position after the move without searching again.
+ *
+ * @param state The current game state.
+ * @param depth The maximum depth to search in the game tree.
+ * @param log Prints the score of every root move when true.
+ * @return The result of the search.
+ */
+SearchResult Minimax::Search(const State& state, const char& depth, const bool& log)
+{
+    TraceZone zone("search");
+    MoveList legalMoves = state.LegalMoves();
+    const unsigned long long startNodes = m_Nodes;
+    SetRoot(state);
 
-        for (const char& move : legalMoves)
+    // Start with the best move of the previous iteration
+    {
+        TranspositionEntry entry;
+        if (ProbeTable(state, entry))
         {
-            const State& nextState = state.NextState(move);
-            float val = minimax(nextState, depth, -9999.0F, 9999.0F, nextState.m_Turn == 0);
+            OrderMoves(legalMoves, entry.m_BestMove);
+        }
+    }
 
-            if (log)
-            {
-                std::cout << "move: " << (int)move << " score: " << val << "\n";
-            }
+    float bestValue = state.m_Turn == 0 ? -9999.0F : 9999.0F;
+    char bestMove = -1;
 
-            if (val >= bestValue)
-            {
-                bestValue = val;
-                bestMove = move;
-            }
+    for (const char& move : legalMoves)
+    {
+        const State& nextState = state.NextState(move);
+        PushPosition(state, nextState);
+        float val = minimax(nextState, depth, -9999.0F, 9999.0F, nextState.m_Turn == 0);
+        PopPosition();
+
+        if (IsStopped())
+        {
+            break;
         }
 
-        if (bestMove == -1)
+        if (log)
         {
-            std::cout << "Error\n";
+            std::cout << "move: " << (int)move << " score: " << val << "\n";
         }
 
-        return bestMove;
+        if ((state.m_Turn == 0 && val >= bestValue) || (state.m_Turn != 0 && val <= bestValue))
+        {
+            bestValue = val;
+            bestMove = move;
+        }
     }
-    else
+
+    if (bestMove == -1 && !IsStopped())
     {
-        float bestValue = 9999.0F;
-        char bestMove = -1;
-        for (const char& move : legalMoves)
-        {
-            const State& nextState = state.NextState(move);
-            float val = minimax(nextState, depth, -9999.0F, 9999.0F, nextState.m_Turn == 0);
+        std::cout << "Error\n";
+    }
 
-            if (log)
-            {
-                std::cout << "move: " << (int)move << " score: " << val << "\n";
-            }
+    SearchResult result;
+    result.m_BestMove = bestMove;
+    result.m_Score = bestValue;
+    result.m_Depth = depth;
+
+    if (!IsStopped() && bestMove != -1)
+    {
+        // Every root move was searched with a full window, so the root value is exact
+        StoreTable(state, bestValue, depth + 1, bestMove, EXACT);
+        result.m_VariationLength = PrincipalVariation(state, depth + 1, result.m_PrincipalVariation);
+    }
+
+    result.m_Nodes = m_Nodes - startNodes;
+    return result;
+}
 
-            if (val <= bestValue)
+/**
+ * @brief Searches the position for its best root moves, each with an exact score and principal variation.
+ *
+ * Root moves are tried in the order of the scores an earlier search stored for the positions they lead
+ * to, so with iterative deepening the lines of the previous depth come first. Until the requested number
+ * of lines is known a move is searched with an aspiration window around its stored score, widened only
+ * when the score falls outside it; after that a move is searched with a window that only admits scores
+ * better than the worst line, so moves that do not make the list fail low cheaply. Every line shares the
+ * transposition table.
+ *
+ * @param state The current game state.
+ * @param depth The maximum depth to search in the game tree.
+ * @param lines Number of best moves to return, at most MultiPVResult::MAX_LINES.
+ * @return The best moves, best first; fewer than requested if the position has fewer legal moves.
+ */
+MultiPVResult Minimax::SearchMultiPV(const State& state, const char& depth, const int& lines)
+{
+    TraceZone zone("search-multipv");
+    const unsigned long long startNodes = m_Nodes;
+    const int wanted = std::clamp(lines, 1, MultiPVResult::MAX_LINES);
+    const bool maximizing = state.m_Turn == 0;
+    const auto better = [maximizing](const float& a, const float& b) { return maximizing ? a > b : a < b; };
+    SetRoot(state);
+
+    // Order the root moves by stored scores, moves without one last and the stored best move first
+    constexpr float NO_GUESS = 99999.0F;
+    MoveList legalMoves = state.LegalMoves();
+    float guesses[6];
+    {
+        TranspositionEntry entry;
+        const char tableMove = ProbeTable(state, entry) ? entry.m_BestMove : -1;
+        float keys[6];
+        for (size_t i = 0; i < legalMoves.size(); ++i)
+        {
+            const char move = legalMoves[i];
+            guesses[i] = ProbeTable(state.NextState(move), entry) ? entry.m_Score : NO_GUESS;
+            keys[i] = guesses[i] != NO_GUESS ? guesses[i] : (maximizing ? -99999.0F : 99999.0F);
+            keys[i] = move == tableMove ? (maximizing ? 99999.0F : -99999.0F) : keys[i];
+        }
+        for (size_t i = 1; i < legalMoves.size(); ++i)
+        {
+            for (size_t j = i; j > 0 && better(keys[j], keys[j - 1]); --j)
             {
-                bestValue = val;
-                bestMove = move;
+                std::swap(keys[j], keys[j - 1]);
+                std::swap(guesses[j], guesses[j - 1]);
+                std::swap(legalMoves.m_Moves[j], legalMoves.m_Moves[j - 1]);
             }
         }
+    }
+
+    MultiPVResult result;
+    result.m_Depth = depth;
+    for (size_t i = 0; i < legalMoves.size(); ++i)
+    {
+        // Once the list is full a move only needs to be searched exactly if it beats the worst line
+        const char move = legalMoves[i];
+        const bool listFull = result.m_LineCount == wanted;
+        const float worst = listFull ? result.m_Lines[wanted - 1].m_Score : 0.0F;
+        float alpha = listFull && maximizing ? worst : -9999.0F;
+        float beta = listFull && !maximizing ? worst : 9999.0F;
+
+        // Otherwise the score of the previous depth bounds the window, which widens on every miss
+        float margin = ASPIRATION_WINDOW;
+        if (!listFull && guesses[i] != NO_GUESS)
+        {
+            alpha = std::max(guesses[i] - margin, -9999.0F);
+            beta = std::min(guesses[i] + margin, 9999.0F);
+        }
+
+        const State& nextState = state.NextState(move);
+        PushPosition(state, nextState);
+        float val = minimax(nextState, depth, alpha, beta, nextState.m_Turn == 0);
+        while (!listFull && !IsStopped() && ((val <= alpha && alpha > -9999.0F) || (val >= beta && beta < 9999.0F)))
+        {
+            margin *= 4.0F;
+            alpha = val <= alpha ? std::max(val - margin, -9999.0F) : alpha;
+            beta = val >= beta ? std::min(val + margin, 9999.0F) : beta;
+            val = minimax(nextState, depth, alpha, beta, nextState.m_Turn == 0);
+        }
+        PopPosition();
 
-        if (bestMove == -1)
+        if (IsStopped())
+        {
+            break;
+        }
+        if (listFull && !better(val, worst))
         {
-            std::cout << "Error\n";
+            continue; // Failed low, val is only a bound
         }
 
-        return bestMove;
+        // Insert the line in order, dropping the worst one when the list is full
+        int index = std::min<int>(result.m_LineCount, wanted - 1);
+        for (; index > 0 && better(val, result.m_Lines[index - 1].m_Score); --index)
+        {
+            result.m_Lines[index] = result.m_Lines[index - 1];
+        }
+        PrincipalLine& line = result.m_Lines[index];
+        line.m_Move = move;
+        line.m_Score = val;
+        line.m_Variation[0] = move;
+        line.m_VariationLength = 1 + PrincipalVariation(nextState, std::min<int>(depth, SearchResult::MAX_VARIATION - 1), line.m_Variation + 1);
+        result.m_LineCount = std::min(result.m_LineCount + 1, wanted);
     }
+
+    if (!IsStopped() && result.m_LineCount > 0)
+    {
+        StoreTable(state, result.m_Lines[0].m_Score, depth + 1, result.m_Lines[0].m_Move, EXACT);
+    }
+
+    result.m_Nodes = m_Nodes - startNodes;
+    return result;
+}
+
+/**
+ * @brief Follows the best moves stored in the transposition table from the given position.
+ *
+ * @param state The position to start from.
+ * @param length The maximum number of moves to return, at most SearchResult::MAX_VARIATION.
+ * @param variation Receives the sequence of best moves for both players.
+ * @return The number of moves written.
+ */
+int Minimax::PrincipalVariation(const State& state, const int& length, char* variation) const
+{
+    int count = 0;
+    State current = state;
+    TranspositionEntry entry;
+
+    while (count < std::min<int>(length, SearchResult::MAX_VARIATION) && current.GameState() != GAMEOVER && ProbeTable(current, entry))
+    {
+        if (!current.IsLegal(entry.m_BestMove))
+        {
+            break;
+        }
+        variation[count++] = entry.m_BestMove;
+        current.MakeMove(entry.m_BestMove);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Returns the score of the position as stored by an earlier search.
+ *
+ * @param state The game state to look up.
+ * @param score Receives the stored score when found.
+ * @return True if the transposition table holds an exact score for the position, false otherwise.
+ */
+bool Minimax::StoredScore(const State& state, float& score) const
+{
+    TranspositionEntry entry;
+    if (ProbeTable(state, entry) && entry.m_Bound == EXACT)
+    {
+        score = entry.m_Score;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the number of positions searched by this engine so far.
+ *
+ * @return The node count.
+ */
+unsigned long long Minimax::Nodes() const
+{
+    return m_Nodes;
+}
+
+/**
+ * @brief Returns how many of the searched positions were found in the transposition table.
+ *
+ * @return The hit count, the hit rate is TableHits() / Nodes().
+ */
+unsigned long long Minimax::TableHits() const
+{
+    return m_TableHits;
+}
+
+/**
+ * @brief Evaluates a position without searching, with the weights or network of this engine.
+ *
+ * @param state The game state to evaluate.
+ * @return The score Evaluate gives the state at the root of a search.
+ */
+float Minimax::StaticEvaluation(const State& state)
+{
+    SetRoot(state);
+    return Evaluate(state);
 }
 
+/**
+ * @brief Estimates the score of a position with a short search.
+ *
+ * Returns the score stored by an earlier search when available, which makes it free right after
+ * the position was searched.
+ *
+ * @param state The game state to evaluate.
+ * @return The evaluation score of the state.
+ */
 float Minimax::EvaluationScore(const State& state)
 {
+    {
+        float stored;
+        if (StoredScore(state, stored))
+        {
+            return stored;
+        }
+    }
 
     float duration = 0.0; // Initialize duration for time limit
     char depth = 5; // Initial depth for minimax search
@@ -213,10 +959,85 @@ float Minimax::EvaluationScore(const State& state)
 
     while (duration < 10 && depth < 80)
     {
-        Timer timer(&duration); // Start timer
+        Timer timer(&duration, "evaluation score iteration"); // Start timer
+        SetRoot(state);
         score = minimax(state, depth, -9999.0F, 9999.0F, state.m_Turn == 0);
         depth++; // Increment depth for next iteration
     }
 
     return score;
 }
+
+
+/**
+ * @brief Asks the running search to return as soon as possible.
+ *
+ * Safe to call from another thread. Results of an aborted search are not stored in the
+ * transposition table.
+ */
+void Minimax::Stop()
+{
+    m_Stop.store(true);
+}
+
+/**
+ * @brief Allows searches to run again after Stop() was called.
+ */
+void Minimax::Resume()
+{
+    m_Stop.store(false);
+}
+
+/**
+ * @brief Checks whether the engine was asked to stop searching.
+ *
+ * @return True if Stop() was called and Resume() was not called since.
+ */
+bool Minimax::IsStopped() const
+{
+    return m_Stop.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Makes the searches of this engine stop themselves at a deadline or node count.
+ *
+ * The running search checks the limits every LIMIT_CHECK_INTERVAL nodes and, once one is reached,
+ * stops as if Stop() was called. The limits hold until ClearLimits; call Resume to search again.
+ *
+ * @param deadline Time to stop at, time_point::max() for none.
+ * @param nodeLimit Value of Nodes() to stop at, ULLONG_MAX for none.
+ */
+void Minimax::SetLimits(const std::chrono::steady_clock::time_point& deadline, const unsigned long long& nodeLimit)
+{
+    m_Deadline = deadline;
+    m_NodeLimit = nodeLimit;
+}
+
+/**
+ * @brief Removes the limits set by SetLimits.
+ */
+void Minimax::ClearLimits()
+{
+    SetLimits(std::chrono::steady_clock::time_point::max(), ULLONG_MAX);
+}
+
+/**
+ * @brief Stops the search once the deadline or the node limit is reached.
+ */
+void Minimax::CheckLimits()
+{
+    if (m_Nodes >= m_NodeLimit || (m_Deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= m_Deadline))
+    {
+        m_Stop.store(true, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Gives access to the transposition table of the engine.
+ *
+ * @return The transposition table used by the engine.
+ */
+std::shared_ptr<TranspositionTable> Minimax::GetTranspositionTable() const
+{
+    return m_Table;
+}
\ No newline at end of file
@@ -6,11 +6,80 @@
 #include <vector>
 #include <algorithm>
 #include <ctime>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
 #include "state.h"
+#include "transposition-table.h"
+#include "network-evaluator.h"
 
 
 
+/**
+ * @brief Enumerates the features the evaluation function is a weighted sum of.
+ */
+enum FeatureEnum
+{
+	STORE_DIFFERENCE,      // Stones in player 1's store minus player 2's
+	CAPTURE_OPPORTUNITIES, // Stones player 1 can bring into their store with one move minus player 2's
+	SIDE_STONES,           // Stones on player 1's side minus player 2's
+	EXTRA_TURNS,           // Moves that give player 1 another turn minus player 2's
+	FEATURE_COUNT
+};
+
+/**
+ * @brief Weights of the evaluation features, either built in or tuned offline.
+ */
+struct EvaluationWeights
+{
+	float m_Weights[FEATURE_COUNT] = { 0.8F, 0.2F, 0.0F, 0.0F };
+
+	bool Load(const std::string& filename);
+	bool Save(const std::string& filename) const;
+};
+
+
+/**
+ * @brief The outcome of a search from the root position.
+ */
+struct SearchResult
+{
+	static constexpr int MAX_VARIATION = 80; // Iterative deepening never searches deeper than this
+
+	char m_BestMove = -1;                     // Best move found, -1 if the search was stopped before finishing a move
+	float m_Score = 0.0F;                     // Score of the position after the best move, from player 1's point of view
+	char m_Depth = 0;                         // Depth the root moves were searched with
+	char m_PrincipalVariation[MAX_VARIATION]; // Expected line of play starting with the best move, stored inline
+	int m_VariationLength = 0;                // Moves in m_PrincipalVariation
+	unsigned long long m_Nodes = 0;           // Positions searched
+};
+
+/**
+ * @brief One line of a multi-PV search: a root move with its exact score and expected continuation.
+ */
+struct PrincipalLine
+{
+	char m_Move = -1;
+	float m_Score = 0.0F;                                   // From player 1's point of view
+	char m_Variation[SearchResult::MAX_VARIATION];          // Starts with m_Move
+	int m_VariationLength = 0;
+};
+
+/**
+ * @brief The best root moves of a multi-PV search, best first, stored inline.
+ */
+struct MultiPVResult
+{
+	static constexpr int MAX_LINES = 6; // A player never has more moves than pits on their side
+
+	PrincipalLine m_Lines[MAX_LINES];
+	int m_LineCount = 0;
+	char m_Depth = 0;
+	unsigned long long m_Nodes = 0;
+};
+
+
 /**
  * @brief A class for implementing the Minimax algorithm.
  *
@@ -22,15 +91,76 @@ class Minimax
 private:
 
 	int m_Ruleset;
+	std::shared_ptr<TranspositionTable> m_Table; // Survives between searches so later moves reuse earlier work
+	std::atomic<bool> m_Stop;                    // Set from another thread to abort the running search
+	std::chrono::steady_clock::time_point m_Deadline; // The search stops itself at this time, max() for none
+	unsigned long long m_NodeLimit;              // The search stops itself once m_Nodes reaches this
+	unsigned long long m_Nodes;                  // Positions searched since construction
+	unsigned long long m_TableHits;              // Searched positions found in the transposition table
+	EvaluationWeights m_Weights;                 // Weights used by Evaluate
+	std::shared_ptr<const NetworkEvaluator> m_Network;           // Replaces the weights when set
+	std::vector<NetworkEvaluator::Accumulator> m_Accumulators;   // First layer of every position on the search stack
+	int m_Ply;                                                   // Distance of the current position from the root
+	std::shared_ptr<TranspositionTable> m_ExactTable;            // Exact endgame results, scores in stones
+	int m_ExactThreshold;                                        // Stones on the board at or below which endgames are searched exactly
+
+	static constexpr int MAX_PLY = 128;
+	static EvaluationWeights s_DefaultWeights;   // Weights new engines start with
+	static std::shared_ptr<const NetworkEvaluator> s_DefaultNetwork; // Network new engines start with
+	static std::shared_ptr<TranspositionTable> s_SharedTable;        // Table opened by OpenSharedTable, null until then
+	static constexpr unsigned long long LIMIT_CHECK_INTERVAL = 1024; // Nodes between checks of the deadline and node limit
+
 	float minimax(const State& state, const char& depth, const float& alpha, const float& beta, const char& maximizing_player);
 	float Evaluate(const State& state);
+	void CheckLimits();
+	void OrderMoves(MoveList& moves, const char& firstMove) const;
+	void StoreTable(const State& state, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound);
+	void SetRoot(const State& state);
+	void PushPosition(const State& state, const State& nextState);
+	void PopPosition();
+	float ExactScore(const State& state, const float& alpha, const float& beta);
+	int ExactSearch(const State& state, const int& alpha, const int& beta);
+	static float ExactToScore(const int& difference);
 
 
 public:
-	Minimax();
+	static constexpr float WIN_SCORE = 9000.0F;       // Won positions score WIN_SCORE plus their store difference
+	static constexpr int DEFAULT_EXACT_THRESHOLD = 10;
+	static constexpr size_t EXACT_TABLE_SIZE = 4;       // Megabytes of the endgame table an engine creates for itself
+	static constexpr float ASPIRATION_WINDOW = 1.0F;    // Initial half width of the window around a root move's previous score
+
+	Minimax(const std::shared_ptr<TranspositionTable>& table);
+	Minimax(const std::shared_ptr<TranspositionTable>& table, const std::shared_ptr<TranspositionTable>& exactTable);
 	~Minimax();
 
 
 	char BestMove(const State& state, const char& depth, const bool& log = false);
+	SearchResult Search(const State& state, const char& depth, const bool& log = false);
+	MultiPVResult SearchMultiPV(const State& state, const char& depth, const int& lines = MultiPVResult::MAX_LINES);
+	int PrincipalVariation(const State& state, const int& length, char* variation) const;
+	bool StoredScore(const State& state, float& score) const;
+	bool ProbeTable(const State& state, TranspositionEntry& entry) const;
 	float EvaluationScore(const State& state);
+	float StaticEvaluation(const State& state);
+	unsigned long long Nodes() const;
+	unsigned long long TableHits() const;
+
+	static void Features(const State& state, float* features);
+	void SetWeights(const EvaluationWeights& weights);
+	const EvaluationWeights& GetWeights() const;
+	static bool LoadDefaultWeights(const std::string& filename);
+	static const EvaluationWeights& DefaultWeights();
+	void SetNetwork(const std::shared_ptr<const NetworkEvaluator>& network);
+	static bool LoadDefaultNetwork(const std::string& filename);
+	static const std::shared_ptr<const NetworkEvaluator>& DefaultNetwork();
+	static bool OpenSharedTable(const std::string& name, const size_t& sizeInMegabytes, const bool& hugePages = false);
+	static std::shared_ptr<TranspositionTable> SessionTable(const size_t& sizeInMegabytes = 32);
+	void SetExactThreshold(const int& stones);
+
+	void Stop();
+	void Resume();
+	bool IsStopped() const;
+	void SetLimits(const std::chrono::steady_clock::time_point& deadline, const unsigned long long& nodeLimit);
+	void ClearLimits();
+	std::shared_ptr<TranspositionTable> GetTranspositionTable() const;
 };
@@ -0,0 +1,352 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+std::mutex Metrics::s_Mutex;
+std::map<std::string, Metrics::Entry> Metrics::s_Entries;
+std::thread Metrics::s_Exporter;
+std::atomic<bool> Metrics::s_Stop = false;
+
+/**
+ * @brief Returns the bucket a value falls into.
+ *
+ * @param value The value in microseconds.
+ * @return The index of its bucket.
+ */
+int LatencyHistogram::BucketIndex(const unsigned long long& value)
+{
+    if (value < SUB_BUCKETS)
+    {
+        return (int)value;
+    }
+
+    const int exponent = (int)std::bit_width(value) - 1;
+    if (exponent > MAX_EXPONENT)
+    {
+        return BUCKETS - 1;
+    }
+    const int subBucket = (int)(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+/**
+ * @brief Returns the value in the middle of a bucket, reported for quantiles that fall into it.
+ *
+ * @param index The index of the bucket.
+ * @return The middle of its range in microseconds.
+ */
+unsigned long long LatencyHistogram::BucketMidpoint(const int& index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    const int shift = index / SUB_BUCKETS - 1;
+    const unsigned long long low = (unsigned long long)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+/**
+ * @brief Adds a value to the histogram. Safe to call from any thread.
+ *
+ * @param microseconds The value to add.
+ */
+void LatencyHistogram::Record(const unsigned long long& microseconds)
+{
+    m_Buckets[BucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_Sum.fetch_add(microseconds, std::memory_order_relaxed);
+    m_Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Estimates a quantile of the recorded values.
+ *
+ * @param quantile The quantile in [0, 1], 0.99 for the 99th percentile.
+ * @return The estimate in microseconds, 0 if nothing was recorded.
+ */
+double LatencyHistogram::Quantile(const double& quantile) const
+{
+    unsigned long long total = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        total += m_Buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    const unsigned long long rank = std::max<unsigned long long>(1, (unsigned long long)std::ceil(quantile * total));
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        seen += m_Buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return (double)BucketMidpoint(i);
+        }
+    }
+    return (double)BucketMidpoint(BUCKETS - 1);
+}
+
+/**
+ * @brief Finds or creates the registry entry of a metric.
+ */
+Metrics::Entry& Metrics::Register(const std::string& name, const std::string& help)
+{
+    Entry& entry = s_Entries[name];
+    if (entry.m_Help.empty())
+    {
+        entry.m_Help = help;
+    }
+    return entry;
+}
+
+/**
+ * @brief Returns the counter registered under a name, creating it on first use.
+ *
+ * @param name The Prometheus metric name, conventionally ending in _total.
+ * @param help The description exported with the metric.
+ * @return The counter, valid until the program exits.
+ */
+MetricCounter& Metrics::Counter(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+    Entry& entry = Register(name, help);
+    if (!entry.m_Counter)
+    {
+        entry.m_Counter = std::make_unique<MetricCounter>();
+    }
+    return *entry.m_Counter;
+}
+
+/**
+ * @brief Returns the gauge registered under a name, creating it on first use.
+ *
+ * @param name The Prometheus metric name.
+ * @param help The description exported with the metric.
+ * @return The gauge, valid until the program exits.
+ */
+MetricGauge& Metrics::Gauge(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+    Entry& entry = Register(name, help);
+    if (!entry.m_Gauge)
+    {
+        entry.m_Gauge = std::make_unique<MetricGauge>();
+    }
+    return *entry.m_Gauge;
+}
+
+/**
+ * @brief Returns the latency histogram registered under a name, creating it on first use.
+ *
+ * @param name The Prometheus metric name, conventionally ending in _seconds.
+ * @param help The description exported with the metric.
+ * @return The histogram, valid until the program exits.
+ */
+LatencyHistogram& Metrics::Histogram(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+    Entry& entry = Register(name, help);
+    if (!entry.m_Histogram)
+    {
+        entry.m_Histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *entry.m_Histogram;
+}
+
+/**
+ * @brief Formats every registered metric in the Prometheus text exposition format.
+ *
+ * Histograms are exported as summaries with their 50th, 95th and 99th percentiles, in seconds.
+ *
+ * @return The formatted metrics.
+ */
+std::string Metrics::Prometheus()
+{
+    std::lock_guard<std::mutex> lock(s_Mutex);
+    std::string text;
+    for (const auto& [name, entry] : s_Entries)
+    {
+        text += std::format("# HELP {} {}\n", name, entry.m_Help);
+        if (entry.m_Counter)
+        {
+            text += std::format("# TYPE {} counter\n{} {}\n", name, name, entry.m_Counter->Value());
+        }
+        else if (entry.m_Gauge)
+        {
+            text += std::format("# TYPE {} gauge\n{} {}\n", name, name, entry.m_Gauge->Value());
+        }
+        else if (entry.m_Histogram)
+        {
+            text += std::format("# TYPE {} summary\n", name);
+            for (double quantile : { 0.5, 0.95, 0.99 })
+            {
+                text += std::format("{}{{quantile=\"{}\"}} {}\n", name, quantile, entry.m_Histogram->Quantile(quantile) * 1e-6);
+            }
+            text += std::format("{}_sum {}\n{}_count {}\n", name, entry.m_Histogram->Sum() * 1e-6, name, entry.m_Histogram->Count());
+        }
+    }
+    return text;
+}
+
+/**
+ * @brief Replaces a file with the current metrics, so readers never see a partial dump.
+ *
+ * @param fileName The file to write.
+ * @return True if the file was written, false otherwise.
+ */
+bool Metrics::WriteFile(const std::string& fileName)
+{
+    const std::string temporary = fileName + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << Prometheus();
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, fileName, error);
+    return !error;
+}
+
+/**
+ * @brief Rewrites the metrics file every interval until the exporter is stopped.
+ */
+void Metrics::ExportFile(const std::string& fileName, const int& interval)
+{
+    auto next = std::chrono::steady_clock::now();
+    while (!s_Stop.load())
+    {
+        if (std::chrono::steady_clock::now() >= next)
+        {
+            if (!WriteFile(fileName))
+            {
+                std::cerr << std::format("Cannot write metrics to {}\n", fileName);
+            }
+            next += std::chrono::milliseconds(interval);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval, 100)));
+    }
+    WriteFile(fileName); // The final values
+}
+
+/**
+ * @brief Serves the current metrics to every client that connects to a Unix socket.
+ */
+void Metrics::ExportSocket(const std::string& path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << std::format("Metrics socket path is too long: {}\n", path);
+        return;
+    }
+    path.copy(address.sun_path, path.size());
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, 8) != 0)
+    {
+        std::cerr << std::format("Cannot listen for metrics on {}\n", path);
+        if (server >= 0)
+        {
+            close(server);
+        }
+        return;
+    }
+
+    while (!s_Stop.load())
+    {
+        pollfd request = { server, POLLIN, 0 };
+        if (poll(&request, 1, 100) <= 0)
+        {
+            continue;
+        }
+
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+        {
+            continue;
+        }
+        const std::string text = Prometheus();
+        for (size_t sent = 0; sent < text.size();)
+        {
+            const ssize_t written = send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0)
+            {
+                break;
+            }
+            sent += written;
+        }
+        close(client);
+    }
+
+    close(server);
+    unlink(path.c_str());
+#else
+    std::cerr << std::format("Metrics sockets are not supported on this platform: {}\n", path);
+#endif
+}
+
+/**
+ * @brief Starts exporting metrics on a background thread until the program exits.
+ *
+ * @param target A file path, or "unix:<path>" to serve the metrics on a Unix socket.
+ * @param interval Milliseconds between two writes of the file.
+ */
+void Metrics::Start(const std::string& target, const int& interval)
+{
+    Stop();
+    s_Stop.store(false);
+
+    if (target.starts_with("unix:"))
+    {
+        s_Exporter = std::thread(&Metrics::ExportSocket, target.substr(5));
+    }
+    else
+    {
+        s_Exporter = std::thread(&Metrics::ExportFile, target, std::max(1, interval));
+    }
+
+    static bool registered = false;
+    if (!registered)
+    {
+        std::atexit(&Metrics::Stop);
+        registered = true;
+    }
+}
+
+/**
+ * @brief Stops the exporter thread started by Start and waits for it to finish.
+ */
+void Metrics::Stop()
+{
+    s_Stop.store(true);
+    if (s_Exporter.joinable())
+    {
+        s_Exporter.join();
+    }
+}
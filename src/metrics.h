@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief A monotonically increasing count, such as moves played or positions searched.
+ */
+class MetricCounter
+{
+private:
+	std::atomic<unsigned long long> m_Value = 0;
+
+public:
+	void Add(const unsigned long long& amount = 1) { m_Value.fetch_add(amount, std::memory_order_relaxed); }
+	unsigned long long Value() const { return m_Value.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief A value that can go up and down, such as the depth reached by the last search.
+ */
+class MetricGauge
+{
+private:
+	std::atomic<double> m_Value = 0.0;
+
+public:
+	void Set(const double& value) { m_Value.store(value, std::memory_order_relaxed); }
+	double Value() const { return m_Value.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief A latency histogram with HDR-style log-linear buckets.
+ *
+ * Values are recorded in microseconds. Values below SUB_BUCKETS get a bucket each, larger values share
+ * SUB_BUCKETS buckets per power of two, so every quantile is exact to within 1/SUB_BUCKETS of its value
+ * from a microsecond up to MAX_EXPONENT. Recording is one relaxed increment per bucket, sum and count.
+ */
+class LatencyHistogram
+{
+public:
+	static constexpr int SUB_BUCKET_BITS = 4;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_EXPONENT = 40; // Values of 2^40 us (about 12 days) and more share the last buckets
+	static constexpr int BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+private:
+	std::atomic<unsigned long long> m_Buckets[BUCKETS] = {};
+	std::atomic<unsigned long long> m_Count = 0;
+	std::atomic<unsigned long long> m_Sum = 0;
+
+	static int BucketIndex(const unsigned long long& value);
+	static unsigned long long BucketMidpoint(const int& index);
+
+public:
+	void Record(const unsigned long long& microseconds);
+	unsigned long long Count() const { return m_Count.load(std::memory_order_relaxed); }
+	unsigned long long Sum() const { return m_Sum.load(std::memory_order_relaxed); }
+	double Quantile(const double& quantile) const;
+};
+
+/**
+ * @brief The process-wide registry of named metrics and its Prometheus exporter.
+ *
+ * Metrics are registered once by name (registration locks, callers keep the returned reference) and
+ * updated without locks afterwards. The exporter thread periodically writes every metric in the
+ * Prometheus text exposition format, either to a file (replaced atomically, for node_exporter's
+ * textfile collector) or, with a "unix:" prefix, to every client connecting to a Unix socket.
+ */
+class Metrics
+{
+private:
+	/**
+	 * @brief One registered metric, exactly one of the pointers is set.
+	 */
+	struct Entry
+	{
+		std::string m_Help;
+		std::unique_ptr<MetricCounter> m_Counter;
+		std::unique_ptr<MetricGauge> m_Gauge;
+		std::unique_ptr<LatencyHistogram> m_Histogram;
+	};
+
+	static std::mutex s_Mutex;
+	static std::map<std::string, Entry> s_Entries;
+
+	static std::thread s_Exporter;
+	static std::atomic<bool> s_Stop;
+
+	static Entry& Register(const std::string& name, const std::string& help);
+	static bool WriteFile(const std::string& fileName);
+	static void ExportFile(const std::string& fileName, const int& interval);
+	static void ExportSocket(const std::string& path);
+
+public:
+	static MetricCounter& Counter(const std::string& name, const std::string& help);
+	static MetricGauge& Gauge(const std::string& name, const std::string& help);
+	static LatencyHistogram& Histogram(const std::string& name, const std::string& help);
+
+	static std::string Prometheus();
+
+	static void Start(const std::string& target, const int& interval = 10000);
+	static void Stop();
+};
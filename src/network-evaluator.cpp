@@ -0,0 +1,307 @@
+#include "network-evaluator.h"
+#include "state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const char NETWORK_MAGIC[4] = { 'M', 'N', 'N', '1' };
+
+/**
+ * @brief Constructs a network with all weights set to zero.
+ */
+NetworkEvaluator::NetworkEvaluator()
+{
+    std::memset(m_Weights1, 0, sizeof(m_Weights1));
+    std::memset(m_Bias1, 0, sizeof(m_Bias1));
+    std::memset(m_Weights2, 0, sizeof(m_Weights2));
+    std::memset(m_Bias2, 0, sizeof(m_Bias2));
+    std::memset(m_Weights3, 0, sizeof(m_Weights3));
+    m_Bias3 = 0;
+}
+
+/**
+ * @brief Reads quantized weights from a network file.
+ *
+ * @param filename Path of a file written by Save.
+ * @return True if the file was read, false if it is missing or was written for other layer sizes.
+ */
+bool NetworkEvaluator::Load(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[4];
+    int sizes[3];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, NETWORK_MAGIC, sizeof(magic)) != 0 ||
+        !file.read((char*)sizes, sizeof(sizes)) || sizes[0] != INPUTS || sizes[1] != HIDDEN1 || sizes[2] != HIDDEN2)
+    {
+        return false;
+    }
+
+    file.read((char*)m_Weights1, sizeof(m_Weights1));
+    file.read((char*)m_Bias1, sizeof(m_Bias1));
+    file.read((char*)m_Weights2, sizeof(m_Weights2));
+    file.read((char*)m_Bias2, sizeof(m_Bias2));
+    file.read((char*)m_Weights3, sizeof(m_Weights3));
+    file.read((char*)&m_Bias3, sizeof(m_Bias3));
+    return (bool)file;
+}
+
+/**
+ * @brief Writes the quantized weights to a network file.
+ *
+ * @param filename Path of the network file.
+ * @return True if the file was written, false otherwise.
+ */
+bool NetworkEvaluator::Save(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    const int sizes[3] = { INPUTS, HIDDEN1, HIDDEN2 };
+    file.write(NETWORK_MAGIC, sizeof(NETWORK_MAGIC));
+    file.write((const char*)sizes, sizeof(sizes));
+    file.write((const char*)m_Weights1, sizeof(m_Weights1));
+    file.write((const char*)m_Bias1, sizeof(m_Bias1));
+    file.write((const char*)m_Weights2, sizeof(m_Weights2));
+    file.write((const char*)m_Bias2, sizeof(m_Bias2));
+    file.write((const char*)m_Weights3, sizeof(m_Weights3));
+    file.write((const char*)&m_Bias3, sizeof(m_Bias3));
+    return (bool)file;
+}
+
+/**
+ * @brief Returns the input feature of a pit holding the given number of stones.
+ *
+ * @param pit The index of the pit or store.
+ * @param stones The number of stones in it, counts above MAX_STONES share the last feature.
+ * @return The index of the input feature.
+ */
+int NetworkEvaluator::FeatureIndex(const int& pit, const int& stones)
+{
+    return pit * (MAX_STONES + 1) + std::min(stones, MAX_STONES);
+}
+
+/**
+ * @brief Adds the first layer column of a feature to an accumulator.
+ */
+void NetworkEvaluator::AddFeature(Accumulator& accumulator, const int& feature) const
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < HIDDEN1; i += 16)
+    {
+        __m256i values = _mm256_load_si256((const __m256i*)&accumulator.m_Values[i]);
+        values = _mm256_add_epi16(values, _mm256_load_si256((const __m256i*)&m_Weights1[feature][i]));
+        _mm256_store_si256((__m256i*)&accumulator.m_Values[i], values);
+    }
+#else
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        accumulator.m_Values[i] += m_Weights1[feature][i];
+    }
+#endif
+}
+
+/**
+ * @brief Subtracts the first layer column of a feature from an accumulator.
+ */
+void NetworkEvaluator::RemoveFeature(Accumulator& accumulator, const int& feature) const
+{
+#if defined(__AVX2__)
+    for (int i = 0; i < HIDDEN1; i += 16)
+    {
+        __m256i values = _mm256_load_si256((const __m256i*)&accumulator.m_Values[i]);
+        values = _mm256_sub_epi16(values, _mm256_load_si256((const __m256i*)&m_Weights1[feature][i]));
+        _mm256_store_si256((__m256i*)&accumulator.m_Values[i], values);
+    }
+#else
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        accumulator.m_Values[i] -= m_Weights1[feature][i];
+    }
+#endif
+}
+
+/**
+ * @brief Computes the first layer of a position from scratch.
+ *
+ * @param state The position.
+ * @param accumulator Receives the first layer output.
+ */
+void NetworkEvaluator::Refresh(const State& state, Accumulator& accumulator) const
+{
+    std::memcpy(accumulator.m_Values, m_Bias1, sizeof(m_Bias1));
+    for (int pit = 0; pit < 14; ++pit)
+    {
+        AddFeature(accumulator, FeatureIndex(pit, state.m_Board[pit]));
+    }
+    if (state.m_Turn == 1)
+    {
+        AddFeature(accumulator, TURN_FEATURE);
+    }
+}
+
+/**
+ * @brief Computes the first layer of a position from the first layer of its parent.
+ *
+ * Only the pits whose stone count changed between the two positions are touched.
+ *
+ * @param parent The first layer of the position before the move.
+ * @param from The position before the move.
+ * @param to The position after the move.
+ * @param child Receives the first layer of the position after the move.
+ */
+void NetworkEvaluator::Update(const Accumulator& parent, const State& from, const State& to, Accumulator& child) const
+{
+    child = parent;
+    for (int pit = 0; pit < 14; ++pit)
+    {
+        if (from.m_Board[pit] != to.m_Board[pit])
+        {
+            RemoveFeature(child, FeatureIndex(pit, from.m_Board[pit]));
+            AddFeature(child, FeatureIndex(pit, to.m_Board[pit]));
+        }
+    }
+    if (from.m_Turn != to.m_Turn)
+    {
+        if (to.m_Turn == 1)
+        {
+            AddFeature(child, TURN_FEATURE);
+        }
+        else
+        {
+            RemoveFeature(child, TURN_FEATURE);
+        }
+    }
+}
+
+/**
+ * @brief Runs the hidden and output layers on a first layer output.
+ *
+ * @param accumulator The first layer of the position.
+ * @return The score of the position from player 1's point of view, in stones.
+ */
+float NetworkEvaluator::Evaluate(const Accumulator& accumulator) const
+{
+    alignas(32) int hidden[HIDDEN2];
+
+#if defined(__AVX2__)
+    // Clipped ReLU of the first layer, packed to 32 unsigned bytes
+    __m256i activations;
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ceiling = _mm256_set1_epi16(ACTIVATION_SCALE);
+        __m256i low = _mm256_load_si256((const __m256i*)&accumulator.m_Values[0]);
+        __m256i high = _mm256_load_si256((const __m256i*)&accumulator.m_Values[16]);
+        low = _mm256_max_epi16(_mm256_min_epi16(low, ceiling), zero);
+        high = _mm256_max_epi16(_mm256_min_epi16(high, ceiling), zero);
+        activations = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+    }
+
+    // Second layer, eight output neurons at a time
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int j = 0; j < HIDDEN2; j += 8)
+    {
+        __m256i sums[8];
+        for (int k = 0; k < 8; ++k)
+        {
+            const __m256i weights = _mm256_load_si256((const __m256i*)m_Weights2[j + k]);
+            sums[k] = _mm256_madd_epi16(_mm256_maddubs_epi16(activations, weights), ones);
+        }
+        const __m256i sum01 = _mm256_hadd_epi32(sums[0], sums[1]);
+        const __m256i sum23 = _mm256_hadd_epi32(sums[2], sums[3]);
+        const __m256i sum45 = _mm256_hadd_epi32(sums[4], sums[5]);
+        const __m256i sum67 = _mm256_hadd_epi32(sums[6], sums[7]);
+        const __m256i sum0123 = _mm256_hadd_epi32(sum01, sum23);
+        const __m256i sum4567 = _mm256_hadd_epi32(sum45, sum67);
+        __m256i total = _mm256_add_epi32(_mm256_permute2x128_si256(sum0123, sum4567, 0x20), _mm256_permute2x128_si256(sum0123, sum4567, 0x31));
+        total = _mm256_add_epi32(total, _mm256_load_si256((const __m256i*)&m_Bias2[j]));
+        total = _mm256_srai_epi32(total, 6); // Divide by WEIGHT_SCALE
+        total = _mm256_max_epi32(_mm256_min_epi32(total, _mm256_set1_epi32(ACTIVATION_SCALE)), _mm256_setzero_si256());
+        _mm256_store_si256((__m256i*)&hidden[j], total);
+    }
+
+    // Output layer
+    __m256i output = _mm256_setzero_si256();
+    for (int j = 0; j < HIDDEN2; j += 8)
+    {
+        output = _mm256_add_epi32(output, _mm256_mullo_epi32(_mm256_load_si256((const __m256i*)&hidden[j]), _mm256_load_si256((const __m256i*)&m_Weights3[j])));
+    }
+    __m128i folded = _mm_add_epi32(_mm256_castsi256_si128(output), _mm256_extracti128_si256(output, 1));
+    folded = _mm_hadd_epi32(folded, folded);
+    folded = _mm_hadd_epi32(folded, folded);
+    const int sum = _mm_cvtsi128_si32(folded) + m_Bias3;
+#else
+    unsigned char activations[HIDDEN1];
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        activations[i] = (unsigned char)std::clamp<int>(accumulator.m_Values[i], 0, ACTIVATION_SCALE);
+    }
+
+    for (int j = 0; j < HIDDEN2; ++j)
+    {
+        int total = m_Bias2[j];
+        for (int i = 0; i < HIDDEN1; ++i)
+        {
+            total += activations[i] * m_Weights2[j][i];
+        }
+        hidden[j] = std::clamp(total >> 6, 0, ACTIVATION_SCALE); // Divide by WEIGHT_SCALE
+    }
+
+    int sum = m_Bias3;
+    for (int j = 0; j < HIDDEN2; ++j)
+    {
+        sum += hidden[j] * m_Weights3[j];
+    }
+#endif
+
+    return (float)sum / (ACTIVATION_SCALE * WEIGHT_SCALE);
+}
+
+/**
+ * @brief Replaces the weights with quantized copies of floating point weights.
+ *
+ * Layouts match the quantized arrays: weights1 is INPUTS x HIDDEN1, weights2 is HIDDEN2 x HIDDEN1 and
+ * weights3 has HIDDEN2 values.
+ */
+void NetworkEvaluator::Quantize(const float* weights1, const float* bias1, const float* weights2, const float* bias2, const float* weights3, const float& bias3)
+{
+    auto quantize = [](const float& value, const float& scale, const int& limit)
+    {
+        return (int)std::clamp<long>(std::lround(value * scale), -limit, limit);
+    };
+
+    for (int f = 0; f < INPUTS; ++f)
+    {
+        for (int i = 0; i < HIDDEN1; ++i)
+        {
+            m_Weights1[f][i] = (short)quantize(weights1[f * HIDDEN1 + i], ACTIVATION_SCALE, 2047);
+        }
+    }
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        m_Bias1[i] = (short)quantize(bias1[i], ACTIVATION_SCALE, 2047);
+    }
+    for (int j = 0; j < HIDDEN2; ++j)
+    {
+        for (int i = 0; i < HIDDEN1; ++i)
+        {
+            m_Weights2[j][i] = (signed char)quantize(weights2[j * HIDDEN1 + i], WEIGHT_SCALE, 127);
+        }
+        m_Bias2[j] = quantize(bias2[j], ACTIVATION_SCALE * WEIGHT_SCALE, 1 << 24);
+        m_Weights3[j] = quantize(weights3[j], WEIGHT_SCALE, 1 << 20);
+    }
+    m_Bias3 = quantize(bias3, ACTIVATION_SCALE * WEIGHT_SCALE, 1 << 28);
+}
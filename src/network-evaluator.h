@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+
+class State;
+
+/**
+ * @brief A small quantized fully-connected network that evaluates positions.
+ *
+ * The input is one feature per (pit, stone count) pair plus one for the player to move. The first
+ * layer is stored as an int16 accumulator that is updated incrementally from the parent position
+ * when a move changes pit counts, the hidden layers use int8 weights and clipped ReLU activations.
+ * Inference uses AVX2 when the engine is built with it and falls back to bit-identical scalar code
+ * otherwise.
+ */
+class NetworkEvaluator
+{
+public:
+	static constexpr int MAX_STONES = 48;                      // Highest stone count with its own feature
+	static constexpr int INPUTS = 14 * (MAX_STONES + 1) + 1;   // Pit/count pairs and the player to move
+	static constexpr int TURN_FEATURE = INPUTS - 1;
+	static constexpr int HIDDEN1 = 32;
+	static constexpr int HIDDEN2 = 32;
+	static constexpr int ACTIVATION_SCALE = 127; // Quantized value of an activation of 1.0
+	static constexpr int WEIGHT_SCALE = 64;      // Quantized value of a hidden weight of 1.0
+
+	/**
+	 * @brief First layer output of one position.
+	 */
+	struct Accumulator
+	{
+		alignas(32) short m_Values[HIDDEN1];
+	};
+
+	NetworkEvaluator();
+
+	bool Load(const std::string& filename);
+	bool Save(const std::string& filename) const;
+
+	void Refresh(const State& state, Accumulator& accumulator) const;
+	void Update(const Accumulator& parent, const State& from, const State& to, Accumulator& child) const;
+	float Evaluate(const Accumulator& accumulator) const;
+
+	void Quantize(const float* weights1, const float* bias1, const float* weights2, const float* bias2, const float* weights3, const float& bias3);
+
+	static int FeatureIndex(const int& pit, const int& stones);
+
+private:
+	alignas(32) short m_Weights1[INPUTS][HIDDEN1];  // Column of the first layer for every input feature
+	alignas(32) short m_Bias1[HIDDEN1];
+	alignas(32) signed char m_Weights2[HIDDEN2][HIDDEN1];
+	alignas(32) int m_Bias2[HIDDEN2];
+	alignas(32) int m_Weights3[HIDDEN2];
+	int m_Bias3;
+
+	void AddFeature(Accumulator& accumulator, const int& feature) const;
+	void RemoveFeature(Accumulator& accumulator, const int& feature) const;
+};
@@ -0,0 +1,353 @@
+#include "network-trainer.h"
+#include "task-scheduler.h"
+#include "timer.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <random>
+
+/**
+ * @brief Constructs a trainer with a randomly initialized network.
+ *
+ * @param threads Number of threads used to play self-play games.
+ */
+NetworkTrainer::NetworkTrainer(const int& threads) : m_Threads(std::max(1, threads)), m_Bias3(0.0F)
+{
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> small(-0.1F, 0.1F);
+
+    m_Weights1.resize(NetworkEvaluator::INPUTS * NetworkEvaluator::HIDDEN1);
+    m_Bias1.assign(NetworkEvaluator::HIDDEN1, 0.5F);
+    m_Weights2.resize(NetworkEvaluator::HIDDEN2 * NetworkEvaluator::HIDDEN1);
+    m_Bias2.assign(NetworkEvaluator::HIDDEN2, 0.5F);
+    m_Weights3.resize(NetworkEvaluator::HIDDEN2);
+
+    for (float& weight : m_Weights1) weight = small(generator);
+    for (float& weight : m_Weights2) weight = small(generator);
+    for (float& weight : m_Weights3) weight = small(generator);
+}
+
+/**
+ * @brief Plays games between handcrafted engines and stores their labelled positions.
+ *
+ * Each game starts with two to six random moves, alternates between the two rulesets and is played
+ * with a fixed search depth.
+ *
+ * @param games Number of games to play.
+ * @param depth Search depth of the engines.
+ * @return The number of positions collected.
+ */
+size_t NetworkTrainer::GenerateSelfPlay(const int& games, const char& depth)
+{
+    std::mutex samplesMutex;
+    float duration = 0.0;
+    {
+        Timer timer(&duration);
+
+        // Games differ in length, every game is a task of a work-stealing scheduler
+        TaskScheduler scheduler({ m_Threads, false });
+        std::vector<std::unique_ptr<Minimax>> engines;
+        std::vector<std::mt19937> generators;
+        for (int t = 0; t < scheduler.Threads(); ++t)
+        {
+            engines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+            engines.back()->SetNetwork(nullptr);
+            generators.emplace_back(1000 + t);
+        }
+
+        for (int game = 0; game < games; ++game)
+        {
+            scheduler.Submit([&, game]()
+                {
+                    const int worker = TaskScheduler::WorkerIndex();
+                    Minimax& engine = *engines[worker];
+                    std::mt19937& generator = generators[worker];
+
+                    State state;
+                    state.ChangeRuleset(game % 2);
+                    for (int i = 0, randomMoves = 2 + generator() % 5; i < randomMoves && state.GameState() != GAMEOVER; ++i)
+                    {
+                        MoveList legalMoves = state.LegalMoves();
+                        state.MakeMove(legalMoves[generator() % legalMoves.size()]);
+                    }
+
+                    std::vector<std::pair<State, float>> positions;
+                    while (state.GameState() != GAMEOVER)
+                    {
+                        const SearchResult result = engine.Search(state, depth);
+                        positions.emplace_back(state, result.m_Score);
+                        state.MakeMove(result.m_BestMove);
+                    }
+
+                    const float outcome = state.m_Board[6] > state.m_Board[13] ? 1.0F : (state.m_Board[6] < state.m_Board[13] ? 0.0F : 0.5F);
+                    std::lock_guard<std::mutex> lock(samplesMutex);
+                    for (const auto& [position, score] : positions)
+                    {
+                        const float searchTarget = 1.0F / (1.0F + std::exp(-SCALE * std::clamp(score, -100.0F, 100.0F)));
+                        m_Samples.push_back({ position, 0.5F * outcome + 0.5F * searchTarget });
+                    }
+                });
+        }
+        scheduler.Wait();
+    }
+
+    std::cout << std::format("self-play: {} games, {} positions in {} ms\n", games, m_Samples.size(), duration);
+    return m_Samples.size();
+}
+
+/**
+ * @brief Runs one step of stochastic gradient descent on a sample.
+ *
+ * @param sample The labelled position.
+ * @param learningRate Step size.
+ * @return The squared error of the sample before the step.
+ */
+float NetworkTrainer::TrainSample(const Sample& sample, const float& learningRate)
+{
+    constexpr int HIDDEN1 = NetworkEvaluator::HIDDEN1;
+    constexpr int HIDDEN2 = NetworkEvaluator::HIDDEN2;
+
+    // Active input features
+    int features[15];
+    int featureCount = 0;
+    for (int pit = 0; pit < 14; ++pit)
+    {
+        features[featureCount++] = NetworkEvaluator::FeatureIndex(pit, sample.m_State.m_Board[pit]);
+    }
+    if (sample.m_State.m_Turn == 1)
+    {
+        features[featureCount++] = NetworkEvaluator::TURN_FEATURE;
+    }
+
+    // Forward pass, the clipped ReLUs mirror the quantized network
+    float hidden1[HIDDEN1], activations1[HIDDEN1];
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        hidden1[i] = m_Bias1[i];
+        for (int k = 0; k < featureCount; ++k)
+        {
+            hidden1[i] += m_Weights1[features[k] * HIDDEN1 + i];
+        }
+        activations1[i] = std::clamp(hidden1[i], 0.0F, 1.0F);
+    }
+
+    float hidden2[HIDDEN2], activations2[HIDDEN2];
+    float output = m_Bias3;
+    for (int j = 0; j < HIDDEN2; ++j)
+    {
+        hidden2[j] = m_Bias2[j];
+        for (int i = 0; i < HIDDEN1; ++i)
+        {
+            hidden2[j] += m_Weights2[j * HIDDEN1 + i] * activations1[i];
+        }
+        activations2[j] = std::clamp(hidden2[j], 0.0F, 1.0F);
+        output += m_Weights3[j] * activations2[j];
+    }
+
+    const float prediction = 1.0F / (1.0F + std::exp(-SCALE * output));
+    const float error = prediction - sample.m_Target;
+    const float outputGradient = 2.0F * error * prediction * (1.0F - prediction) * SCALE;
+
+    // Backward pass
+    float gradient1[HIDDEN1] = {};
+    for (int j = 0; j < HIDDEN2; ++j)
+    {
+        const float gradient2 = (hidden2[j] > 0.0F && hidden2[j] < 1.0F) ? outputGradient * m_Weights3[j] : 0.0F;
+        m_Weights3[j] -= learningRate * outputGradient * activations2[j];
+        if (gradient2 != 0.0F)
+        {
+            for (int i = 0; i < HIDDEN1; ++i)
+            {
+                gradient1[i] += gradient2 * m_Weights2[j * HIDDEN1 + i];
+                m_Weights2[j * HIDDEN1 + i] = std::clamp(m_Weights2[j * HIDDEN1 + i] - learningRate * gradient2 * activations1[i], -1.98F, 1.98F);
+            }
+            m_Bias2[j] -= learningRate * gradient2;
+        }
+    }
+    m_Bias3 -= learningRate * outputGradient;
+
+    for (int i = 0; i < HIDDEN1; ++i)
+    {
+        if (hidden1[i] <= 0.0F || hidden1[i] >= 1.0F)
+        {
+            continue;
+        }
+        for (int k = 0; k < featureCount; ++k)
+        {
+            float& weight = m_Weights1[features[k] * HIDDEN1 + i];
+            weight = std::clamp(weight - learningRate * gradient1[i], -1.0F, 1.0F);
+        }
+        m_Bias1[i] -= learningRate * gradient1[i];
+    }
+
+    return error * error;
+}
+
+/**
+ * @brief Fits the floating point network to the collected positions.
+ *
+ * @param epochs Number of shuffled passes over the positions.
+ * @param learningRate Initial step size, decayed linearly to a tenth of it.
+ * @return The mean squared error of the last epoch.
+ */
+float NetworkTrainer::Train(const int& epochs, const float& learningRate)
+{
+    std::mt19937 generator(42);
+    std::vector<size_t> order(m_Samples.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    float error = 0.0F;
+    for (int epoch = 0; epoch < epochs; ++epoch)
+    {
+        TraceZone zone("training epoch");
+        std::shuffle(order.begin(), order.end(), generator);
+        const float rate = learningRate * (1.0F - 0.9F * epoch / std::max(1, epochs));
+
+        double total = 0.0;
+        for (size_t index : order)
+        {
+            total += TrainSample(m_Samples[index], rate);
+        }
+        error = m_Samples.empty() ? 0.0F : (float)(total / m_Samples.size());
+
+        if ((epoch + 1) % 10 == 0 || epoch + 1 == epochs)
+        {
+            std::cout << std::format("epoch: {} error: {}\n", epoch + 1, error);
+        }
+    }
+    return error;
+}
+
+/**
+ * @brief Returns the quantized version of the trained network.
+ *
+ * @return A network evaluator with the current weights.
+ */
+std::shared_ptr<NetworkEvaluator> NetworkTrainer::Quantize() const
+{
+    std::shared_ptr<NetworkEvaluator> network = std::make_shared<NetworkEvaluator>();
+    network->Quantize(m_Weights1.data(), m_Bias1.data(), m_Weights2.data(), m_Bias2.data(), m_Weights3.data(), m_Bias3);
+    return network;
+}
+
+/**
+ * @brief Plays fixed-depth games between the network and the handcrafted evaluation.
+ *
+ * Every game starts from a different two-move opening and is played twice with colors reversed.
+ *
+ * @param network The network being measured.
+ * @param games Number of openings, each one is played twice.
+ * @param depth Search depth of both engines.
+ * @param threads Number of games played at the same time.
+ * @return The score of the network in [0, 1], 0.5 means equal strength.
+ */
+float NetworkTrainer::Match(const std::shared_ptr<const NetworkEvaluator>& network, const int& games, const char& depth, const int& threads)
+{
+    std::vector<State> openings;
+    {
+        State start;
+        for (char first : start.LegalMoves())
+        {
+            State afterFirst = start.NextState(first);
+            for (char second : afterFirst.LegalMoves())
+            {
+                openings.push_back(afterFirst.NextState(second));
+            }
+        }
+    }
+
+    std::atomic<int> points(0); // Half points of the network
+    const int count = std::min<int>(games, (int)openings.size());
+
+    TaskScheduler scheduler({ std::max(1, threads), false });
+    std::vector<std::unique_ptr<Minimax>> networkEngines;
+    std::vector<std::unique_ptr<Minimax>> handcraftedEngines;
+    for (int t = 0; t < scheduler.Threads(); ++t)
+    {
+        networkEngines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+        handcraftedEngines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+        networkEngines.back()->SetNetwork(network);
+        handcraftedEngines.back()->SetNetwork(nullptr);
+    }
+
+    for (int game = 0; game < 2 * count; ++game)
+    {
+        scheduler.Submit([&, game]()
+            {
+                Minimax& networkEngine = *networkEngines[TaskScheduler::WorkerIndex()];
+                Minimax& handcraftedEngine = *handcraftedEngines[TaskScheduler::WorkerIndex()];
+
+                State state = openings[game / 2];
+                const char networkPlayer = game % 2;
+                while (state.GameState() != GAMEOVER)
+                {
+                    Minimax& engine = state.m_Turn == networkPlayer ? networkEngine : handcraftedEngine;
+                    state.MakeMove(engine.BestMove(state, depth));
+                }
+
+                const char networkStore = networkPlayer == 0 ? 6 : 13;
+                const char handcraftedStore = networkPlayer == 0 ? 13 : 6;
+                points += state.m_Board[networkStore] > state.m_Board[handcraftedStore] ? 2 : (state.m_Board[networkStore] == state.m_Board[handcraftedStore] ? 1 : 0);
+            });
+    }
+    scheduler.Wait();
+
+    return count == 0 ? 0.5F : points / (4.0F * count);
+}
+
+/**
+ * @brief Trains a network on self-play games, writes it to settings/network.dat and measures it.
+ *
+ * Reports the search speed with and without the network and the result of a match against the
+ * handcrafted evaluation.
+ *
+ * @param games Number of self-play games.
+ * @param depth Search depth of the self-play engines.
+ * @param epochs Number of training epochs.
+ * @param threads Number of threads used for self-play and the match.
+ */
+void NetworkTrainer::Start(const int& games, const char& depth, const int& epochs, const int& threads)
+{
+    Minimax::LoadDefaultWeights("./settings/eval_weights.dat");
+
+    NetworkTrainer trainer(threads);
+    if (trainer.GenerateSelfPlay(games, depth) == 0)
+    {
+        return;
+    }
+    trainer.Train(epochs);
+
+    std::shared_ptr<NetworkEvaluator> network = trainer.Quantize();
+    std::filesystem::create_directory("settings");
+    if (network->Save("./settings/network.dat"))
+    {
+        std::cout << "network saved to settings/network.dat\n";
+    }
+
+    // Search speed with both evaluators on the same positions
+    double nodesPerSecond[2];
+    for (int useNetwork = 0; useNetwork < 2; ++useNetwork)
+    {
+        Minimax engine(std::make_shared<TranspositionTable>(1));
+        engine.SetNetwork(useNetwork ? network : nullptr);
+        float duration = 0.0;
+        {
+            Timer timer(&duration);
+            for (size_t i = 0; i < trainer.m_Samples.size(); i += std::max<size_t>(1, trainer.m_Samples.size() / 50))
+            {
+                engine.Search(trainer.m_Samples[i].m_State, 5);
+            }
+        }
+        nodesPerSecond[useNetwork] = engine.Nodes() / std::max(duration * 0.001, 0.001);
+    }
+    std::cout << std::format("nodes/s handcrafted: {} network: {} ({}x)\n", (long long)nodesPerSecond[0], (long long)nodesPerSecond[1],
+        nodesPerSecond[1] / std::max(nodesPerSecond[0], 1.0));
+
+    const float score = Match(network, 18, depth, threads);
+    std::cout << std::format("match score against handcrafted evaluation: {}%\n", score * 100.0F);
+}
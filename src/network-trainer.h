@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "mancala-engine.h"
+#include "network-evaluator.h"
+
+/**
+ * @brief Trains the network evaluator on self-play games, on the CPU.
+ *
+ * Games are played by the handcrafted engine from randomized openings. Every position is labelled with
+ * a blend of the game result and the search score, and the floating point network is fitted with
+ * stochastic gradient descent before being quantized into a NetworkEvaluator.
+ */
+class NetworkTrainer
+{
+private:
+	/**
+	 * @brief One labelled training position.
+	 */
+	struct Sample
+	{
+		State m_State;
+		float m_Target; // Expected result for player 1 in [0, 1]
+	};
+
+	int m_Threads;
+	std::vector<Sample> m_Samples;
+
+	std::vector<float> m_Weights1; // INPUTS x HIDDEN1
+	std::vector<float> m_Bias1;
+	std::vector<float> m_Weights2; // HIDDEN2 x HIDDEN1
+	std::vector<float> m_Bias2;
+	std::vector<float> m_Weights3;
+	float m_Bias3;
+
+	float TrainSample(const Sample& sample, const float& learningRate);
+
+public:
+	static constexpr float SCALE = 0.25F; // K in sigmoid(K * score), scores are in stones
+
+	NetworkTrainer(const int& threads);
+
+	size_t GenerateSelfPlay(const int& games, const char& depth);
+	float Train(const int& epochs, const float& learningRate = 0.01F);
+	std::shared_ptr<NetworkEvaluator> Quantize() const;
+
+	static float Match(const std::shared_ptr<const NetworkEvaluator>& network, const int& games, const char& depth, const int& threads);
+	static void Start(const int& games, const char& depth, const int& epochs, const int& threads);
+};
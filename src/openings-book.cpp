@@ -1,75 +1,554 @@
 #include "openings-book.h"
 #include "mancala-engine.h"
+#include "metrics.h"
+#include "persistence-queue.h"
+#include "search-handle.h"
+#include "state-analyzer.h"
 #include "timer.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <unordered_set>
 
-OpeningsBookGenerator::OpeningsBookGenerator()
+/**
+ * @brief Reads the settings of a book build.
+ *
+ * @param filename The config file, described at BookConfig.
+ * @return True if the file was read and names at least one root, false otherwise.
+ */
+bool BookConfig::Load(const std::string& filename)
 {
-}
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cout << "Cannot open " << filename << "\n";
+        return false;
+    }
 
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        std::istringstream stream(line.substr(0, line.find('#')));
+        std::string name;
+        if (!(stream >> name))
+        {
+            continue; // Blank or comment line
+        }
 
+        bool valid = true;
+        if (name == "root")
+        {
+            std::string boardString, turn, ruleset, error;
+            stream >> boardString >> turn >> ruleset;
 
-void OpeningsBookGenerator::Generate()
+            State root;
+            valid = StateAnalyzer::ParsePosition(boardString, turn, ruleset, root, error);
+            if (valid)
+            {
+                m_Roots.push_back(root);
+            }
+            else
+            {
+                std::cout << filename << ":" << lineNumber << ": " << error << "\n";
+            }
+        }
+        else
+        {
+            int value = 0;
+            std::string text;
+            if (name == "book" || name == "checkpoint")
+            {
+                valid = (bool)(stream >> text);
+                (name == "book" ? m_BookFile : m_CheckpointFile) = text;
+            }
+            else if (!(stream >> value))
+            {
+                valid = false;
+            }
+            else if (name == "depth" && value >= 1) m_Depth = value;
+            else if (name == "player" && (value == 0 || value == 1)) m_Player = (char)value;
+            else if (name == "search_depth" && value >= 0 && value < SearchResult::MAX_VARIATION) m_SearchDepth = (char)value;
+            else if (name == "min_depth" && value >= 1 && value < SearchResult::MAX_VARIATION) m_MinDepth = (char)value;
+            else if (name == "time_limit" && value >= 1) m_TimeLimit = value;
+            else if (name == "checkpoint_interval" && value >= 1) m_CheckpointInterval = value;
+            else valid = false;
+        }
+
+        if (!valid)
+        {
+            std::cout << filename << ":" << lineNumber << ": invalid setting\n";
+            return false;
+        }
+    }
+
+    if (m_Roots.empty())
+    {
+        std::cout << filename << ": no root positions\n";
+        return false;
+    }
+    return true;
+}
+
+OpeningsBookGenerator::OpeningsBookGenerator(const BookConfig& config)
+    : m_Config(config), m_Table(std::make_shared<TranspositionTable>()), m_Scheduler(std::make_unique<TaskScheduler>()),
+    m_NextItem(0), m_Searches(0), m_BookHits(0)
+{
+    for (int i = 0; i < m_Scheduler->Threads(); ++i)
+    {
+        m_Engines.push_back(std::make_unique<Minimax>(m_Table));
+    }
+}
+
+/**
+ * @brief Hashes the settings that decide which positions a build expands.
+ *
+ * A checkpoint is only resumed by a build with the same fingerprint.
+ */
+unsigned long long OpeningsBookGenerator::Fingerprint(const BookConfig& config)
 {
-	State* state = new State();
-    state->MutateBoard({4,4,4,1,1,1,5,2,7,5,2,6,5,1});
-    state->ChangeRuleset(1);
-    state->ChangeTurn(1);
-    Recursive(state, {5, 10, 7, 5, 3, 5, 4}, 9);
+    unsigned long long hash = 1469598103934665603ULL;
+    const auto mix = [&hash](const unsigned long long& value) { hash = (hash ^ value) * 1099511628211ULL; };
+    for (const State& root : config.m_Roots)
+    {
+        mix(root.Hash());
+    }
+    mix((unsigned long long)config.m_Depth);
+    mix((unsigned long long)config.m_Player);
+    mix((unsigned long long)config.m_SearchDepth);
+    return hash;
 }
 
-void OpeningsBookGenerator::Recursive(State* state, const std::vector<char>& history, int size)
+/**
+ * @brief Runs the build from its checkpoint or from the roots and merges the result into the book file.
+ *
+ * @return True if the book was written, false otherwise.
+ */
+bool OpeningsBookGenerator::Generate()
 {
-    if (state->m_Turn == 0)
+    LoadBook(m_Config.m_BookFile, m_Book);
+    const size_t bookSize = m_Book.size();
+
+    std::vector<WorkItem> items;
+    if (!LoadCheckpoint())
     {
-        std::vector<char> _history = history;
-        Minimax* engine = new Minimax();
-        float duration = 0.0; // Initialize duration for time limit
-        char depth = 8; // Initial depth for minimax search
-        char bestMove = -1; // Initialize best move
-        int timeLimit = 100;
-        // Perform iterative deepening search until time limit is reached
-        while (duration < timeLimit && depth < 80)
+        for (const State& root : m_Config.m_Roots)
         {
-            Timer timer(&duration); // Start timer
-            engine->BestMove(*state, depth); // Get best move using minimax with current depth
-            depth++; // Increment depth for next iteration
+            items.push_back({ root, 0 });
         }
-
-        bestMove = engine->BestMove(*state, depth);
-        _history.push_back(bestMove);
-        auto nextState = state->NextState(bestMove);
-        Recursive(&nextState, _history, size);
     }
     else
     {
-        if (history.size()>size)
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::cout << std::format("resuming from {}: {} positions queued\n", m_Config.m_CheckpointFile, m_Queue.size());
+        for (const auto& [id, item] : m_Queue)
         {
-            std::fstream file;
-            file.open("db/book.txt", std::ios::app);
-            for (int i = 0; i < history.size(); ++i)
+            m_Scheduler->Submit([this, id]() { Expand(id); });
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Enqueue(items);
+    }
+
+    // Checkpoint at a fixed interval until the queue runs empty
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (!m_Finished.wait_for(lock, std::chrono::seconds(std::max(1, m_Config.m_CheckpointInterval)), [this]() { return m_Queue.empty(); }))
+        {
+            lock.unlock();
+            SaveCheckpoint();
+            lock.lock();
+            std::cout << std::format("{} positions queued, {} book moves, {} searches\n", m_Queue.size(), m_Book.size(), m_Searches) << std::flush;
+        }
+    }
+    m_Scheduler->Wait();
+
+    if (!SaveBook(m_Config.m_BookFile, m_Book))
+    {
+        SaveCheckpoint();
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::remove(m_Config.m_CheckpointFile, error);
+
+    std::cout << std::format("book {}: {} moves ({} new), {} searches, {} positions answered by the book\n",
+        m_Config.m_BookFile, m_Book.size(), m_Book.size() - bookSize, m_Searches, m_BookHits);
+    return true;
+}
+
+/**
+ * @brief Queues positions and hands them to the scheduler. Called with m_Mutex held.
+ *
+ * @param items The positions, left empty.
+ */
+void OpeningsBookGenerator::Enqueue(std::vector<WorkItem>& items)
+{
+    for (WorkItem& item : items)
+    {
+        const unsigned long long id = m_NextItem++;
+        m_Queue.emplace(id, item);
+        m_Scheduler->Submit([this, id]() { Expand(id); });
+    }
+    items.clear();
+}
+
+/**
+ * @brief Expands one queued position: the book player's position continues with its best move, the
+ * other player's with every reply.
+ *
+ * The position is marked expanded before it is searched, so a transposition reached meanwhile through
+ * another line is not searched a second time. The item leaves the queue together with the arrival of
+ * its children, so a checkpoint never loses or repeats a line; an item interrupted while searching is
+ * expanded again on resume.
+ *
+ * @param item Id of the queued position.
+ */
+void OpeningsBookGenerator::Expand(const unsigned long long& item)
+{
+    WorkItem work;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        work = m_Queue.at(item);
+    }
+
+    std::vector<WorkItem> children;
+    const State& state = work.m_State;
+    if (work.m_Ply < m_Config.m_Depth && state.GameState() != GAMEOVER)
+    {
+        // A position reached again through another line is expanded once, from the lowest ply it is reached at
+        bool expand = true;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto [it, inserted] = m_Expanded.emplace(state.Hash(), work.m_Ply);
+            expand = inserted || it->second > work.m_Ply;
+            it->second = std::min(it->second, work.m_Ply);
+        }
+
+        if (expand && state.m_Turn == m_Config.m_Player)
+        {
+            children.push_back({ state.NextState(BestMove(state)), work.m_Ply + 1 });
+        }
+        else if (expand)
+        {
+            for (const char reply : state.LegalMoves())
             {
-                if (i != history.size() - 1)
-                {
-                    file << (int)history[i] << " ";
-                }
-                else
-                {
-                    file << (int)history[i];
-                }
+                children.push_back({ state.NextState(reply), work.m_Ply + 1 });
             }
-            file << "\n";
         }
-        else {
-            auto legalMoves = state->LegalMoves();
-            for (size_t i = 0; i < legalMoves.size(); i++)
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Queue.erase(item);
+    Enqueue(children);
+    if (m_Queue.empty())
+    {
+        m_Finished.notify_all();
+    }
+}
+
+/**
+ * @brief Returns the book move of a position, searching it when the book has none yet.
+ *
+ * @param state A position of the book player.
+ * @return The best move.
+ */
+char OpeningsBookGenerator::BestMove(const State& state)
+{
+    static MetricCounter& s_Probes = Metrics::Counter("mancala_book_probes_total", "Positions looked up while building the opening book.");
+    static MetricCounter& s_Hits = Metrics::Counter("mancala_book_hits_total", "Book lookups answered without a search.");
+
+    // Transpositions (and mirrored positions) reached through another line or an earlier build reuse the earlier answer
+    const unsigned long long key = state.CanonicalHash();
+    {
+        TraceZone zone("book probe");
+        s_Probes.Add();
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto it = m_Book.find(key);
+        const MoveList legalMoves = state.LegalMoves();
+        const char move = it == m_Book.end() ? -1 : (state.m_Turn == 1 ? State::MirrorMove(it->second.m_Move) : it->second.m_Move);
+        if (std::find(legalMoves.begin(), legalMoves.end(), move) != legalMoves.end())
+        {
+            s_Hits.Add();
+            m_BookHits++;
+            return move;
+        }
+    }
+
+    Minimax& engine = *m_Engines[TaskScheduler::WorkerIndex()];
+    SearchOptions options;
+    if (m_Config.m_SearchDepth > 0)
+    {
+        options.m_MinDepth = options.m_MaxDepth = m_Config.m_SearchDepth;
+    }
+    else
+    {
+        // Perform iterative deepening search until an iteration reaches the time limit, then search once more one depth deeper
+        options.m_MinDepth = m_Config.m_MinDepth;
+        options.m_TimeLimit = (float)m_Config.m_TimeLimit;
+        options.m_MinDepth = options.m_MaxDepth = std::min(SearchHandle::Search(engine, state, options).m_Depth + 1, SearchResult::MAX_VARIATION - 1);
+        options.m_TimeLimit = 0.0F;
+    }
+
+    // The search runs on this worker: waiting for a task of the same scheduler could starve it
+    const SearchResult result = SearchHandle::Search(engine, state, options);
+
+    BookRecord record = {};
+    record.m_Key = key;
+    record.m_Move = state.m_Turn == 1 ? State::MirrorMove(result.m_BestMove) : result.m_BestMove;
+    record.m_Depth = result.m_Depth;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Book[key] = record;
+    m_Searches++;
+    return result.m_BestMove;
+}
+
+/**
+ * @brief Restores the queue, the expanded positions and the moves of an interrupted build.
+ *
+ * @return True if a checkpoint of a build with the same settings was restored, false otherwise.
+ */
+bool OpeningsBookGenerator::LoadCheckpoint()
+{
+    std::ifstream file(m_Config.m_CheckpointFile, std::ios::binary);
+    char magic[4];
+    unsigned long long fingerprint = 0;
+    if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, CHECKPOINT_MAGIC) ||
+        !file.read((char*)&fingerprint, sizeof(fingerprint)))
+    {
+        return false;
+    }
+    if (fingerprint != Fingerprint(m_Config))
+    {
+        std::cout << std::format("{} belongs to a build with other settings, starting from the roots\n", m_Config.m_CheckpointFile);
+        return false;
+    }
+
+    std::unordered_map<unsigned long long, BookRecord> book;
+    std::unordered_map<unsigned long long, int> expanded;
+    std::unordered_map<unsigned long long, WorkItem> queue;
+    unsigned long long count = 0;
+
+    bool valid = (bool)file.read((char*)&count, sizeof(count));
+    for (unsigned long long i = 0; valid && i < count; ++i)
+    {
+        BookRecord record;
+        valid = (bool)file.read((char*)&record, sizeof(record));
+        book[record.m_Key] = record;
+    }
+
+    valid = valid && file.read((char*)&count, sizeof(count));
+    for (unsigned long long i = 0; valid && i < count; ++i)
+    {
+        unsigned long long hash = 0;
+        int ply = 0;
+        valid = file.read((char*)&hash, sizeof(hash)) && file.read((char*)&ply, sizeof(ply));
+        expanded[hash] = ply;
+    }
+
+    valid = valid && file.read((char*)&count, sizeof(count));
+    for (unsigned long long i = 0; valid && i < count; ++i)
+    {
+        char position[16];
+        int ply = 0;
+        valid = file.read(position, sizeof(position)) && file.read((char*)&ply, sizeof(ply));
+
+        WorkItem item = { State(), ply };
+        std::copy(position, position + 14, item.m_State.m_Board.begin());
+        item.m_State.m_Turn = position[14];
+        item.m_State.m_Ruleset = position[15];
+        queue.emplace(i, item);
+    }
+
+    if (!valid)
+    {
+        std::cout << std::format("{} is truncated, starting from the roots\n", m_Config.m_CheckpointFile);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (const auto& [key, record] : book)
+    {
+        m_Book[key] = record;
+    }
+    m_Expanded = std::move(expanded);
+    m_Queue = std::move(queue);
+    m_NextItem = count;
+    return true;
+}
+
+/**
+ * @brief Writes the queue, the expanded positions and the moves found so far to the checkpoint file.
+ *
+ * The state is copied under the lock, so it is consistent, and replaces the previous checkpoint through
+ * the synced write path of the persistence queue. Positions still queued are left out of the expanded
+ * ones, as they are expanded again on resume.
+ *
+ * @return True if the checkpoint was written, false otherwise.
+ */
+bool OpeningsBookGenerator::SaveCheckpoint()
+{
+    TraceZone zone("book checkpoint");
+    std::string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    const auto append = [&data](const void* value, const size_t& size) { data.append((const char*)value, size); };
+    const unsigned long long fingerprint = Fingerprint(m_Config);
+    append(&fingerprint, sizeof(fingerprint));
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        unsigned long long count = m_Book.size();
+        append(&count, sizeof(count));
+        for (const auto& [key, record] : m_Book)
+        {
+            append(&record, sizeof(record));
+        }
+
+        std::unordered_set<unsigned long long> queued;
+        for (const auto& [id, item] : m_Queue)
+        {
+            queued.insert(item.m_State.Hash());
+        }
+
+        count = 0;
+        const size_t countOffset = data.size();
+        append(&count, sizeof(count));
+        for (const auto& [hash, ply] : m_Expanded)
+        {
+            if (queued.count(hash) == 0)
             {
-                std::vector<char> _history = history;
-                _history.push_back(legalMoves[i]);
-                auto nextState = state->NextState(legalMoves[i]);
-                Recursive(&nextState, _history, size);
+                append(&hash, sizeof(hash));
+                append(&ply, sizeof(ply));
+                count++;
             }
         }
+        data.replace(countOffset, sizeof(count), (const char*)&count, sizeof(count));
+
+        count = m_Queue.size();
+        append(&count, sizeof(count));
+        for (const auto& [id, item] : m_Queue)
+        {
+            char position[16];
+            std::copy(item.m_State.m_Board.begin(), item.m_State.m_Board.end(), position);
+            position[14] = item.m_State.m_Turn;
+            position[15] = item.m_State.m_Ruleset;
+            append(position, sizeof(position));
+            append(&item.m_Ply, sizeof(item.m_Ply));
+        }
+    }
+
+    const std::filesystem::path path(m_Config.m_CheckpointFile);
+    std::error_code error;
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+    if (!PersistenceQueue::WriteFile(m_Config.m_CheckpointFile, data, true, true))
+    {
+        std::cout << "Could not write " << m_Config.m_CheckpointFile << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads a binary book: the magic "MBK1", the record size and records sorted by key.
+ *
+ * @param filename The book file.
+ * @param entries Receives the records, added to the ones already there.
+ * @return True if the file is a book with the expected record size, false otherwise.
+ */
+bool OpeningsBookGenerator::LoadBook(const std::string& filename, std::unordered_map<unsigned long long, BookRecord>& entries)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4];
+    int recordSize = 0;
+    if (!file.read(magic, sizeof(magic)) || !file.read((char*)&recordSize, sizeof(recordSize)) ||
+        !std::equal(magic, magic + 4, BOOK_MAGIC) || recordSize != (int)sizeof(BookRecord))
+    {
+        return false;
+    }
+
+    BookRecord record;
+    while (file.read((char*)&record, sizeof(record)))
+    {
+        entries[record.m_Key] = record;
+    }
+    return true;
+}
+
+/**
+ * @brief Merges records into a binary book and replaces the file atomically.
+ *
+ * The book is read again before merging; of a position in both, the record searched deeper is kept.
+ * The merged book goes through the synced write path of the persistence queue, so readers see either
+ * the old or the new book, also after a crash.
+ *
+ * @param filename The book file.
+ * @param entries The records to merge.
+ * @return True if the book was written, false otherwise.
+ */
+bool OpeningsBookGenerator::SaveBook(const std::string& filename, const std::unordered_map<unsigned long long, BookRecord>& entries)
+{
+    std::unordered_map<unsigned long long, BookRecord> merged;
+    LoadBook(filename, merged);
+    for (const auto& [key, record] : entries)
+    {
+        auto it = merged.find(key);
+        if (it == merged.end() || record.m_Depth >= it->second.m_Depth)
+        {
+            merged[key] = record;
+        }
+    }
+
+    std::vector<BookRecord> records;
+    records.reserve(merged.size());
+    for (const auto& [key, record] : merged)
+    {
+        records.push_back(record);
+    }
+    std::sort(records.begin(), records.end(), [](const BookRecord& a, const BookRecord& b) { return a.m_Key < b.m_Key; });
+
+    const int recordSize = (int)sizeof(BookRecord);
+    std::string data(BOOK_MAGIC, sizeof(BOOK_MAGIC));
+    data.append((const char*)&recordSize, sizeof(recordSize));
+    data.append((const char*)records.data(), records.size() * sizeof(BookRecord));
+
+    const std::filesystem::path path(filename);
+    std::error_code error;
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+    if (!PersistenceQueue::WriteFile(filename, data, true, true))
+    {
+        std::cout << "Could not write " << filename << "\n";
+        return false;
     }
+    return true;
 }
 
+/**
+ * @brief Builds or extends the book described by a config file.
+ *
+ * @param configFile The config file.
+ * @return The exit code of the command.
+ */
+int OpeningsBookGenerator::Start(const std::string& configFile)
+{
+    BookConfig config;
+    if (!config.Load(configFile))
+    {
+        return 1;
+    }
+
+    float duration = 0.0F;
+    bool written = false;
+    {
+        Timer timer(&duration);
+        OpeningsBookGenerator generator(config);
+        written = generator.Generate();
+    }
+    std::cout << std::format("book build took {} ms\n", duration);
+    return written ? 0 : 1;
+}
@@ -1,10 +1,111 @@
-#include <vector>
 #pragma once
-class State;
-
-class OpeningsBookGenerator {
-public:
-	OpeningsBookGenerator();
-	void Generate();
-	void Recursive(State* state, const std::vector<char>& history, int size);
-};
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mancala-engine.h"
+#include "task-scheduler.h"
+
+/**
+ * @brief One position of the binary opening book as stored on disk.
+ */
+struct BookRecord
+{
+	unsigned long long m_Key; // State::CanonicalHash of the position
+	char m_Move;              // Best move in the canonical frame
+	char m_Depth;             // Depth the move was searched to
+	char m_Reserved[6];       // Zero
+};
+
+static_assert(sizeof(BookRecord) == 16, "book records have a fixed size");
+
+/**
+ * @brief Settings of a book build, read from a config file.
+ *
+ * The file holds one setting per line, '#' starts a comment:
+ *
+ *     root 4-4-4-4-4-4-0-4-4-4-4-4-4-0 0 0   board, player to move and ruleset of a line to build; repeatable
+ *     depth 10                              plies below every root
+ *     player 0                              side the book answers for, every reply of the other side is expanded
+ *     search_depth 0                        fixed search depth, 0 to deepen from min_depth until an iteration
+ *     min_depth 8                             takes time_limit ms and search once more one depth deeper
+ *     time_limit 100
+ *     checkpoint_interval 30                seconds between checkpoints
+ *     book db/book.bin
+ *     checkpoint db/book.checkpoint
+ */
+struct BookConfig
+{
+	std::vector<State> m_Roots;
+	int m_Depth = 10;
+	char m_Player = 0;
+	char m_SearchDepth = 0;
+	char m_MinDepth = 8;
+	int m_TimeLimit = 100;
+	int m_CheckpointInterval = 30;
+	std::string m_BookFile = "db/book.bin";
+	std::string m_CheckpointFile = "db/book.checkpoint";
+
+	bool Load(const std::string& filename);
+};
+
+/**
+ * @brief Builds the opening book as a resumable job.
+ *
+ * The book stores a best move for every position of its player reached within the configured depth of
+ * the roots, when the other player may answer anything. The positions still to expand form a work queue
+ * whose items run as tasks of a work-stealing scheduler; an item is replaced by its children under one
+ * lock, so at any moment the queue and the moves found so far describe the rest of the build exactly.
+ * They are written to a checkpoint file at a fixed interval, and a build started with the same config
+ * continues from the checkpoint instead of from the roots.
+ *
+ * Positions the book already answers are not searched again, so rebuilding to a larger depth only
+ * searches the new plies. When the queue is empty the moves are merged into the book file, keeping the
+ * deeper search of a position found in both, written to a temporary file and renamed over the book, and
+ * the checkpoint is removed.
+ */
+class OpeningsBookGenerator {
+public:
+	static constexpr char BOOK_MAGIC[4] = { 'M', 'B', 'K', '1' };
+	static constexpr char CHECKPOINT_MAGIC[4] = { 'M', 'B', 'C', '1' };
+
+	OpeningsBookGenerator(const BookConfig& config);
+	bool Generate();
+
+	static bool LoadBook(const std::string& filename, std::unordered_map<unsigned long long, BookRecord>& entries);
+	static bool SaveBook(const std::string& filename, const std::unordered_map<unsigned long long, BookRecord>& entries);
+	static int Start(const std::string& configFile);
+	static unsigned long long Fingerprint(const BookConfig& config);
+
+private:
+	/**
+	 * @brief A position waiting to be expanded.
+	 */
+	struct WorkItem
+	{
+		State m_State;
+		int m_Ply; // Distance from its root
+	};
+
+	BookConfig m_Config;
+	std::shared_ptr<TranspositionTable> m_Table;       // Shared by every engine so all lines reuse each other's work
+	std::vector<std::unique_ptr<Minimax>> m_Engines;   // One per worker of m_Scheduler
+	std::unique_ptr<TaskScheduler> m_Scheduler;        // Runs every queued position as its own task
+
+	std::mutex m_Mutex;                                           // Guards the build state below
+	std::condition_variable m_Finished;                           // Signalled when the queue runs empty
+	std::unordered_map<unsigned long long, BookRecord> m_Book;    // Moves of the book file and of this build
+	std::unordered_map<unsigned long long, int> m_Expanded;       // State::Hash of expanded positions and the lowest ply they were expanded at
+	std::unordered_map<unsigned long long, WorkItem> m_Queue;     // Positions queued or being expanded, by item id
+	unsigned long long m_NextItem;
+	unsigned long long m_Searches;
+	unsigned long long m_BookHits;
+
+	void Expand(const unsigned long long& item);
+	char BestMove(const State& state);
+	void Enqueue(std::vector<WorkItem>& items);
+	bool LoadCheckpoint();
+	bool SaveCheckpoint();
+};
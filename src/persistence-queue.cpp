@@ -0,0 +1,238 @@
+#include "persistence-queue.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Starts the writer thread.
+ *
+ * @param capacity Writes that can be queued before callers block.
+ * @param policy When written files are forced to disk.
+ */
+PersistenceQueue::PersistenceQueue(const size_t& capacity, const SyncPolicyEnum& policy)
+    : m_Capacity(std::max<size_t>(1, capacity)), m_Policy(policy), m_Writing(false), m_Stop(false),
+      m_Writes(Metrics::Counter("mancala_persistence_writes_total", "File writes queued for the persistence thread.")),
+      m_Batches(Metrics::Counter("mancala_persistence_batches_total", "Batches written by the persistence thread.")),
+      m_Failures(Metrics::Counter("mancala_persistence_failures_total", "Files the persistence thread failed to write.")),
+      m_BatchLatency(Metrics::Histogram("mancala_persistence_batch_seconds", "Time the persistence thread took to write and sync a batch."))
+{
+    m_Writer = std::thread(&PersistenceQueue::WriterLoop, this);
+}
+
+/**
+ * @brief Writes everything still queued and stops the writer thread.
+ */
+PersistenceQueue::~PersistenceQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Queued.notify_all();
+    m_Writer.join();
+}
+
+/**
+ * @brief Queues a write, blocking only while the queue is full.
+ *
+ * @param path The file to write.
+ * @param data The bytes to write.
+ * @param mode Whether the data replaces the file or is appended to it.
+ */
+void PersistenceQueue::Write(const std::string& path, std::string data, const WriteModeEnum& mode)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Finished.wait(lock, [this]() { return m_Requests.size() < m_Capacity; });
+        m_Requests.push_back({ path, std::move(data), mode });
+    }
+    m_Writes.Add();
+    m_Queued.notify_one();
+}
+
+/**
+ * @brief Queues an atomic replacement of a file.
+ */
+void PersistenceQueue::Replace(const std::string& path, std::string data)
+{
+    Write(path, std::move(data), REPLACE);
+}
+
+/**
+ * @brief Queues an append to a file.
+ */
+void PersistenceQueue::Append(const std::string& path, std::string data)
+{
+    Write(path, std::move(data), APPEND);
+}
+
+/**
+ * @brief Waits until every write queued so far is on disk.
+ */
+void PersistenceQueue::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Finished.wait(lock, [this]() { return m_Requests.empty() && !m_Writing; });
+}
+
+/**
+ * @brief Takes every queued write as one batch until stopped and the queue is empty.
+ */
+void PersistenceQueue::WriterLoop()
+{
+    while (true)
+    {
+        std::deque<WriteRequest> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Queued.wait(lock, [this]() { return !m_Requests.empty() || m_Stop; });
+            if (m_Requests.empty())
+            {
+                return; // Stopped with nothing left to write
+            }
+            batch.swap(m_Requests);
+            m_Writing = true;
+        }
+        m_Finished.notify_all(); // The queue has space again
+
+        WriteBatch(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Writing = false;
+        }
+        m_Finished.notify_all();
+    }
+}
+
+/**
+ * @brief Merges the writes of a batch per file and writes every file once.
+ *
+ * @param batch The writes in the order they were queued.
+ */
+void PersistenceQueue::WriteBatch(std::deque<WriteRequest>& batch)
+{
+    TraceZone zone("persistence batch");
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    struct PendingFile
+    {
+        bool m_Replace = false;
+        std::string m_Data;
+    };
+    std::vector<std::string> order; // Files in the order they were first written
+    std::unordered_map<std::string, PendingFile> files;
+    for (WriteRequest& request : batch)
+    {
+        auto [it, inserted] = files.try_emplace(request.m_Path);
+        if (inserted)
+        {
+            order.push_back(request.m_Path);
+        }
+
+        if (request.m_Mode == REPLACE)
+        {
+            it->second.m_Replace = true;
+            it->second.m_Data = std::move(request.m_Data);
+        }
+        else
+        {
+            it->second.m_Data += request.m_Data;
+        }
+    }
+
+    for (const std::string& path : order)
+    {
+        const PendingFile& file = files[path];
+        CreateParentDirectory(path);
+        if (!WriteFile(path, file.m_Data, file.m_Replace, m_Policy == SYNC_BATCH))
+        {
+            m_Failures.Add();
+            std::cerr << "Cannot write " << path << "\n";
+        }
+    }
+
+    m_Batches.Add();
+    m_BatchLatency.Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * @brief Writes one file on the calling thread; the writer thread writes every file of a batch with it.
+ *
+ * Replacements are written to a temporary file that is renamed over the original once it is completely
+ * written, so readers never see a partially written file and a failed write keeps the original. The
+ * directory of the file has to exist.
+ *
+ * @param path The file to write.
+ * @param data The bytes to write.
+ * @param replace Whether the data replaces the file or is appended to it.
+ * @param sync Whether the file is forced to disk before it replaces the original.
+ * @return True if the file was written, false otherwise.
+ */
+bool PersistenceQueue::WriteFile(const std::string& path, const std::string& data, const bool& replace, const bool& sync)
+{
+    const std::string target = replace ? path + ".tmp" : path;
+    FILE* file = std::fopen(target.c_str(), replace ? "wb" : "ab");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = std::fflush(file) == 0 && written;
+    if (sync)
+    {
+#if defined(_WIN32)
+        written = _commit(_fileno(file)) == 0 && written;
+#else
+        written = fsync(fileno(file)) == 0 && written;
+#endif
+    }
+    written = std::fclose(file) == 0 && written;
+
+    if (replace)
+    {
+        // A failed write leaves the original in place, only a complete file replaces it
+        std::error_code error;
+        if (written)
+        {
+            std::filesystem::rename(target, path, error);
+            written = !error;
+        }
+        if (!written)
+        {
+            std::filesystem::remove(target, error);
+        }
+    }
+    return written;
+}
+
+/**
+ * @brief Creates the directory of a file unless it was already seen.
+ *
+ * @param path The file whose directory has to exist.
+ */
+void PersistenceQueue::CreateParentDirectory(const std::string& path)
+{
+    const std::string directory = std::filesystem::path(path).parent_path().string();
+    if (directory.empty() || m_Directories.count(directory) != 0)
+    {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    m_Directories.insert(directory);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+#include "metrics.h"
+
+/**
+ * @brief How a queued write changes its file.
+ */
+enum WriteModeEnum
+{
+	REPLACE, // The file is replaced atomically with the data
+	APPEND   // The data is appended to the file
+};
+
+/**
+ * @brief When written files are forced to disk.
+ */
+enum SyncPolicyEnum
+{
+	SYNC_NONE,  // Left to the operating system
+	SYNC_BATCH  // Every file a batch touched is synced once at the end of the batch (group commit)
+};
+
+/**
+ * @brief Writes files on a background thread, so callers never wait for the disk.
+ *
+ * Writes are queued in a bounded queue; a caller only blocks when the queue is full. The writer
+ * thread takes everything queued as one batch and merges the writes to the same file: appends are
+ * concatenated and a replacement drops the writes queued before it. Each file is then written once
+ * per batch and, depending on the sync policy, synced once per batch. Parent directories are created
+ * on first use only. Writes to one file keep their order, writes to different files in one batch may
+ * reach the disk in any order. The destructor writes everything still queued.
+ */
+class PersistenceQueue
+{
+private:
+	/**
+	 * @brief One queued write.
+	 */
+	struct WriteRequest
+	{
+		std::string m_Path;
+		std::string m_Data;
+		WriteModeEnum m_Mode;
+	};
+
+	size_t m_Capacity;
+	SyncPolicyEnum m_Policy;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Queued;   // Signals the writer that requests arrived or it has to stop
+	std::condition_variable m_Finished; // Signals callers that space was freed or a batch completed
+	std::deque<WriteRequest> m_Requests;
+	bool m_Writing;
+	bool m_Stop;
+
+	std::unordered_set<std::string> m_Directories; // Directories known to exist, used by the writer only
+	std::thread m_Writer;
+
+	MetricCounter& m_Writes;
+	MetricCounter& m_Batches;
+	MetricCounter& m_Failures;
+	LatencyHistogram& m_BatchLatency;
+
+	void WriterLoop();
+	void WriteBatch(std::deque<WriteRequest>& batch);
+	void CreateParentDirectory(const std::string& path);
+
+public:
+	PersistenceQueue(const size_t& capacity = 1024, const SyncPolicyEnum& policy = SYNC_BATCH);
+	~PersistenceQueue();
+
+	PersistenceQueue(const PersistenceQueue&) = delete;
+	PersistenceQueue& operator=(const PersistenceQueue&) = delete;
+
+	void Write(const std::string& path, std::string data, const WriteModeEnum& mode);
+	void Replace(const std::string& path, std::string data);
+	void Append(const std::string& path, std::string data);
+	void Flush();
+
+	static bool WriteFile(const std::string& path, const std::string& data, const bool& replace, const bool& sync);
+};
@@ -0,0 +1,291 @@
+#include "position-index.h"
+
+#include <array>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using WaysTable = std::array<std::array<unsigned long long, PositionIndex::MAX_STONES + 1>, PositionIndex::PITS + 1>;
+using OffsetTable = std::array<std::array<unsigned long long, PositionIndex::MAX_STONES + 2>, PositionIndex::MAX_STONES + 1>;
+
+/**
+ * @brief Builds the table of the number of ways to distribute m stones over p pits, C(m + p - 1, p - 1).
+ */
+static constexpr WaysTable MakeWaysTable()
+{
+    WaysTable ways{};
+    ways[0][0] = 1;
+    for (int p = 1; p <= PositionIndex::PITS; ++p)
+    {
+        for (int m = 0; m <= PositionIndex::MAX_STONES; ++m)
+        {
+            ways[p][m] = ways[p - 1][m] + (m > 0 ? ways[p][m - 1] : 0);
+        }
+    }
+    return ways;
+}
+
+static constexpr WaysTable s_Ways = MakeWaysTable();
+
+/**
+ * @brief Builds the first index of every layer: offsets[total][n] counts the positions with fewer than
+ * n stones on the board.
+ */
+static constexpr OffsetTable MakeOffsetTable()
+{
+    OffsetTable offsets{};
+    for (int total = 0; total <= PositionIndex::MAX_STONES; ++total)
+    {
+        for (int n = 0; n <= total; ++n)
+        {
+            offsets[total][n + 1] = offsets[total][n] + s_Ways[PositionIndex::PITS][n] * (unsigned long long)(total - n + 1) * 2;
+        }
+        for (int n = total + 1; n <= PositionIndex::MAX_STONES; ++n)
+        {
+            offsets[total][n + 1] = offsets[total][n];
+        }
+    }
+    return offsets;
+}
+
+static constexpr OffsetTable s_Offsets = MakeOffsetTable();
+
+// Every stone is either in a pit or in one of the two stores, so the layers tile C(total + 13, 13) boards
+static_assert(s_Offsets[PositionIndex::MAX_STONES][PositionIndex::MAX_STONES + 1] == 2ULL * 6566222272575ULL);
+
+/**
+ * @brief Checks whether a position can be indexed.
+ *
+ * @param state The position to check.
+ * @return True if the board holds at most MAX_STONES stones, false otherwise.
+ */
+bool PositionIndex::Indexable(const State& state)
+{
+    int total = 0;
+    for (char stones : state.m_Board)
+    {
+        total += stones;
+    }
+    return total <= MAX_STONES;
+}
+
+/**
+ * @brief Returns the number of positions with the given total number of stones.
+ *
+ * @param total The number of stones in the pits and stores together.
+ * @return The size of the index range.
+ */
+unsigned long long PositionIndex::Count(const int& total)
+{
+    return s_Offsets[total][total + 1];
+}
+
+/**
+ * @brief Returns the first index of the positions with the given number of stones on the board.
+ *
+ * @param total The number of stones in the pits and stores together.
+ * @param stones The number of stones in the pits, at most total + 1.
+ * @return The index of the first position of the layer.
+ */
+unsigned long long PositionIndex::LayerOffset(const int& total, const int& stones)
+{
+    return s_Offsets[total][stones];
+}
+
+/**
+ * @brief Ranks a distribution of stones over the pits in lexicographic order.
+ *
+ * @param pits The PITS pit counts.
+ * @param stones The sum of the pit counts.
+ * @return The rank in [0, C(stones + PITS - 1, PITS - 1)).
+ */
+unsigned long long PositionIndex::RankPits(const char* pits, const int& stones)
+{
+    unsigned long long rank = 0;
+    int remaining = stones;
+    for (int i = 0; i < PITS - 1; ++i)
+    {
+        // Distributions with fewer stones in this pit come first
+        const int p = PITS - i;
+        rank += s_Ways[p][remaining] - s_Ways[p][remaining - pits[i]];
+        remaining -= pits[i];
+    }
+    return rank;
+}
+
+/**
+ * @brief Restores a distribution of stones over the pits from its rank.
+ *
+ * @param rank The rank returned by RankPits.
+ * @param stones The sum of the pit counts.
+ * @param pits Receives the PITS pit counts.
+ */
+void PositionIndex::UnrankPits(unsigned long long rank, const int& stones, char* pits)
+{
+    int remaining = stones;
+    for (int i = 0; i < PITS - 1; ++i)
+    {
+        const int p = PITS - i;
+        char count = 0;
+        while (rank >= s_Ways[p - 1][remaining - count])
+        {
+            rank -= s_Ways[p - 1][remaining - count];
+            count++;
+        }
+        pits[i] = count;
+        remaining -= count;
+    }
+    pits[PITS - 1] = (char)remaining;
+}
+
+/**
+ * @brief Returns the index of a position.
+ *
+ * @param state The position, which has to be Indexable.
+ * @return The index in [0, Count(total)), where total is the number of stones of the position.
+ */
+unsigned long long PositionIndex::Rank(const State& state)
+{
+    char pits[PITS];
+    int stones = 0;
+    for (int i = 0; i < PITS; ++i)
+    {
+        pits[i] = state.m_Board[i < 6 ? i : i + 1];
+        stones += pits[i];
+    }
+
+    const int total = stones + state.m_Board[6] + state.m_Board[13];
+    const unsigned long long local = RankPits(pits, stones) * (unsigned long long)(total - stones + 1) + state.m_Board[6];
+    return s_Offsets[total][stones] + local * 2 + state.m_Turn;
+}
+
+/**
+ * @brief Returns the key of a searched position in the position cache (CACHE_FILE).
+ *
+ * The key packs the index of the position with the search depth, the total number of stones and the
+ * ruleset, as the index leaves the ruleset out and the best move depends on it.
+ *
+ * @param canonical The position in its canonical form, which has to be Indexable.
+ * @param depth The depth the position was searched to.
+ * @return The cache key.
+ */
+unsigned long long PositionIndex::CacheKey(const State& canonical, const char& depth)
+{
+    const int total = canonical.TotalStones(0, 14);
+    return ((Rank(canonical) * 128 + depth) * (MAX_STONES + 1) + total) * 2 + canonical.m_Ruleset;
+}
+
+/**
+ * @brief Restores a position from its index.
+ *
+ * @param index The index returned by Rank.
+ * @param total The number of stones of the position.
+ * @param ruleset The ruleset of the returned position.
+ * @return The position.
+ */
+State PositionIndex::Unrank(const unsigned long long& index, const int& total, const char& ruleset)
+{
+    int stones = 0;
+    while (s_Offsets[total][stones + 1] <= index)
+    {
+        stones++;
+    }
+
+    unsigned long long local = index - s_Offsets[total][stones];
+    const char turn = (char)(local & 1);
+    local >>= 1;
+    const unsigned long long storeChoices = (unsigned long long)(total - stones + 1);
+    const char store = (char)(local % storeChoices);
+
+    char pits[PITS];
+    UnrankPits(local / storeChoices, stones, pits);
+
+    State state;
+    for (int i = 0; i < PITS; ++i)
+    {
+        state.m_Board[i < 6 ? i : i + 1] = pits[i];
+    }
+    state.m_Board[6] = store;
+    state.m_Board[13] = (char)(total - stones - store);
+    state.m_Turn = turn;
+    state.m_Ruleset = ruleset;
+    return state;
+}
+
+/**
+ * @brief Returns the indices of many positions.
+ *
+ * With AVX2 four positions are ranked at once: the two table lookups per pit become gathers from the
+ * binomial table. Other builds rank the positions one by one.
+ *
+ * @param states The positions, which have to be Indexable.
+ * @param count The number of positions.
+ * @param indices Receives count indices.
+ */
+void PositionIndex::RankBatch(const State* states, const size_t& count, unsigned long long* indices)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const long long* ways = (const long long*)s_Ways.data();
+    for (; i + 4 <= count; i += 4)
+    {
+        alignas(32) long long pits[PITS][4];
+        alignas(32) long long stones[4];
+        alignas(32) long long ranks[4];
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            const char* board = states[i + lane].m_Board.data();
+            stones[lane] = 0;
+            for (int pit = 0; pit < PITS; ++pit)
+            {
+                pits[pit][lane] = board[pit < 6 ? pit : pit + 1];
+                stones[lane] += pits[pit][lane];
+            }
+        }
+
+        __m256i remaining = _mm256_load_si256((const __m256i*)stones);
+        __m256i rank = _mm256_setzero_si256();
+        for (int pit = 0; pit < PITS - 1; ++pit)
+        {
+            const __m256i row = _mm256_set1_epi64x((long long)(PITS - pit) * (MAX_STONES + 1));
+            const __m256i before = _mm256_i64gather_epi64(ways, _mm256_add_epi64(row, remaining), 8);
+            remaining = _mm256_sub_epi64(remaining, _mm256_load_si256((const __m256i*)pits[pit]));
+            const __m256i after = _mm256_i64gather_epi64(ways, _mm256_add_epi64(row, remaining), 8);
+            rank = _mm256_add_epi64(rank, _mm256_sub_epi64(before, after));
+        }
+        _mm256_store_si256((__m256i*)ranks, rank);
+
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            const State& state = states[i + lane];
+            const int total = (int)stones[lane] + state.m_Board[6] + state.m_Board[13];
+            const unsigned long long local = (unsigned long long)ranks[lane] * (unsigned long long)(total - stones[lane] + 1) + state.m_Board[6];
+            indices[i + lane] = s_Offsets[total][stones[lane]] + local * 2 + state.m_Turn;
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        indices[i] = Rank(states[i]);
+    }
+}
+
+/**
+ * @brief Restores many positions with the same total number of stones from their indices.
+ *
+ * Unranking searches the binomial table pit by pit, so positions are restored one by one.
+ *
+ * @param indices The indices returned by Rank.
+ * @param count The number of positions.
+ * @param total The number of stones of every position.
+ * @param ruleset The ruleset of the returned positions.
+ * @param states Receives count positions.
+ */
+void PositionIndex::UnrankBatch(const unsigned long long* indices, const size_t& count, const int& total, const char& ruleset, State* states)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        states[i] = Unrank(indices[i], total, ruleset);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+#include "state.h"
+
+/**
+ * @brief Maps positions to dense integer indices and back.
+ *
+ * Every position with a given total number of stones gets a unique index in [0, Count(total)). The
+ * indices are laid out in layers by the number of stones left in the pits, so all positions with n
+ * stones on the board occupy the contiguous range [LayerOffset(total, n), LayerOffset(total, n + 1)).
+ * Within a layer the index is the rank of the pit distribution, then player 1's store, then the
+ * player to move. The ruleset is not part of the index.
+ *
+ * Ranks are computed from binomial tables built at compile time, so no strings or hash maps are
+ * needed: a database of positions can be a flat array indexed by Rank.
+ */
+class PositionIndex
+{
+public:
+	static constexpr int PITS = 12;        // Pits excluding the stores
+	static constexpr int MAX_STONES = 48;  // Largest total number of stones that can be indexed
+	static constexpr const char* CACHE_FILE = "db/cache/positions-v2.dat"; // Position cache keyed by CacheKey; earlier keys lacked the ruleset
+
+	static bool Indexable(const State& state);
+	static unsigned long long Count(const int& total);
+	static unsigned long long LayerOffset(const int& total, const int& stones);
+
+	static unsigned long long RankPits(const char* pits, const int& stones);
+	static void UnrankPits(unsigned long long rank, const int& stones, char* pits);
+
+	static unsigned long long Rank(const State& state);
+	static State Unrank(const unsigned long long& index, const int& total, const char& ruleset = 0);
+	static unsigned long long CacheKey(const State& canonical, const char& depth);
+
+	static void RankBatch(const State* states, const size_t& count, unsigned long long* indices);
+	static void UnrankBatch(const unsigned long long* indices, const size_t& count, const int& total, const char& ruleset, State* states);
+};
@@ -0,0 +1,394 @@
+#include "proof-number-solver.h"
+
+#include <algorithm>
+
+/**
+ * @brief Adds two proof (or disproof) numbers, saturating at INFINITE.
+ */
+static unsigned int SaturatedAdd(const unsigned int& a, const unsigned int& b)
+{
+    return (unsigned int)std::min<unsigned long long>((unsigned long long)a + b, ProofNumberSolver::INFINITE);
+}
+
+/**
+ * @brief Constructs a solver with the given budget.
+ *
+ * @param nodeLimit Maximum number of positions expanded per call to Solve.
+ * @param timeLimit Maximum time per call to Solve, in milliseconds.
+ * @param tableLimit Maximum number of transposition table entries kept in memory.
+ */
+ProofNumberSolver::ProofNumberSolver(const unsigned long long& nodeLimit, const float& timeLimit, const size_t& tableLimit)
+    : m_TableLimit(tableLimit), m_NodeLimit(nodeLimit), m_TimeLimit(timeLimit), m_Nodes(0), m_Attacker(0), m_Aborted(false)
+{
+}
+
+/**
+ * @brief Computes the game-theoretic value of a position.
+ *
+ * @param state The position to solve.
+ * @return The proven value, the proof size, the nodes searched and the time taken.
+ */
+ProofResult ProofNumberSolver::Solve(const State& state)
+{
+    ProofResult result;
+    m_Nodes = 0;
+    m_Aborted = false;
+    m_Start = std::chrono::steady_clock::now();
+
+    // Can player 1 force a win? If not, can player 2? If neither can, the position is a draw
+    char bestMove = -1;
+    std::unordered_map<unsigned long long, bool> visited;
+    if (!Solve(state, 0, bestMove))
+    {
+        result.m_Result = UNKNOWN;
+    }
+    else if (Lookup(state).m_ProofNumber == 0)
+    {
+        result.m_Result = PLAYER1_WIN;
+        result.m_BestMove = state.m_Turn == 0 ? bestMove : -1;
+        result.m_ProofSize = ProofSize(state, visited);
+    }
+    else
+    {
+        const unsigned long long disproofSize = ProofSize(state, visited);
+        visited.clear();
+
+        if (!Solve(state, 1, bestMove))
+        {
+            result.m_Result = UNKNOWN;
+        }
+        else if (Lookup(state).m_ProofNumber == 0)
+        {
+            result.m_Result = PLAYER2_WIN;
+            result.m_BestMove = state.m_Turn == 1 ? bestMove : -1;
+            result.m_ProofSize = ProofSize(state, visited);
+        }
+        else
+        {
+            // Both disproofs together show that each player can hold the draw
+            result.m_Result = DRAW;
+            result.m_ProofSize = disproofSize + ProofSize(state, visited);
+        }
+    }
+
+    result.m_Nodes = m_Nodes;
+    result.m_Duration = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+    m_Table.clear();
+    return result;
+}
+
+/**
+ * @brief Runs df-pn to decide whether the attacker can force a win.
+ *
+ * @param state The position to solve.
+ * @param attacker The player whose win is being proven.
+ * @param bestMove Receives the winning move when the attacker is to move and wins, or the refutation
+ * when the defender is to move and holds.
+ * @return True if the question was answered within the budget, false otherwise.
+ */
+bool ProofNumberSolver::Solve(const State& state, const char& attacker, char& bestMove)
+{
+    m_Attacker = attacker; // The table is keyed in the attacker's frame, so it stays valid for the other attacker
+
+
+    MID(state, INFINITE, INFINITE);
+
+    const ProofEntry root = Lookup(state);
+    if (m_Aborted || (root.m_ProofNumber != 0 && root.m_DisproofNumber != 0))
+    {
+        return false;
+    }
+
+    // The root's move is the child that carries the proof (or the disproof)
+    bestMove = -1;
+    for (char move : state.LegalMoves())
+    {
+        const ProofEntry child = Lookup(state.NextState(move));
+        if ((state.m_Turn == m_Attacker && child.m_ProofNumber == 0) || (state.m_Turn != m_Attacker && child.m_DisproofNumber == 0))
+        {
+            bestMove = move;
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Expands a position until its proof or disproof number reaches its threshold.
+ *
+ * @param state The position to expand.
+ * @param proofThreshold Return once the proof number reaches this value.
+ * @param disproofThreshold Return once the disproof number reaches this value.
+ */
+void ProofNumberSolver::MID(const State& state, const unsigned int& proofThreshold, const unsigned int& disproofThreshold)
+{
+    ProofEntry entry = Lookup(state);
+    if (entry.m_ProofNumber >= proofThreshold || entry.m_DisproofNumber >= disproofThreshold)
+    {
+        return;
+    }
+
+    if (OutOfBudget())
+    {
+        m_Aborted = true;
+        return;
+    }
+
+    m_Nodes++;
+    const unsigned long long startNodes = m_Nodes;
+    const bool orNode = state.m_Turn == m_Attacker;
+
+    std::vector<State> children;
+    for (char move : state.LegalMoves())
+    {
+        children.push_back(state.NextState(move));
+    }
+
+    std::vector<ProofEntry> childEntries(children.size());
+    while (true)
+    {
+        // OR nodes need one proven child and every child disproven, AND nodes the opposite
+        size_t best = 0;
+        unsigned int second = INFINITE;
+        unsigned int proofNumber = orNode ? INFINITE : 0;
+        unsigned int disproofNumber = orNode ? 0 : INFINITE;
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            childEntries[i] = Lookup(children[i]);
+            const unsigned int childProof = childEntries[i].m_ProofNumber;
+            const unsigned int childDisproof = childEntries[i].m_DisproofNumber;
+            const unsigned int key = orNode ? childProof : childDisproof;
+            const unsigned int bestKey = orNode ? childEntries[best].m_ProofNumber : childEntries[best].m_DisproofNumber;
+
+            if (i == 0 || key < bestKey)
+            {
+                if (i != 0)
+                {
+                    second = bestKey;
+                }
+                best = i;
+            }
+            else if (key < second)
+            {
+                second = key;
+            }
+
+            if (orNode)
+            {
+                proofNumber = std::min(proofNumber, childProof);
+                disproofNumber = SaturatedAdd(disproofNumber, childDisproof);
+            }
+            else
+            {
+                proofNumber = SaturatedAdd(proofNumber, childProof);
+                disproofNumber = std::min(disproofNumber, childDisproof);
+            }
+        }
+
+        entry.m_ProofNumber = proofNumber;
+        entry.m_DisproofNumber = disproofNumber;
+        if (proofNumber >= proofThreshold || disproofNumber >= disproofThreshold || m_Aborted)
+        {
+            break;
+        }
+
+        const ProofEntry& bestEntry = childEntries[best];
+        unsigned int childProofThreshold, childDisproofThreshold;
+        if (orNode)
+        {
+            childProofThreshold = std::min(proofThreshold, second + 1);
+            childDisproofThreshold = disproofThreshold - disproofNumber + bestEntry.m_DisproofNumber;
+        }
+        else
+        {
+            childProofThreshold = proofThreshold - proofNumber + bestEntry.m_ProofNumber;
+            childDisproofThreshold = std::min(disproofThreshold, second + 1);
+        }
+
+        MID(children[best], childProofThreshold, childDisproofThreshold);
+    }
+
+    entry.m_Work = m_Nodes - startNodes + 1;
+    Save(state, entry);
+}
+
+/**
+ * @brief Checks whether the result of the attacker is already decided.
+ *
+ * @param state The position to check.
+ * @param attackerWins Receives whether the attacker has won.
+ * @return True if the position is decided, false otherwise.
+ */
+bool ProofNumberSolver::IsTerminal(const State& state, bool& attackerWins) const
+{
+    const char attackerStore = m_Attacker == 0 ? 6 : 13;
+    const char defenderStore = m_Attacker == 0 ? 13 : 6;
+
+    if (state.GameState() == GAMEOVER)
+    {
+        attackerWins = state.m_Board[attackerStore] > state.m_Board[defenderStore];
+        return true;
+    }
+
+    if (state.m_Board[defenderStore] >= ClassicGeometry::MAJORITY)
+    {
+        attackerWins = false; // The attacker can get at most a draw
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Returns the proof and disproof numbers of a position.
+ *
+ * Positions that were not searched yet get the number of legal moves as their initial estimate
+ * (for the disproof number of OR nodes and the proof number of AND nodes), decided positions are
+ * resolved immediately.
+ *
+ * @param state The position to look up.
+ * @return The stored or estimated entry.
+ */
+ProofNumberSolver::ProofEntry ProofNumberSolver::Lookup(const State& state) const
+{
+    auto it = m_Table.find(Key(state));
+    if (it != m_Table.end())
+    {
+        return it->second;
+    }
+
+    bool attackerWins;
+    if (IsTerminal(state, attackerWins))
+    {
+        return attackerWins ? ProofEntry{ 0, INFINITE, 1 } : ProofEntry{ INFINITE, 0, 1 };
+    }
+
+    const unsigned int moves = (unsigned int)state.LegalMoves().size();
+    return state.m_Turn == m_Attacker ? ProofEntry{ 1, moves, 0 } : ProofEntry{ moves, 1, 0 };
+}
+
+/**
+ * @brief Returns the table key of a position as seen by the attacker.
+ *
+ * Proving a win for player 2 is the same question as proving a win for player 1 in the mirrored
+ * position, so positions are mirrored when player 2 attacks. Entries of the first search then answer
+ * lookups of the second one.
+ *
+ * @param state The position.
+ * @return The key of the position in the attacker's frame.
+ */
+unsigned long long ProofNumberSolver::Key(const State& state) const
+{
+    if (m_Attacker == 0)
+    {
+        return state.Hash();
+    }
+
+    char mirrored[14];
+    for (size_t i = 0; i < 14; ++i)
+    {
+        mirrored[i] = state.m_Board[(i + 7) % 14];
+    }
+    return State::HashBoard(mirrored, 1 - state.m_Turn, state.m_Ruleset);
+}
+
+/**
+ * @brief Stores the numbers of a position, collecting garbage when the table is full.
+ */
+void ProofNumberSolver::Save(const State& state, const ProofEntry& entry)
+{
+    m_Table[Key(state)] = entry;
+    if (m_Table.size() > m_TableLimit)
+    {
+        CollectGarbage();
+    }
+}
+
+/**
+ * @brief Discards the half of the table that took the least work to compute.
+ */
+void ProofNumberSolver::CollectGarbage()
+{
+    std::vector<unsigned long long> work;
+    work.reserve(m_Table.size());
+    for (const auto& [key, entry] : m_Table)
+    {
+        work.push_back(entry.m_Work);
+    }
+
+    std::nth_element(work.begin(), work.begin() + work.size() / 2, work.end());
+    const unsigned long long median = work[work.size() / 2];
+
+    for (auto it = m_Table.begin(); it != m_Table.end();)
+    {
+        it = it->second.m_Work <= median ? m_Table.erase(it) : std::next(it);
+    }
+}
+
+/**
+ * @brief Checks the node and time limits.
+ *
+ * @return True if the search has to stop.
+ */
+bool ProofNumberSolver::OutOfBudget()
+{
+    if (m_Aborted || m_Nodes >= m_NodeLimit)
+    {
+        return true;
+    }
+
+    if ((m_Nodes & 1023) == 0)
+    {
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+        return elapsed >= m_TimeLimit;
+    }
+    return false;
+}
+
+/**
+ * @brief Counts the positions of the proof (or disproof) tree below a solved position.
+ *
+ * Positions shared by several branches are counted once. Positions dropped by garbage collection
+ * count as a single position.
+ *
+ * @param state The solved position.
+ * @param visited Positions already counted.
+ * @return The number of positions in the tree.
+ */
+unsigned long long ProofNumberSolver::ProofSize(const State& state, std::unordered_map<unsigned long long, bool>& visited) const
+{
+    if (!visited.emplace(state.Hash(), true).second)
+    {
+        return 0;
+    }
+
+    bool attackerWins;
+    if (IsTerminal(state, attackerWins) || m_Table.find(Key(state)) == m_Table.end())
+    {
+        return 1;
+    }
+
+    const ProofEntry entry = Lookup(state);
+    const bool proven = entry.m_ProofNumber == 0;
+    const bool orNode = state.m_Turn == m_Attacker;
+
+    // A proven OR node (or disproven AND node) needs one child, the opposite needs all of them
+    unsigned long long size = 1;
+    for (char move : state.LegalMoves())
+    {
+        const State nextState = state.NextState(move);
+        const ProofEntry child = Lookup(nextState);
+        if (proven == orNode)
+        {
+            if ((proven && child.m_ProofNumber == 0) || (!proven && child.m_DisproofNumber == 0))
+            {
+                return size + ProofSize(nextState, visited);
+            }
+        }
+        else
+        {
+            size += ProofSize(nextState, visited);
+        }
+    }
+    return size;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include "state.h"
+
+/**
+ * @brief Enumerates the game-theoretic values a position can be proven to have.
+ */
+enum ProofResultEnum
+{
+	PLAYER1_WIN,
+	PLAYER2_WIN,
+	DRAW,
+	UNKNOWN // The node or time limit was reached first
+};
+
+/**
+ * @brief The outcome of solving a position.
+ */
+struct ProofResult
+{
+	ProofResultEnum m_Result = UNKNOWN;
+	char m_BestMove = -1;                // A move that keeps the proven value for the player to move, -1 if unknown
+	unsigned long long m_ProofSize = 0;  // Positions in the proof (or disproof) tree
+	unsigned long long m_Nodes = 0;      // Positions expanded by the search
+	float m_Duration = 0.0F;             // Milliseconds
+};
+
+/**
+ * @brief Solves positions with depth-first proof-number search (df-pn).
+ *
+ * A position is solved with two searches: whether player 1 can force a win, and whether player 2 can.
+ * If neither can, the position is a draw. Proof and disproof numbers are kept in a transposition table
+ * keyed in the attacker's frame, so the second search reuses the first one's mirrored positions. Its
+ * size is bounded: when it is full, the entries that took the least work to compute are discarded.
+ * Mancala positions cannot repeat (every move either fills a store or moves stones towards one), so
+ * the search graph is acyclic.
+ */
+class ProofNumberSolver
+{
+private:
+	/**
+	 * @brief Proof and disproof numbers of a searched position.
+	 */
+	struct ProofEntry
+	{
+		unsigned int m_ProofNumber;
+		unsigned int m_DisproofNumber;
+		unsigned long long m_Work; // Positions expanded below this one, decides what garbage collection keeps
+	};
+
+	std::unordered_map<unsigned long long, ProofEntry> m_Table;
+	size_t m_TableLimit;
+	unsigned long long m_NodeLimit;
+	float m_TimeLimit;
+	unsigned long long m_Nodes;
+	char m_Attacker; // The player whose win is being proven
+	bool m_Aborted;
+	std::chrono::steady_clock::time_point m_Start;
+
+	bool Solve(const State& state, const char& attacker, char& bestMove);
+	void MID(const State& state, const unsigned int& proofThreshold, const unsigned int& disproofThreshold);
+	bool IsTerminal(const State& state, bool& attackerWins) const;
+	unsigned long long Key(const State& state) const;
+	ProofEntry Lookup(const State& state) const;
+	void Save(const State& state, const ProofEntry& entry);
+	void CollectGarbage();
+	bool OutOfBudget();
+	unsigned long long ProofSize(const State& state, std::unordered_map<unsigned long long, bool>& visited) const;
+
+public:
+	static constexpr unsigned int INFINITE = 1u << 30;
+
+	ProofNumberSolver(const unsigned long long& nodeLimit = 10000000, const float& timeLimit = 10000.0F, const size_t& tableLimit = 1 << 21);
+
+	ProofResult Solve(const State& state);
+};
@@ -0,0 +1,300 @@
+#include "search-handle.h"
+#include "timer.h"
+
+#include <climits>
+#include <utility>
+
+/**
+ * @brief Queues a task on the search threads.
+ *
+ * @param task The task to run.
+ * @param priority Tasks of a higher priority run first.
+ */
+void SearchScheduler::Post(std::function<void()> task, const TaskPriorityEnum& priority)
+{
+    static TaskScheduler s_Scheduler({ (int)std::max(2u, std::thread::hardware_concurrency()), false });
+    s_Scheduler.Submit(std::move(task), priority);
+}
+
+/**
+ * @brief Replaces the search of this handle, cancelling and waiting for the one it held.
+ */
+SearchHandle& SearchHandle::operator=(SearchHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (Valid() && !Done())
+        {
+            Cancel();
+            Wait();
+        }
+        m_Shared = std::move(other.m_Shared);
+    }
+    return *this;
+}
+
+/**
+ * @brief Cancels the search if it is still running and waits for it.
+ */
+SearchHandle::~SearchHandle()
+{
+    if (Valid() && !Done())
+    {
+        Cancel();
+        Wait();
+    }
+}
+
+/**
+ * @brief Starts an iterative deepening search of a position.
+ *
+ * @param engine The engine to search with, it has to outlive the search.
+ * @param state The position to search.
+ * @param options The depths and time limit of the search.
+ * @param onIteration Called with the result of every completed depth, nullptr for none.
+ * @return The handle of the search.
+ */
+SearchHandle SearchHandle::Start(Minimax& engine, const State& state, const SearchOptions& options, SearchCallback onIteration)
+{
+    return Start(engine, std::vector<State>{ state }, options, std::move(onIteration));
+}
+
+/**
+ * @brief Starts an iterative deepening search of several positions.
+ *
+ * Every position is searched at one depth before any is searched at the next, so an interrupted
+ * search leaves all of them equally deep in the transposition table. The handle resolves to, and the
+ * callback reports, the result of the first position.
+ *
+ * @param engine The engine to search with, it has to outlive the search.
+ * @param roots The positions to search, the most important first.
+ * @param options The depths and time limit of the search.
+ * @param onIteration Called with the result of every completed depth, nullptr for none.
+ * @return The handle of the search.
+ */
+SearchHandle SearchHandle::Start(Minimax& engine, std::vector<State> roots, const SearchOptions& options, SearchCallback onIteration)
+{
+    SearchHandle handle;
+    handle.m_Shared = std::make_shared<Shared>();
+    handle.m_Shared->m_Engine = &engine;
+    handle.m_Shared->m_Future = handle.m_Shared->m_Promise.get_future().share();
+
+    SearchScheduler::Post([shared = handle.m_Shared, roots = std::move(roots), options, onIteration = std::move(onIteration)]()
+    {
+        Run(shared, roots, options, onIteration);
+    }, options.m_Priority);
+    return handle;
+}
+
+/**
+ * @brief Runs an iterative deepening search on the calling thread, with the limits of Start.
+ *
+ * For callers that already run on a thread of their own, such as the workers of a batch job. The
+ * engine must not be searching.
+ *
+ * @param engine The engine to search with.
+ * @param state The position to search.
+ * @param options The depths and limits of the search.
+ * @return The result of the deepest completed iteration, with the nodes of every iteration.
+ */
+SearchResult SearchHandle::Search(Minimax& engine, const State& state, const SearchOptions& options)
+{
+    return Deepen(engine, { &state, 1 }, options, nullptr, nullptr);
+}
+
+/**
+ * @brief Runs a search on a scheduler thread.
+ */
+void SearchHandle::Run(const std::shared_ptr<Shared>& shared, const std::vector<State>& roots, const SearchOptions& options, const SearchCallback& onIteration)
+{
+    Minimax& engine = *shared->m_Engine;
+    {
+        // A search cancelled before it started must not clear the stop request of the engine
+        std::lock_guard<std::mutex> lock(shared->m_Mutex);
+        if (!shared->m_Cancelled.load())
+        {
+            engine.Resume();
+        }
+    }
+
+    Complete(shared, Deepen(engine, roots, options, onIteration, &shared->m_Cancelled));
+}
+
+/**
+ * @brief Deepens until the last depth, a limit or a cancellation.
+ *
+ * The limits are armed on the engine from the second iteration on, so they stop a running iteration
+ * instead of only being checked between iterations. As every iteration searches more nodes than all
+ * shallower ones together, a new one is only started while less than half of a limit is used.
+ *
+ * @param engine The engine to search with.
+ * @param roots The positions to search, the result is the one of the first.
+ * @param options The depths and limits of the search.
+ * @param onIteration Called with the result of every completed depth, nullptr for none.
+ * @param cancelled Set when the search is cancelled, nullptr if it cannot be.
+ * @return The result of the deepest completed iteration, with the nodes of every iteration.
+ */
+SearchResult SearchHandle::Deepen(Minimax& engine, std::span<const State> roots, const SearchOptions& options, const SearchCallback& onIteration, const std::atomic<bool>* cancelled)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const unsigned long long startNodes = engine.Nodes();
+    const bool timed = options.m_TimeLimit > 0.0F;
+    const std::chrono::steady_clock::time_point deadline = timed
+        ? start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::milli>(options.m_TimeLimit))
+        : std::chrono::steady_clock::time_point::max();
+    const unsigned long long nodeLimit = options.m_NodeLimit > 0 ? startNodes + options.m_NodeLimit : ULLONG_MAX;
+
+    SearchResult best;
+    for (char depth = options.m_MinDepth; depth <= options.m_MaxDepth && !roots.empty() && !(cancelled && cancelled->load()); ++depth)
+    {
+        if (depth > options.m_MinDepth)
+        {
+            engine.SetLimits(deadline, nodeLimit);
+        }
+
+        SearchResult first;
+        {
+            TraceZone zone("search iteration");
+            for (size_t i = 0; i < roots.size() && !engine.IsStopped(); ++i)
+            {
+                const SearchResult result = engine.Search(roots[i], depth, options.m_Log);
+                if (i == 0)
+                {
+                    first = result;
+                }
+            }
+        }
+
+        if (engine.IsStopped() || first.m_BestMove == -1)
+        {
+            break; // The iteration was cut short, the previous one stands
+        }
+
+        best = first;
+        if (onIteration)
+        {
+            onIteration(best);
+        }
+
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if ((timed && 2.0F * elapsed >= options.m_TimeLimit) || (options.m_NodeLimit > 0 && 2 * (engine.Nodes() - startNodes) >= options.m_NodeLimit))
+        {
+            break;
+        }
+    }
+
+    // A search stopped by its limits leaves the engine ready for the next one; a cancelled one is resumed by Complete
+    engine.ClearLimits();
+    if (engine.IsStopped() && !(cancelled && cancelled->load()))
+    {
+        engine.Resume();
+    }
+
+    best.m_Nodes = engine.Nodes() - startNodes;
+    return best;
+}
+
+/**
+ * @brief Publishes the result of a search and resumes the coroutine waiting for it.
+ */
+void SearchHandle::Complete(const std::shared_ptr<Shared>& shared, const SearchResult& result)
+{
+    std::coroutine_handle<> continuation;
+    {
+        std::lock_guard<std::mutex> lock(shared->m_Mutex);
+        shared->m_Done = true;
+        if (shared->m_Cancelled.load())
+        {
+            shared->m_Engine->Resume(); // Leave the engine usable for the next search
+        }
+        continuation = std::exchange(shared->m_Continuation, nullptr);
+    }
+
+    // Set last, so whoever gets the result may start the next search on the engine right away
+    shared->m_Promise.set_value(result);
+    if (continuation)
+    {
+        continuation.resume();
+    }
+}
+
+/**
+ * @brief Tells whether the handle holds a search.
+ */
+bool SearchHandle::Valid() const
+{
+    return m_Shared != nullptr;
+}
+
+/**
+ * @brief Tells whether the search finished.
+ */
+bool SearchHandle::Done() const
+{
+    std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+    return m_Shared->m_Done;
+}
+
+/**
+ * @brief Asks the search to stop. The handle still resolves, to the deepest iteration completed.
+ */
+void SearchHandle::Cancel()
+{
+    std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+    if (!m_Shared->m_Done)
+    {
+        m_Shared->m_Cancelled.store(true);
+        m_Shared->m_Engine->Stop();
+    }
+}
+
+/**
+ * @brief Blocks until the search finished.
+ *
+ * @return The result of the deepest completed iteration.
+ */
+SearchResult SearchHandle::Wait() const
+{
+    return m_Shared->m_Future.get();
+}
+
+/**
+ * @brief Returns a future of the result, for callers that poll or combine futures.
+ */
+std::shared_future<SearchResult> SearchHandle::Future() const
+{
+    return m_Shared->m_Future;
+}
+
+/**
+ * @brief Lets co_await skip suspending when the search already finished.
+ */
+bool SearchHandle::await_ready() const
+{
+    return Done();
+}
+
+/**
+ * @brief Registers the awaiting coroutine, unless the search finished in the meantime.
+ *
+ * @param continuation The coroutine to resume on the search thread once the result is known.
+ * @return False if the coroutine continues right away, true if it stays suspended.
+ */
+bool SearchHandle::await_suspend(std::coroutine_handle<> continuation)
+{
+    std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+    if (m_Shared->m_Done)
+    {
+        return false;
+    }
+    m_Shared->m_Continuation = continuation;
+    return true;
+}
+
+/**
+ * @brief Returns the result to the resumed coroutine.
+ */
+SearchResult SearchHandle::await_resume() const
+{
+    return m_Shared->m_Future.get();
+}
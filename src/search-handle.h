@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "mancala-engine.h"
+#include "task-scheduler.h"
+
+/**
+ * @brief Limits of an asynchronous iterative deepening search.
+ */
+struct SearchOptions
+{
+	char m_MinDepth = 1;      // First depth searched
+	char m_MaxDepth = 79;     // Last depth searched
+	float m_TimeLimit = 0.0F;           // Milliseconds after which the running iteration is stopped, 0 for no limit
+	unsigned long long m_NodeLimit = 0; // Nodes after which the running iteration is stopped, 0 for no limit
+	bool m_Log = false;       // Prints the score of every root move
+	TaskPriorityEnum m_Priority = PRIORITY_NORMAL; // Background searches such as pondering run at PRIORITY_LOW
+};
+
+/**
+ * @brief Called on the search thread after every completed depth.
+ */
+using SearchCallback = std::function<void(const SearchResult&)>;
+
+/**
+ * @brief The task scheduler asynchronous searches run on.
+ *
+ * Started on first use with one thread per core (at least two, so a long pondering search never
+ * starves a second engine) and stopped when the process exits.
+ */
+class SearchScheduler
+{
+public:
+	static void Post(std::function<void()> task, const TaskPriorityEnum& priority = PRIORITY_NORMAL);
+};
+
+/**
+ * @brief A search running on the SearchScheduler.
+ *
+ * The handle resolves to the result of the deepest completed iteration. The time and node limits of
+ * the options stop the running iteration as soon as they are reached, except for the first iteration,
+ * which always completes so there is a move to return.
+ * Cancel stops the search
+ * cooperatively: the engine aborts the running iteration and the handle resolves to the iteration
+ * before it. A handle can be waited on, read as a std::shared_future, or awaited with co_await from a
+ * coroutine, which is then resumed on the search thread; this lets a host keep many searches in
+ * flight on a few threads.
+ *
+ * An engine runs one search at a time and has to outlive it. Destroying a handle whose search is still
+ * running cancels it and waits for it, so a handle must not be destroyed from its own callback.
+ */
+class SearchHandle
+{
+private:
+	/**
+	 * @brief The state the handle shares with its search thread.
+	 */
+	struct Shared
+	{
+		Minimax* m_Engine;
+		std::atomic<bool> m_Cancelled = false;
+		std::promise<SearchResult> m_Promise;
+		std::shared_future<SearchResult> m_Future;
+		std::mutex m_Mutex;                     // Orders cancellation, completion and awaiting
+		bool m_Done = false;
+		std::coroutine_handle<> m_Continuation; // Coroutine waiting for the result
+	};
+
+	std::shared_ptr<Shared> m_Shared;
+
+	static void Run(const std::shared_ptr<Shared>& shared, const std::vector<State>& roots, const SearchOptions& options, const SearchCallback& onIteration);
+	static SearchResult Deepen(Minimax& engine, std::span<const State> roots, const SearchOptions& options, const SearchCallback& onIteration, const std::atomic<bool>* cancelled);
+	static void Complete(const std::shared_ptr<Shared>& shared, const SearchResult& result);
+
+public:
+	SearchHandle() = default;
+	SearchHandle(SearchHandle&& other) noexcept = default;
+	SearchHandle& operator=(SearchHandle&& other) noexcept;
+	~SearchHandle();
+
+	static SearchHandle Start(Minimax& engine, const State& state, const SearchOptions& options = SearchOptions(), SearchCallback onIteration = nullptr);
+	static SearchHandle Start(Minimax& engine, std::vector<State> roots, const SearchOptions& options = SearchOptions(), SearchCallback onIteration = nullptr);
+	static SearchResult Search(Minimax& engine, const State& state, const SearchOptions& options = SearchOptions());
+
+	bool Valid() const;
+	bool Done() const;
+	void Cancel();
+	SearchResult Wait() const;
+	std::shared_future<SearchResult> Future() const;
+
+	bool await_ready() const;
+	bool await_suspend(std::coroutine_handle<> continuation);
+	SearchResult await_resume() const;
+};
@@ -0,0 +1,363 @@
+#include "self-play-generator.h"
+#include "search-handle.h"
+#include "timer.h"
+
+#include <filesystem>
+#include <random>
+#include <thread>
+
+/**
+ * @brief Checks the settings of a run.
+ *
+ * @param error Receives the reason when a setting is invalid.
+ * @return True if a run can start with these settings, false otherwise.
+ */
+bool SelfPlayConfig::Validate(std::string& error) const
+{
+    if (m_Games < 0)
+    {
+        error = "the number of games cannot be negative";
+    }
+    else if (m_Depth < 1)
+    {
+        error = "the search depth has to be at least 1";
+    }
+    else if (!(m_SampleRate >= 0.0F && m_SampleRate <= 1.0F))
+    {
+        error = "the sample rate has to be between 0 and 1";
+    }
+    else if (m_ShardRecords == 0)
+    {
+        error = "shards have to hold at least one record";
+    }
+    else
+    {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Constructs a generator; shards of earlier runs in the output directory are kept.
+ *
+ * @param config Settings of the run.
+ */
+SelfPlayGenerator::SelfPlayGenerator(const SelfPlayConfig& config)
+    : m_Config(config), m_Seen(std::max<size_t>(1, config.m_DedupEntries)), m_Positions(0), m_Duplicates(0), m_Records(0), m_NextShard(0), m_Finished(false)
+{
+    if (m_Config.m_Threads <= 0)
+    {
+        m_Config.m_Threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Continue numbering after the shards already in the directory
+    std::filesystem::create_directories(m_Config.m_Directory);
+    for (const auto& entry : std::filesystem::directory_iterator(m_Config.m_Directory))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("shard-", 0) == 0 && entry.path().extension() == ".bin")
+        {
+            m_NextShard = std::max(m_NextShard.load(), std::atoi(name.c_str() + 6) + 1);
+        }
+    }
+}
+
+/**
+ * @brief Plays every game of the run and waits until all records are on disk.
+ *
+ * Every game is one task of a work-stealing scheduler, so threads that drew short games take over
+ * games queued for others.
+ */
+void SelfPlayGenerator::Run()
+{
+    const int writerCount = std::max(1, m_Config.m_Threads / 8);
+    std::vector<std::thread> writers;
+    for (int i = 0; i < writerCount; ++i)
+    {
+        writers.emplace_back(&SelfPlayGenerator::WriteShards, this);
+    }
+
+    {
+        TaskScheduler scheduler({ m_Config.m_Threads, false });
+        std::vector<std::unique_ptr<WorkerContext>> contexts;
+        for (int worker = 0; worker < scheduler.Threads(); ++worker)
+        {
+            contexts.push_back(std::make_unique<WorkerContext>(worker));
+        }
+
+        for (int game = 0; game < m_Config.m_Games; ++game)
+        {
+            scheduler.Submit([this, game, &contexts]() { PlayGame(game, *contexts[TaskScheduler::WorkerIndex()]); });
+        }
+        scheduler.Wait();
+
+        for (std::unique_ptr<WorkerContext>& context : contexts)
+        {
+            if (!context->m_Batch.empty())
+            {
+                Submit(context->m_Batch);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        m_Finished = true;
+    }
+    m_QueueReady.notify_all();
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+}
+
+/**
+ * @brief Creates the search state of one worker thread.
+ *
+ * @param worker Index of the worker, mixed into its random seed.
+ */
+SelfPlayGenerator::WorkerContext::WorkerContext(const int& worker)
+    : m_Engine(std::make_shared<TranspositionTable>(16)), m_Generator(std::random_device{}() ^ (unsigned int)worker)
+{
+    m_Batch.reserve(BATCH_RECORDS);
+}
+
+/**
+ * @brief Plays one game, queueing the sampled positions once the worker's batch is full.
+ *
+ * @param game Index of the game, its parity selects the ruleset.
+ * @param context The search state of the calling worker.
+ */
+void SelfPlayGenerator::PlayGame(const int& game, WorkerContext& context)
+{
+    std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+
+    State state;
+    state.ChangeRuleset(game % 2);
+    for (int i = 0, randomMoves = 2 + context.m_Generator() % 5; i < randomMoves && state.GameState() != GAMEOVER; ++i)
+    {
+        MoveList legalMoves = state.LegalMoves();
+        state.MakeMove(legalMoves[context.m_Generator() % legalMoves.size()]);
+    }
+
+    const size_t gameStart = context.m_Batch.size();
+    while (state.GameState() != GAMEOVER)
+    {
+        SearchResult result;
+        if (m_Config.m_NodeLimit > 0)
+        {
+            // Deepen until the node budget of the move stops the search
+            SearchOptions options;
+            options.m_MaxDepth = m_Config.m_Depth;
+            options.m_NodeLimit = m_Config.m_NodeLimit;
+            result = SearchHandle::Search(context.m_Engine, state, options);
+        }
+        else
+        {
+            result = context.m_Engine.Search(state, m_Config.m_Depth);
+        }
+        m_Positions.fetch_add(1, std::memory_order_relaxed);
+
+        if (uniform(context.m_Generator) < m_Config.m_SampleRate)
+        {
+            if (MarkSeen(state.CanonicalHash()))
+            {
+                SelfPlayRecord record = {};
+                for (size_t pit = 0; pit < 14; ++pit)
+                {
+                    record.m_Board[pit] = state.m_Board[pit];
+                }
+                record.m_Turn = state.m_Turn;
+                record.m_Ruleset = state.m_Ruleset;
+                record.m_BestMove = result.m_BestMove;
+                record.m_Score = result.m_Score;
+                context.m_Batch.push_back(record);
+            }
+            else
+            {
+                m_Duplicates.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        state.MakeMove(result.m_BestMove);
+    }
+
+    const char winner = state.m_Board[6] > state.m_Board[13] ? 0 : (state.m_Board[6] < state.m_Board[13] ? 1 : 2);
+    for (size_t i = gameStart; i < context.m_Batch.size(); ++i)
+    {
+        context.m_Batch[i].m_Result = winner;
+    }
+
+    if (context.m_Batch.size() >= BATCH_RECORDS)
+    {
+        Submit(context.m_Batch);
+    }
+}
+
+/**
+ * @brief Records a canonical position key in the table of written positions.
+ *
+ * Keys are placed by linear probing over a short window. When the window is full the position is
+ * accepted without being recorded, so a full table lets duplicates through instead of growing.
+ *
+ * @param key The canonical hash of the position.
+ * @return True if the position was not written before, false for a duplicate.
+ */
+bool SelfPlayGenerator::MarkSeen(const unsigned long long& key)
+{
+    constexpr size_t PROBES = 8;
+    const unsigned long long stored = key == 0 ? 1 : key; // 0 marks an empty slot
+    for (size_t i = 0; i < PROBES; ++i)
+    {
+        std::atomic<unsigned long long>& slot = m_Seen[(stored + i) % m_Seen.size()];
+        unsigned long long current = slot.load(std::memory_order_relaxed);
+        if (current == 0 && slot.compare_exchange_strong(current, stored, std::memory_order_relaxed))
+        {
+            return true;
+        }
+        if (current == stored)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Hands a batch of finished records to the writers, waiting while they are too far behind.
+ *
+ * @param batch The records, left empty.
+ */
+void SelfPlayGenerator::Submit(std::vector<SelfPlayRecord>& batch)
+{
+    constexpr size_t MAX_QUEUED = 64;
+
+    m_Records.fetch_add(batch.size(), std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> lock(m_QueueMutex);
+        m_QueueSpace.wait(lock, [&]() { return m_Queue.size() < MAX_QUEUED; });
+        m_Queue.push_back(std::move(batch));
+    }
+    m_QueueReady.notify_one();
+
+    batch = std::vector<SelfPlayRecord>();
+    batch.reserve(BATCH_RECORDS);
+}
+
+/**
+ * @brief Writes queued batches to shard files until the run is finished and the queue is empty.
+ */
+void SelfPlayGenerator::WriteShards()
+{
+    std::ofstream file;
+    size_t shardRecords = 0;
+    while (true)
+    {
+        std::vector<SelfPlayRecord> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_QueueMutex);
+            m_QueueReady.wait(lock, [&]() { return !m_Queue.empty() || m_Finished; });
+            if (m_Queue.empty())
+            {
+                break;
+            }
+            batch = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+        m_QueueSpace.notify_one();
+
+        for (size_t offset = 0; offset < batch.size();)
+        {
+            if (!file.is_open() || shardRecords == m_Config.m_ShardRecords)
+            {
+                file.close();
+                if (!OpenShard(file))
+                {
+                    return;
+                }
+                shardRecords = 0;
+            }
+
+            const size_t count = std::min(batch.size() - offset, m_Config.m_ShardRecords - shardRecords);
+            file.write((const char*)&batch[offset], count * sizeof(SelfPlayRecord));
+            offset += count;
+            shardRecords += count;
+        }
+    }
+}
+
+/**
+ * @brief Creates the next shard file and writes its header.
+ *
+ * @param file Receives the opened shard.
+ * @return True if the shard was created, false otherwise.
+ */
+bool SelfPlayGenerator::OpenShard(std::ofstream& file)
+{
+    const std::string filename = std::format("{}/shard-{:06}.bin", m_Config.m_Directory, m_NextShard++);
+    file.open(filename, std::ios::binary);
+    if (!file)
+    {
+        std::cout << "Could not create " << filename << "\n";
+        return false;
+    }
+
+    const int recordSize = (int)sizeof(SelfPlayRecord);
+    file.write(SHARD_MAGIC, sizeof(SHARD_MAGIC));
+    file.write((const char*)&recordSize, sizeof(recordSize));
+    return true;
+}
+
+/**
+ * @brief Reads every record of a shard file.
+ *
+ * @param filename Path of the shard.
+ * @param records Receives the records.
+ * @return True if the file is a shard with the expected record size, false otherwise.
+ */
+bool SelfPlayGenerator::ReadShard(const std::string& filename, std::vector<SelfPlayRecord>& records)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4];
+    int recordSize = 0;
+    if (!file.read(magic, sizeof(magic)) || !file.read((char*)&recordSize, sizeof(recordSize)) ||
+        !std::equal(magic, magic + 4, SHARD_MAGIC) || recordSize != (int)sizeof(SelfPlayRecord))
+    {
+        return false;
+    }
+
+    SelfPlayRecord record;
+    records.clear();
+    while (file.read((char*)&record, sizeof(record)))
+    {
+        records.push_back(record);
+    }
+    return true;
+}
+
+/**
+ * @brief Runs a self-play generation and reports its throughput.
+ *
+ * @param config Settings of the run.
+ */
+void SelfPlayGenerator::Start(const SelfPlayConfig& config)
+{
+    std::string error;
+    if (!config.Validate(error))
+    {
+        std::cout << std::format("Invalid self-play settings: {}\n", error);
+        return;
+    }
+
+    SelfPlayGenerator generator(config);
+    float duration = 0.0;
+    {
+        Timer timer(&duration);
+        generator.Run();
+    }
+
+    const double hours = std::max(duration, 1.0F) / 3600000.0;
+    std::cout << std::format("self-play: {} games on {} threads in {} ms\n", generator.m_Config.m_Games, generator.m_Config.m_Threads, duration);
+    std::cout << std::format("positions searched: {} ({} per hour)\n", generator.m_Positions.load(), (unsigned long long)(generator.m_Positions.load() / hours));
+    std::cout << std::format("records written: {} ({} duplicates skipped) to {}\n", generator.m_Records.load(), generator.m_Duplicates.load(), generator.m_Config.m_Directory);
+}
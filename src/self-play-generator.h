@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mancala-engine.h"
+#include "task-scheduler.h"
+
+/**
+ * @brief One labelled position as stored in a shard file.
+ */
+struct SelfPlayRecord
+{
+	char m_Board[14];
+	char m_Turn;
+	char m_Ruleset;
+	char m_BestMove;     // Move chosen by the search
+	char m_Result;       // Final result of the game: 0 or 1 for the winning player, 2 for a draw
+	char m_Reserved[2];  // Zero, keeps the score aligned
+	float m_Score;       // Search score from player 1's point of view
+};
+
+static_assert(sizeof(SelfPlayRecord) == 24, "shard records have a fixed size");
+
+/**
+ * @brief Settings of a self-play run.
+ */
+struct SelfPlayConfig
+{
+	int m_Games = 1000;
+	int m_Threads = 0;                          // Search threads, 0 for one per core
+	char m_Depth = 4;                           // Maximum search depth
+	unsigned long long m_NodeLimit = 0;         // Per-move node budget of iterative deepening, 0 to always search m_Depth
+	float m_SampleRate = 1.0F;                  // Probability of keeping a searched position
+	size_t m_ShardRecords = 1 << 20;            // Records per shard file
+	size_t m_DedupEntries = 1 << 22;            // Slots of the table of positions already written
+	std::string m_Directory = "db/selfplay";
+
+	bool Validate(std::string& error) const;
+};
+
+/**
+ * @brief Generates labelled positions from self-play games and streams them to binary shard files.
+ *
+ * Search threads play complete games as tasks of a work-stealing scheduler, each game starting with a
+ * few random moves and alternating between the rulesets, and keep a sample of the searched positions.
+ * Once a game is over its positions get the final result and are handed to background writer threads
+ * in batches, so the search threads never wait on the disk. Positions are deduplicated within a run on their canonical key (a position and its
+ * mirror count as one) by a fixed-size lock-free table, which may let a rare duplicate through once it
+ * is full.
+ *
+ * A shard is an 8-byte header (magic "MSP1" and the record size) followed by fixed-size records.
+ */
+class SelfPlayGenerator
+{
+private:
+	static constexpr size_t BATCH_RECORDS = 4096; // Records handed to the writers at once
+
+	/**
+	 * @brief The search state a worker thread keeps across the games it plays.
+	 */
+	struct WorkerContext
+	{
+		Minimax m_Engine;
+		std::mt19937 m_Generator;
+		std::vector<SelfPlayRecord> m_Batch; // Records of finished games not yet handed to the writers
+
+		WorkerContext(const int& worker);
+	};
+
+	SelfPlayConfig m_Config;
+	std::vector<std::atomic<unsigned long long>> m_Seen; // Canonical keys of written positions, 0 is empty
+	std::atomic<unsigned long long> m_Positions;          // Positions searched
+	std::atomic<unsigned long long> m_Duplicates;
+	std::atomic<unsigned long long> m_Records;            // Records handed to the writers
+	std::atomic<int> m_NextShard;
+
+	std::mutex m_QueueMutex;
+	std::condition_variable m_QueueReady;    // Signalled when a batch is queued or the run is finished
+	std::condition_variable m_QueueSpace;    // Signalled when a writer takes a batch
+	std::deque<std::vector<SelfPlayRecord>> m_Queue;
+	bool m_Finished;
+
+	bool MarkSeen(const unsigned long long& key);
+	void PlayGame(const int& game, WorkerContext& context);
+	void Submit(std::vector<SelfPlayRecord>& batch);
+	void WriteShards();
+	bool OpenShard(std::ofstream& file);
+
+public:
+	static constexpr char SHARD_MAGIC[4] = { 'M', 'S', 'P', '1' };
+
+	SelfPlayGenerator(const SelfPlayConfig& config);
+
+	void Run();
+
+	static bool ReadShard(const std::string& filename, std::vector<SelfPlayRecord>& records);
+	static void Start(const SelfPlayConfig& config);
+};
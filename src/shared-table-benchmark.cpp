@@ -0,0 +1,175 @@
+#include "shared-table-benchmark.h"
+#include "mancala-engine.h"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Generates the positions every process searches.
+ *
+ * The positions are reached by a few random moves from the initial position, so their game trees
+ * overlap.
+ *
+ * @param count Number of positions.
+ * @return The positions, the same on every run.
+ */
+std::vector<State> SharedTableBenchmark::Positions(const int& count)
+{
+    std::mt19937 generator(2024);
+    std::vector<State> positions;
+    while ((int)positions.size() < count)
+    {
+        State state;
+        const int moves = 2 + generator() % 6;
+        for (int i = 0; i < moves && state.GameState() != GAMEOVER; ++i)
+        {
+            const MoveList legalMoves = state.LegalMoves();
+            state.MakeMove(legalMoves[generator() % legalMoves.size()]);
+        }
+
+        if (state.GameState() != GAMEOVER)
+        {
+            positions.push_back(state);
+        }
+    }
+    return positions;
+}
+
+/**
+ * @brief Searches every position once, starting at an offset into the list.
+ *
+ * @param positions The positions to search.
+ * @param offset Index of the first position to search.
+ * @param depth Depth of every search.
+ * @param shared Whether to search with the shared table.
+ * @param megabytes Size of a private table.
+ * @return The work done by this process.
+ */
+SharedTableBenchmark::Result SharedTableBenchmark::Search(const std::vector<State>& positions, const int& offset, const char& depth, const bool& shared, const size_t& megabytes)
+{
+    std::shared_ptr<TranspositionTable> table = shared ? std::make_shared<TranspositionTable>(SEGMENT_NAME, megabytes) : std::make_shared<TranspositionTable>(megabytes);
+    Minimax engine(table);
+    Result result;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        engine.Search(positions[(offset + i) % positions.size()], depth);
+    }
+    result.m_Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.m_Nodes = engine.Nodes();
+    result.m_TableHits = engine.TableHits();
+    return result;
+}
+
+/**
+ * @brief Searches the positions in several processes at once and prints the combined throughput.
+ *
+ * @param positions The positions every process searches.
+ * @param processes Number of processes.
+ * @param depth Depth of every search.
+ * @param shared Whether the processes share one table.
+ * @param megabytes Size of the shared table, and of every private one.
+ */
+void SharedTableBenchmark::Run(const std::vector<State>& positions, const int& processes, const char& depth, const bool& shared, const size_t& megabytes)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    std::unique_ptr<TranspositionTable> segment;
+    if (shared)
+    {
+        TranspositionTable::RemoveShared(SEGMENT_NAME); // Left over by an interrupted run
+        segment = std::make_unique<TranspositionTable>(SEGMENT_NAME, megabytes);
+        if (!segment->Shared())
+        {
+            std::cout << "Shared memory is not available\n";
+            return;
+        }
+    }
+
+    std::vector<int> pipes;
+    std::vector<pid_t> children;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < processes; ++i)
+    {
+        int descriptors[2];
+        if (pipe(descriptors) != 0)
+        {
+            break;
+        }
+
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            close(descriptors[0]);
+            const Result result = Search(positions, i * (int)positions.size() / processes, depth, shared, megabytes);
+            const bool written = write(descriptors[1], &result, sizeof(result)) == sizeof(result);
+            _exit(written ? 0 : 1);
+        }
+
+        close(descriptors[1]);
+        if (child < 0)
+        {
+            close(descriptors[0]);
+            break;
+        }
+        pipes.push_back(descriptors[0]);
+        children.push_back(child);
+    }
+
+    Result total;
+    double slowest = 0.0;
+    int reported = 0;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        Result result;
+        if (read(pipes[i], &result, sizeof(result)) == sizeof(result))
+        {
+            total.m_Nodes += result.m_Nodes;
+            total.m_TableHits += result.m_TableHits;
+            slowest = std::max(slowest, result.m_Seconds);
+            reported++;
+        }
+        close(pipes[i]);
+        waitpid(children[i], nullptr, 0);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (shared)
+    {
+        TranspositionTable::RemoveShared(SEGMENT_NAME);
+    }
+
+    const unsigned long long searches = (unsigned long long)reported * positions.size();
+    std::cout << std::format("{:<8}{:>10}{:>14}{:>14}{:>14}{:>10}{:>10}\n", shared ? "shared" : "private", reported, searches / std::max(seconds, 1e-9),
+        total.m_Nodes / std::max(1ULL, searches), total.m_Nodes / std::max(seconds, 1e-9), 100.0 * total.m_TableHits / std::max(1ULL, total.m_Nodes), slowest);
+#endif
+}
+
+/**
+ * @brief Runs the benchmark with private tables and then with a shared one.
+ *
+ * @param processes Number of engine processes.
+ * @param positions Number of positions every process searches.
+ * @param depth Depth of every search.
+ * @param megabytes Size of the transposition tables.
+ */
+void SharedTableBenchmark::Start(const int& processes, const int& positions, const char& depth, const size_t& megabytes)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const std::vector<State> list = Positions(positions);
+    std::cout << std::format("{} processes, {} positions each, depth {}, {} MB tables\n\n", processes, positions, (int)depth, megabytes);
+    std::cout << std::format("{:<8}{:>10}{:>14}{:>14}{:>14}{:>10}{:>10}\n", "table", "processes", "searches/s", "nodes/search", "nodes/s", "hits %", "seconds");
+    Run(list, processes, depth, false, megabytes);
+    Run(list, processes, depth, true, megabytes);
+#else
+    std::cout << "The shared table benchmark needs POSIX shared memory\n";
+#endif
+}
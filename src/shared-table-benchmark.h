@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "state.h"
+
+/**
+ * @brief Measures how engine processes searching related positions profit from one shared table.
+ *
+ * Every process searches the same list of early positions, each starting at a different offset, once
+ * with a transposition table of its own and once with a table in shared memory. Search work one
+ * process stores is found by the others, which shows up as a higher hit rate and fewer nodes per
+ * position.
+ */
+class SharedTableBenchmark
+{
+private:
+	/**
+	 * @brief What one process reports back to the parent.
+	 */
+	struct Result
+	{
+		unsigned long long m_Nodes = 0;
+		unsigned long long m_TableHits = 0;
+		double m_Seconds = 0.0;
+	};
+
+	static constexpr const char* SEGMENT_NAME = "/mancala-bench-table";
+
+	static std::vector<State> Positions(const int& count);
+	static Result Search(const std::vector<State>& positions, const int& offset, const char& depth, const bool& shared, const size_t& megabytes);
+	static void Run(const std::vector<State>& positions, const int& processes, const char& depth, const bool& shared, const size_t& megabytes);
+
+public:
+	static void Start(const int& processes = 8, const int& positions = 100, const char& depth = 9, const size_t& megabytes = 64);
+};
@@ -1,75 +1,294 @@
 #include "state-analyzer.h"
+#include "task-scheduler.h"
 #include "timer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <stdio.h>
 
 // if you are on windows change "clear" to "cls"
 #define CLEAR_COMMAND "clear"
 
-void StateAnalyzer::AnalyzeState(State*& state, const int& timeLimit)
+/**
+ * @brief Ranks the moves of a state by iterative deepening with multi-PV searches, printing every depth.
+ *
+ * Each depth reorders the root moves by the scores of the previous one. The time limit is armed on the
+ * engine from the second depth on, so a depth that would overrun it is abandoned and the last completed
+ * one stands. Deepening also stops once the best line is a proven win or loss.
+ *
+ * @param state The state to analyze.
+ * @param timeLimit Time budget in milliseconds.
+ * @param lines Number of best moves to report.
+ */
+void StateAnalyzer::AnalyzeState(State*& state, const int& timeLimit, const int& lines)
 {
-	auto engine = new Minimax();
+	Minimax engine(Minimax::SessionTable());
 	std::cout << "\nanalayzing state...\n";
-    float duration = 0.0; // Initialize duration for time limit
-    char depth = 8; // Initial depth for minimax search
-    char bestMove = -1; // Initialize best move
 
-    // Perform iterative deepening search until time limit is reached
-    while (duration < timeLimit && depth < 80)
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(timeLimit);
+
+    MultiPVResult result;
+    for (char depth = 1; depth < SearchResult::MAX_VARIATION; ++depth)
     {
-        Timer timer(&duration); // Start timer
-        engine->BestMove(*state, depth, true); // Get best move using minimax with current depth
-        depth++; // Increment depth for next iteration
+        if (depth > 1)
+        {
+            engine.SetLimits(deadline, ULLONG_MAX);
+        }
+
+        float duration = 0.0F;
+        {
+            Timer timer(&duration);
+            result = engine.SearchMultiPV(*state, depth, lines);
+        }
+
+        if (engine.IsStopped())
+        {
+            break; // The depth was cut short, the previous one stands
+        }
+
+        std::cout << "depth " << (int)result.m_Depth << " nodes " << result.m_Nodes << " time " << duration << " ms\n";
+        for (int i = 0; i < result.m_LineCount; ++i)
+        {
+            const PrincipalLine& line = result.m_Lines[i];
+            std::cout << "  " << i + 1 << ". move " << (int)line.m_Move << " score " << line.m_Score << " pv";
+            for (int j = 0; j < line.m_VariationLength; ++j)
+            {
+                std::cout << " " << (int)line.m_Variation[j];
+            }
+            std::cout << "\n";
+        }
+
+        // A deeper iteration costs more than all shallower ones together, so only start one within half the budget
+        const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (result.m_LineCount == 0 || std::abs(result.m_Lines[0].m_Score) >= Minimax::WIN_SCORE || 2.0F * elapsed >= (float)timeLimit)
+        {
+            break;
+        }
     }
 
-    // Get best move using final depth
-    std::cout << "depth: " << (int)depth << "\n";
-    engine->BestMove(*state, depth, true);
+    engine.ClearLimits();
+    engine.Resume();
+}
+
+/**
+ * @brief Proves the game-theoretic value of a state with proof-number search.
+ *
+ * @param state The state to solve.
+ * @param timeLimit Time budget in milliseconds.
+ * @param nodeLimit Maximum number of positions to expand.
+ * @return The result of the solver.
+ */
+ProofResult StateAnalyzer::SolveState(State*& state, const int& timeLimit, const unsigned long long& nodeLimit)
+{
+    std::cout << "\nsolving state...\n";
+
+    ProofNumberSolver solver(nodeLimit, (float)timeLimit);
+    const ProofResult result = solver.Solve(*state);
+
+    const char* names[] = { "player1 wins", "player2 wins", "draw", "unknown (limit reached)" };
+    std::cout << "result: " << names[result.m_Result] << "\n";
+    if (result.m_BestMove != -1)
+    {
+        std::cout << "best move: " << (int)result.m_BestMove << "\n";
+    }
+    std::cout << "proof size: " << result.m_ProofSize << "\n";
+    std::cout << "nodes: " << result.m_Nodes << "\n";
+    std::cout << "time: " << result.m_Duration << " ms\n";
+    return result;
 }
 
-void StateAnalyzer::Start(const char& ruleset)
+/**
+ * @brief Searches every position of a file and prints the results in the order of the file.
+ *
+ * Every line holds a position as accepted by ParsePosition: a board, the player to move and optionally
+ * the ruleset. Invalid lines are reported and skipped.
+ * Positions are searched as tasks of a work-stealing scheduler, so a few deep positions do not hold
+ * up the rest of the batch.
+ *
+ * @param fileName The file of positions.
+ * @param depth Depth every position is searched to.
+ * @param threads Number of search threads, 0 for one per core.
+ * @return The number of positions analyzed.
+ */
+size_t StateAnalyzer::AnalyzeBatch(const std::string& fileName, const char& depth, const int& threads)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        std::cout << "Cannot open " << fileName << "\n";
+        return 0;
+    }
+
+    std::vector<State> positions;
+    std::vector<size_t> lineNumbers;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        std::istringstream stream(line);
+        std::string boardString, turn, ruleset, error;
+        if (!(stream >> boardString))
+        {
+            continue; // Blank line
+        }
+        stream >> turn >> ruleset;
+
+        State state;
+        if (!ParsePosition(boardString, turn, ruleset, state, error))
+        {
+            std::cout << "line " << lineNumber << ": " << error << "\n";
+            continue;
+        }
+        positions.push_back(state);
+        lineNumbers.push_back(lineNumber);
+    }
+
+    std::vector<SearchResult> results(positions.size());
+    {
+        TaskScheduler scheduler({ threads, false });
+        std::vector<std::unique_ptr<Minimax>> engines;
+        for (int i = 0; i < scheduler.Threads(); ++i)
+        {
+            engines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+        }
+
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            scheduler.Submit([&, i]() { results[i] = engines[TaskScheduler::WorkerIndex()]->Search(positions[i], depth); });
+        }
+        scheduler.Wait();
+    }
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        std::cout << "line " << lineNumbers[i] << ": best move " << (int)results[i].m_BestMove << " score " << results[i].m_Score
+            << " nodes " << results[i].m_Nodes << "\n";
+    }
+    return positions.size();
+}
+
+/**
+ * @brief Parses a board written as 14 pit counts separated by '-'.
+ *
+ * @param stateString The board, for example 4-4-4-4-4-4-0-4-4-4-4-4-4-0.
+ * @param board Receives the pit counts.
+ * @return True if the string holds exactly 14 counts holding the 48 stones of a game, false otherwise.
+ */
+bool StateAnalyzer::ParseBoard(const std::string& stateString, std::vector<char>& board)
+{
+    board = {};
+    int total = 0;
+    size_t begin = 0;
+    while (board.size() < 15)
+    {
+        const size_t end = std::min(stateString.find('-', begin), stateString.size());
+        const std::string cell = stateString.substr(begin, end - begin);
+        if (cell.empty() || cell.size() > 2 || !std::all_of(cell.begin(), cell.end(), [](char c) { return std::isdigit((unsigned char)c); }))
+        {
+            return false;
+        }
+        const int stones = std::stoi(cell);
+        total += stones;
+        if (total > ClassicGeometry::TOTAL)
+        {
+            return false;
+        }
+        board.push_back((char)stones);
+
+        if (end == stateString.size())
+        {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    return board.size() == ClassicGeometry::SIZE && total == ClassicGeometry::TOTAL;
+}
+
+/**
+ * @brief Parses a position given as a board, the player to move and an optional ruleset.
+ *
+ * @param boardString The board as accepted by ParseBoard.
+ * @param turn 0 if player 1 moves, 1 if player 2 does.
+ * @param ruleset 0 for the classical ruleset, 1 for the Turkish one, empty for the classical one.
+ * @param state Receives the position.
+ * @param error Receives why the position was rejected.
+ * @return True if the position is valid and the player to move has a move, false otherwise.
+ */
+bool StateAnalyzer::ParsePosition(const std::string& boardString, const std::string& turn, const std::string& ruleset, State& state, std::string& error)
+{
+    std::vector<char> board;
+    if (!ParseBoard(boardString, board))
+    {
+        error = "wrong board representation, expected 14 pit counts holding 48 stones";
+        return false;
+    }
+    if (turn != "0" && turn != "1")
+    {
+        error = "the turn must be 0 or 1";
+        return false;
+    }
+    if (!ruleset.empty() && ruleset != "0" && ruleset != "1")
+    {
+        error = "the ruleset must be 0 or 1";
+        return false;
+    }
+
+    const int start = ClassicGeometry::Start(turn == "1" ? 1 : 0);
+    if (std::all_of(board.begin() + start, board.begin() + start + 6, [](char stones) { return stones == 0; }))
+    {
+        error = "the player to move has no stones";
+        return false;
+    }
+
+    state = State();
+    state.MutateBoard(board);
+    state.ChangeTurn(turn == "1" ? 1 : 0);
+    state.ChangeRuleset(ruleset == "1" ? 1 : 0);
+    return true;
+}
+
+void StateAnalyzer::Start(const char& ruleset, const bool& solve)
 {
     while (true)
     {
         system(CLEAR_COMMAND);
         State* state = new State();
-        state->ChangeRuleset(ruleset);
         std::cout << "Enter the board state to analyze\n\nboard > ";
         std::string stateString;
         std::cin >> stateString;
 
-        std::vector<char> board = {};
-        std::string buffer = "";
-        for (int i = 0; i < stateString.size(); i++)
-        {
-            if (stateString[i] == '-')
-            {
-                board.push_back((char)std::stoi(buffer));
-                buffer = "";
-            }
-            else {
-                buffer = buffer + stateString[i];
-            }
-        }
-        board.push_back((char)std::stoi(buffer));
+        std::string turn;
+        std::cout << "\nturn > ";
+        std::cin >> turn;
 
-        if (board.size() != 14)
+        std::string error;
+        if (!ParsePosition(stateString, turn, std::to_string(ruleset), *state, error))
         {
-            std::cout << "Wrong board representation!\n";
+            std::cout << "Invalid position: " << error << "\n";
+            system("PAUSE");
         }
         else
         {
-            std::string turn;
-            std::cout << "\nturn > ";
-            std::cin >> turn;
-
-            state->ChangeTurn((char)std::stoi(turn));
-            state->MutateBoard(board);
-
-            AnalyzeState(state, 1000);
+            if (solve)
+            {
+                SolveState(state);
+            }
+            else
+            {
+                AnalyzeState(state, 1000);
+            }
 
             system("PAUSE");
         }
+
+        delete state;
     }
 }
@@ -1,7 +1,12 @@
 #include "mancala-engine.h"
+#include "proof-number-solver.h"
 
 namespace StateAnalyzer
 {
-	void AnalyzeState(State*& state, const int& timeLimit = 1000 );
-	void Start(const char& ruleset = 1);
+	void AnalyzeState(State*& state, const int& timeLimit = 1000, const int& lines = MultiPVResult::MAX_LINES);
+	ProofResult SolveState(State*& state, const int& timeLimit = 10000, const unsigned long long& nodeLimit = 10000000);
+	size_t AnalyzeBatch(const std::string& fileName, const char& depth = 10, const int& threads = 0);
+	bool ParseBoard(const std::string& stateString, std::vector<char>& board);
+	bool ParsePosition(const std::string& boardString, const std::string& turn, const std::string& ruleset, State& state, std::string& error);
+	void Start(const char& ruleset = 1, const bool& solve = false);
 };
\ No newline at end of file
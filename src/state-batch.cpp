@@ -0,0 +1,465 @@
+#include "state-batch.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// x / 13 as (x * 5042) >> 16, exact for every count a pit can hold
+static constexpr int DIVIDE_BY_13 = 5042;
+
+/**
+ * @brief Constructs a batch of boards in the initial position of the classical ruleset.
+ *
+ * @param size The number of boards.
+ */
+StateBatch::StateBatch(const size_t& size)
+    : m_Size(size), m_Capacity((size + LANES - 1) / LANES * LANES)
+{
+    m_Pits.assign(14 * m_Capacity, 0);
+    m_Turns.assign(m_Capacity, 0);
+    m_Rulesets.assign(m_Capacity, 0);
+    m_Moves.assign(m_Capacity, -1);
+
+    const State initial;
+    for (size_t i = 0; i < m_Size; ++i)
+    {
+        Set(i, initial);
+    }
+}
+
+/**
+ * @brief Returns the number of boards in the batch.
+ *
+ * @return The number of boards.
+ */
+size_t StateBatch::Size() const
+{
+    return m_Size;
+}
+
+/**
+ * @brief Copies a position into the batch.
+ *
+ * @param index The board to overwrite.
+ * @param state The position to copy.
+ */
+void StateBatch::Set(const size_t& index, const State& state)
+{
+    for (size_t pit = 0; pit < 14; ++pit)
+    {
+        m_Pits[pit * m_Capacity + index] = state.m_Board[pit];
+    }
+    m_Turns[index] = state.m_Turn;
+    m_Rulesets[index] = state.m_Ruleset;
+}
+
+/**
+ * @brief Copies a position out of the batch.
+ *
+ * @param index The board to copy.
+ * @return The position.
+ */
+State StateBatch::Get(const size_t& index) const
+{
+    State state;
+    for (size_t pit = 0; pit < 14; ++pit)
+    {
+        state.m_Board[pit] = (char)m_Pits[pit * m_Capacity + index];
+    }
+    state.m_Turn = (char)m_Turns[index];
+    state.m_Ruleset = (char)m_Rulesets[index];
+    return state;
+}
+
+/**
+ * @brief Plays one move on every board.
+ *
+ * @param moves Size() moves, -1 (or a pit without stones) leaves the board unchanged. Moves have to be
+ * on the side of the player to move.
+ */
+void StateBatch::MakeMoves(const char* moves)
+{
+    for (size_t i = 0; i < m_Size; ++i)
+    {
+        m_Moves[i] = moves[i];
+    }
+
+#if defined(__AVX2__)
+    MakeMovesAVX2(0, m_Capacity);
+#else
+    MakeMovesScalar(0, m_Size);
+#endif
+}
+
+/**
+ * @brief Plays the moves of the boards in [begin, end) one board at a time.
+ *
+ * The stones of the moved pit are sown over the 13 pits the player uses, counted in cycle positions
+ * from the player's first pit (0-5 own pits, 6 own store, 7-12 opponent's pits). The pit at distance k
+ * from the first sown pit receives (stones + 12 - k) / 13 stones.
+ */
+void StateBatch::MakeMovesScalar(const size_t& begin, const size_t& end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const int move = m_Moves[i];
+        const int stones = move >= 0 ? m_Pits[move * m_Capacity + i] : 0;
+        if (stones == 0)
+        {
+            continue;
+        }
+
+        const int turn = m_Turns[i];
+        const bool turkish = m_Rulesets[i] == 1;
+        int board[14];
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            board[pit] = m_Pits[pit * m_Capacity + i];
+        }
+
+        // The Turkish ruleset puts the first stone back into the moved pit
+        const int start = move - 7 * turn + ((turkish && stones > 1) ? 0 : 1);
+        board[move] = 0;
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            const int cycle = turn == 0 ? pit : (pit + 7) % 14;
+            if (cycle == 13)
+            {
+                continue; // The opponent's store is skipped
+            }
+            const int distance = (cycle - start + 13) % 13;
+            board[pit] += ((stones + 12 - distance) * DIVIDE_BY_13) >> 16;
+        }
+
+        const int lastCycle = (start + stones - 1) % 13;
+        const int lastPit = turn == 0 ? lastCycle : (lastCycle + 7) % 14;
+        const int ourStore = turn == 0 ? 6 : 13;
+
+        if (lastCycle < 6 && board[lastPit] == 1 && board[12 - lastPit] != 0)
+        {
+            // The last stone landed in an empty pit of ours and captures the opposite pit
+            board[ourStore] += board[12 - lastPit] + 1;
+            board[lastPit] = 0;
+            board[12 - lastPit] = 0;
+        }
+        else if (turkish && lastCycle > 6 && board[lastPit] % 2 == 0)
+        {
+            // Turkish ruleset: making an opponent's pit even captures it
+            board[ourStore] += board[lastPit];
+            board[lastPit] = 0;
+        }
+
+        // When one side is empty the other side is swept: to its owner in the classical ruleset, to the
+        // player whose side is empty in the Turkish ruleset
+        int side0 = 0, side1 = 0;
+        for (int pit = 0; pit < 6; ++pit)
+        {
+            side0 += board[pit];
+            side1 += board[pit + 7];
+        }
+        if (side0 == 0 || side1 == 0)
+        {
+            board[6] += turkish ? side1 : side0;
+            board[13] += turkish ? side0 : side1;
+            for (int pit = 0; pit < 6; ++pit)
+            {
+                board[pit] = 0;
+                board[pit + 7] = 0;
+            }
+        }
+
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            m_Pits[pit * m_Capacity + i] = (short)board[pit];
+        }
+        m_Turns[i] = (short)(lastCycle == 6 ? turn : 1 - turn);
+    }
+}
+
+/**
+ * @brief Plays the moves of the boards in [begin, end), LANES boards at a time.
+ *
+ * The same arithmetic as MakeMovesScalar on 16-bit lanes. Lookups of the last pit and its opposite pit
+ * become masked sums over the 14 pits, and every rule is applied to all lanes and blended by mask.
+ */
+void StateBatch::MakeMovesAVX2(const size_t& begin, const size_t& end)
+{
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i six = _mm256_set1_epi16(6);
+    const __m256i seven = _mm256_set1_epi16(7);
+    const __m256i twelve = _mm256_set1_epi16(12);
+    const __m256i thirteen = _mm256_set1_epi16(13);
+    const __m256i fourteen = _mm256_set1_epi16(14);
+    const __m256i divide = _mm256_set1_epi16(DIVIDE_BY_13);
+
+    for (size_t i = begin; i < end; i += LANES)
+    {
+        __m256i board[14];
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            board[pit] = _mm256_loadu_si256((const __m256i*)&m_Pits[pit * m_Capacity + i]);
+        }
+        const __m256i move = _mm256_loadu_si256((const __m256i*)&m_Moves[i]);
+        const __m256i turn = _mm256_loadu_si256((const __m256i*)&m_Turns[i]);
+        const __m256i turkish = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)&m_Rulesets[i]), one);
+        const __m256i player2 = _mm256_cmpeq_epi16(turn, one);
+
+        // Stones of the moved pit, boards without a move (or with an empty pit) stay unchanged
+        __m256i stones = zero;
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            stones = _mm256_blendv_epi8(stones, board[pit], _mm256_cmpeq_epi16(move, _mm256_set1_epi16((short)pit)));
+        }
+        const __m256i active = _mm256_cmpgt_epi16(stones, zero);
+        if (_mm256_testz_si256(active, active))
+        {
+            continue;
+        }
+
+        // First sown cycle position, the Turkish ruleset starts at the moved pit when sowing several stones
+        const __m256i firstStoneBack = _mm256_and_si256(turkish, _mm256_cmpgt_epi16(stones, one));
+        const __m256i start = _mm256_add_epi16(_mm256_sub_epi16(move, _mm256_and_si256(player2, seven)), _mm256_andnot_si256(firstStoneBack, one));
+
+        __m256i sown[14];
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            const __m256i cycle = _mm256_blendv_epi8(_mm256_set1_epi16((short)pit), _mm256_set1_epi16((short)((pit + 7) % 14)), player2);
+            __m256i distance = _mm256_sub_epi16(cycle, start);
+            distance = _mm256_add_epi16(distance, _mm256_and_si256(_mm256_cmpgt_epi16(zero, distance), thirteen));
+            __m256i added = _mm256_mulhi_epu16(_mm256_sub_epi16(_mm256_add_epi16(stones, twelve), distance), divide);
+            added = _mm256_andnot_si256(_mm256_cmpeq_epi16(cycle, thirteen), added);
+
+            const __m256i emptied = _mm256_cmpeq_epi16(move, _mm256_set1_epi16((short)pit));
+            sown[pit] = _mm256_add_epi16(_mm256_andnot_si256(emptied, board[pit]), added);
+        }
+
+        // Last sown cycle position and pit
+        __m256i lastCycle = _mm256_sub_epi16(_mm256_add_epi16(start, stones), one);
+        lastCycle = _mm256_sub_epi16(lastCycle, _mm256_mullo_epi16(_mm256_mulhi_epu16(lastCycle, divide), thirteen));
+        __m256i lastPit = _mm256_add_epi16(lastCycle, _mm256_and_si256(player2, seven));
+        lastPit = _mm256_sub_epi16(lastPit, _mm256_and_si256(_mm256_cmpgt_epi16(lastPit, _mm256_set1_epi16(13)), fourteen));
+        const __m256i oppositePit = _mm256_sub_epi16(twelve, lastPit);
+
+        __m256i lastStones = zero, oppositeStones = zero;
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            const __m256i index = _mm256_set1_epi16((short)pit);
+            lastStones = _mm256_add_epi16(lastStones, _mm256_and_si256(_mm256_cmpeq_epi16(lastPit, index), sown[pit]));
+            oppositeStones = _mm256_add_epi16(oppositeStones, _mm256_and_si256(_mm256_cmpeq_epi16(oppositePit, index), sown[pit]));
+        }
+
+        // Capture of the opposite pit, and the Turkish capture of an even opponent's pit
+        const __m256i ownPit = _mm256_cmpgt_epi16(six, lastCycle);
+        const __m256i capture = _mm256_and_si256(ownPit, _mm256_andnot_si256(_mm256_cmpeq_epi16(oppositeStones, zero), _mm256_cmpeq_epi16(lastStones, one)));
+        const __m256i evenCapture = _mm256_and_si256(_mm256_and_si256(turkish, _mm256_cmpgt_epi16(lastCycle, six)),
+            _mm256_andnot_si256(_mm256_cmpeq_epi16(lastStones, zero), _mm256_cmpeq_epi16(_mm256_and_si256(lastStones, one), zero)));
+        const __m256i gain = _mm256_add_epi16(_mm256_and_si256(capture, _mm256_add_epi16(oppositeStones, one)), _mm256_and_si256(evenCapture, lastStones));
+        const __m256i clearLast = _mm256_or_si256(capture, evenCapture);
+
+        __m256i side0 = zero, side1 = zero;
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            const __m256i index = _mm256_set1_epi16((short)pit);
+            const __m256i cleared = _mm256_or_si256(_mm256_and_si256(clearLast, _mm256_cmpeq_epi16(lastPit, index)),
+                _mm256_and_si256(capture, _mm256_cmpeq_epi16(oppositePit, index)));
+            sown[pit] = _mm256_andnot_si256(cleared, sown[pit]);
+            if (pit < 6)
+            {
+                side0 = _mm256_add_epi16(side0, sown[pit]);
+            }
+            else if (pit > 6 && pit < 13)
+            {
+                side1 = _mm256_add_epi16(side1, sown[pit]);
+            }
+        }
+        sown[6] = _mm256_add_epi16(sown[6], _mm256_andnot_si256(player2, gain));
+        sown[13] = _mm256_add_epi16(sown[13], _mm256_and_si256(player2, gain));
+
+        // Sweep of the remaining side
+        const __m256i sweep = _mm256_or_si256(_mm256_cmpeq_epi16(side0, zero), _mm256_cmpeq_epi16(side1, zero));
+        sown[6] = _mm256_add_epi16(sown[6], _mm256_and_si256(sweep, _mm256_blendv_epi8(side0, side1, turkish)));
+        sown[13] = _mm256_add_epi16(sown[13], _mm256_and_si256(sweep, _mm256_blendv_epi8(side1, side0, turkish)));
+
+        for (int pit = 0; pit < 14; ++pit)
+        {
+            if (pit != 6 && pit != 13)
+            {
+                sown[pit] = _mm256_andnot_si256(sweep, sown[pit]);
+            }
+            board[pit] = _mm256_blendv_epi8(board[pit], sown[pit], active);
+            _mm256_storeu_si256((__m256i*)&m_Pits[pit * m_Capacity + i], board[pit]);
+        }
+
+        const __m256i nextTurn = _mm256_blendv_epi8(_mm256_sub_epi16(one, turn), turn, _mm256_cmpeq_epi16(lastCycle, six));
+        _mm256_storeu_si256((__m256i*)&m_Turns[i], _mm256_blendv_epi8(turn, nextTurn, active));
+    }
+#else
+    MakeMovesScalar(begin, end);
+#endif
+}
+
+/**
+ * @brief Computes the legal moves of every board.
+ *
+ * @param masks Receives Size() masks, bit i is set when the player to move can play their i-th pit
+ * (pit i for player 1, pit i + 7 for player 2).
+ */
+void StateBatch::LegalMoveMasks(unsigned char* masks) const
+{
+    for (size_t i = 0; i < m_Size; ++i)
+    {
+        const size_t first = m_Turns[i] == 0 ? 0 : 7;
+        unsigned char mask = 0;
+        for (size_t pit = 0; pit < 6; ++pit)
+        {
+            mask |= (unsigned char)((m_Pits[(first + pit) * m_Capacity + i] > 0) << pit);
+        }
+        masks[i] = mask;
+    }
+}
+
+/**
+ * @brief Checks which boards are finished, like State::GameState.
+ *
+ * @param flags Receives Size() flags, true for finished games.
+ */
+void StateBatch::GameOverFlags(bool* flags) const
+{
+    const short* store1 = &m_Pits[6 * m_Capacity];
+    const short* store2 = &m_Pits[13 * m_Capacity];
+    for (size_t i = 0; i < m_Size; ++i)
+    {
+        flags[i] = store1[i] + store2[i] == ClassicGeometry::TOTAL || store1[i] > ClassicGeometry::MAJORITY || store2[i] > ClassicGeometry::MAJORITY;
+    }
+}
+
+/**
+ * @brief Determines the winner of every board, like State::GetWinner.
+ *
+ * @param winners Receives Size() values: 0 or 1 for the winning player, 2 if there is no winner yet.
+ */
+void StateBatch::Winners(char* winners) const
+{
+    const short* store1 = &m_Pits[6 * m_Capacity];
+    const short* store2 = &m_Pits[13 * m_Capacity];
+    for (size_t i = 0; i < m_Size; ++i)
+    {
+        winners[i] = store1[i] > ClassicGeometry::MAJORITY ? 0 : (store2[i] > ClassicGeometry::MAJORITY ? 1 : 2);
+    }
+}
+
+/**
+ * @brief Measures random playouts on a batch against the same playouts with State::MakeMove.
+ *
+ * Every round plays one random legal move on each unfinished board; finished boards are restarted.
+ * Prints both throughputs in positions per second and whether the two engines ended on the same boards.
+ *
+ * @param boards The number of boards.
+ * @param rounds The number of moves played on each board.
+ */
+void StateBatch::Benchmark(const size_t& boards, const int& rounds)
+{
+    std::mt19937 generator(12345);
+    std::vector<State> states(boards);
+    StateBatch batch(boards);
+    for (size_t i = 0; i < boards; ++i)
+    {
+        states[i].ChangeRuleset((char)(i % 2));
+        batch.Set(i, states[i]);
+    }
+
+    // Draw the moves up front so both engines play the same games and only move generation is timed
+    std::vector<std::vector<char>> moves(rounds, std::vector<char>(boards));
+    {
+        StateBatch planner = batch;
+        std::vector<unsigned char> masks(boards);
+        std::unique_ptr<bool[]> gameOver(new bool[boards]);
+        for (int round = 0; round < rounds; ++round)
+        {
+            planner.GameOverFlags(gameOver.get());
+            for (size_t i = 0; i < boards; ++i)
+            {
+                if (gameOver[i])
+                {
+                    State initial;
+                    initial.ChangeRuleset((char)(i % 2));
+                    planner.Set(i, initial);
+                }
+            }
+            planner.LegalMoveMasks(masks.data());
+            for (size_t i = 0; i < boards; ++i)
+            {
+                char legal[6];
+                int count = 0;
+                for (int pit = 0; pit < 6; ++pit)
+                {
+                    if (masks[i] & (1 << pit))
+                    {
+                        legal[count++] = (char)(pit + (planner.m_Turns[i] == 0 ? 0 : 7));
+                    }
+                }
+                moves[round][i] = count > 0 ? legal[generator() % count] : -1;
+            }
+            planner.MakeMoves(moves[round].data());
+        }
+    }
+
+    std::unique_ptr<bool[]> gameOver(new bool[boards]);
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        batch.GameOverFlags(gameOver.get());
+        for (size_t i = 0; i < boards; ++i)
+        {
+            if (gameOver[i])
+            {
+                State initial;
+                initial.ChangeRuleset((char)(i % 2));
+                batch.Set(i, initial);
+            }
+        }
+        batch.MakeMoves(moves[round].data());
+    }
+    const float batchSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (size_t i = 0; i < boards; ++i)
+        {
+            if (states[i].GameState() == GAMEOVER)
+            {
+                states[i] = State();
+                states[i].ChangeRuleset((char)(i % 2));
+            }
+            if (moves[round][i] >= 0)
+            {
+                states[i].MakeMove(moves[round][i]);
+            }
+        }
+    }
+    const float stateSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < boards; ++i)
+    {
+        const State state = batch.Get(i);
+        mismatches += state.m_Board != states[i].m_Board || state.m_Turn != states[i].m_Turn ? 1 : 0;
+    }
+
+    const double positions = (double)boards * rounds;
+#if defined(__AVX2__)
+    std::cout << "StateBatch (AVX2):   ";
+#else
+    std::cout << "StateBatch (scalar): ";
+#endif
+    std::cout << (unsigned long long)(positions / batchSeconds) << " positions/s\n";
+    std::cout << "State::MakeMove:     " << (unsigned long long)(positions / stateSeconds) << " positions/s\n";
+    std::cout << "Mismatching boards:  " << mismatches << " of " << boards << "\n";
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "state.h"
+
+/**
+ * @brief Holds many independent positions in structure-of-arrays layout and plays one move on each.
+ *
+ * Pit i of every board is stored contiguously, so the boards of a block can be processed together.
+ * Sowing is computed from the distance of each pit to the first sown pit instead of dropping stones
+ * one by one, which lets one kernel move every board of a block regardless of its move, turn and
+ * ruleset. Built with AVX2, 16 boards are moved per step; otherwise the same arithmetic runs board by
+ * board. The results match State::MakeMove for both rulesets.
+ */
+class StateBatch
+{
+private:
+	static constexpr size_t LANES = 16; // Boards moved together by the AVX2 kernel
+
+	size_t m_Size;
+	size_t m_Capacity;           // m_Size rounded up to a multiple of LANES
+	std::vector<short> m_Pits;   // 14 x m_Capacity, pit-major
+	std::vector<short> m_Turns;
+	std::vector<short> m_Rulesets;
+	std::vector<short> m_Moves;  // Moves of the current call, -1 for boards that do not move
+
+	void MakeMovesScalar(const size_t& begin, const size_t& end);
+	void MakeMovesAVX2(const size_t& begin, const size_t& end);
+
+public:
+	StateBatch(const size_t& size);
+
+	size_t Size() const;
+	void Set(const size_t& index, const State& state);
+	State Get(const size_t& index) const;
+
+	void MakeMoves(const char* moves);
+	void LegalMoveMasks(unsigned char* masks) const;
+	void GameOverFlags(bool* flags) const;
+	void Winners(char* winners) const;
+
+	static void Benchmark(const size_t& boards, const int& rounds);
+};
@@ -33,8 +33,7 @@ void State::MutateBoard(const std::vector<char> &board)
  */
 void State::InitializeState()
 {
-    m_Board.resize(14); // Resize the board vector to 14 elements
-    srand(time(0));     // Seed the random number generator
+    srand(time(0)); // Seed the random number generator
     for (size_t i = 0; i < 14; ++i)
     {
         // Initialize each slot in the board
@@ -103,7 +102,7 @@ char State::TotalStones(const char &start, const char &stop) const
     char total = 0; // Initialize total stones counter
 
     // Iterate through pits within the specified range and sum up the number of stones
-    for (size_t i = start; i < stop; ++i)
+    for (int i = start; i < stop; ++i)
     {
         total += m_Board[i]; // Add stones from each pit to the total
     }
@@ -118,17 +117,17 @@ char State::TotalStones(const char &start, const char &stop) const
  */
 char State::OppositePit(const char &pit)
 {
-    return (12 - pit); // Calculate the index of the opposite pit
+    return (char)ClassicGeometry::Opposite(pit); // Calculate the index of the opposite pit
 };
 
 /**
  * @brief Finds the legal moves for the current player.
  *
- * @return A vector containing the indices of legal moves.
+ * @return The indices of the pits the player to move can play.
  */
-std::vector<char> State::LegalMoves() const
+MoveList State::LegalMoves() const
 {
-    std::vector<char> legalMoves; // Initialize vector to store legal moves
+    MoveList legalMoves; // Initialize the list of legal moves
 
     // Determine the range of pits to consider based on the current player's turn
     size_t start = m_Turn == 0 ? 0 : 7; // Start index for player 1 or player 2
@@ -139,11 +138,11 @@ std::vector<char> State::LegalMoves() const
     {
         if (m_Board[i] > 0)
         {
-            legalMoves.push_back((char)i); // Add index of pit with stones to legal moves
+            legalMoves.m_Moves[legalMoves.m_Count++] = (char)i; // Add index of pit with stones to legal moves
         }
     }
 
-    return legalMoves; // Return vector of legal moves
+    return legalMoves; // Return the list of legal moves
 }
 
 std::string State::GetStateString(int depth) const
@@ -158,6 +157,116 @@ std::string State::GetStateString(int depth) const
     return state_str;
 }
 
+/**
+ * @brief Computes a 64-bit hash of the position.
+ *
+ * The hash covers the board, the player to move and the ruleset, so positions from different
+ * rulesets never share transposition table entries.
+ *
+ * @return The hash of the position.
+ */
+unsigned long long State::Hash() const
+{
+    return HashBoard(m_Board.data(), m_Turn, m_Ruleset);
+}
+
+/**
+ * @brief Computes the hash of the position as seen by the player to move.
+ *
+ * The rules are symmetric: swapping both sides and the turn gives an equivalent position whose score
+ * is negated. Hashing the position with the player to move on the first side gives both equivalent
+ * positions the same key.
+ *
+ * @return The hash of the canonical form of the position.
+ */
+unsigned long long State::CanonicalHash() const
+{
+    if (m_Turn == 0)
+    {
+        return Hash();
+    }
+
+    char mirrored[14];
+    for (size_t i = 0; i < 14; ++i)
+    {
+        mirrored[i] = m_Board[(i + 7) % 14];
+    }
+    return HashBoard(mirrored, 0, m_Ruleset);
+}
+
+/**
+ * @brief Returns the equivalent position with both sides and the turn swapped.
+ *
+ * @return The mirrored position.
+ */
+State State::Mirror() const
+{
+    State state = *this;
+    for (size_t i = 0; i < 14; ++i)
+    {
+        state.m_Board[i] = m_Board[(i + 7) % 14];
+    }
+    state.m_Turn = 1 - m_Turn;
+    return state;
+}
+
+/**
+ * @brief Returns the position with the player to move on the first side.
+ *
+ * @return The canonical form of the position.
+ */
+State State::Canonical() const
+{
+    return m_Turn == 0 ? *this : Mirror();
+}
+
+/**
+ * @brief Returns the move on the mirrored board that corresponds to a move on this board.
+ *
+ * @param move The index of a pit.
+ * @return The index of the opposite player's corresponding pit, -1 stays -1.
+ */
+char State::MirrorMove(const char& move)
+{
+    return move < 0 ? move : (char)((move + 7) % 14);
+}
+
+/**
+ * @brief Hashes a board, a player to move and a ruleset.
+ *
+ * @param board The 14 pit counts.
+ * @param turn The player to move.
+ * @param ruleset The ruleset.
+ * @return The hash.
+ */
+unsigned long long State::HashBoard(const char* board, const char& turn, const char& ruleset)
+{
+    unsigned long long low = 0;  // Pits 0-7
+    unsigned long long high = 0; // Pits 8-13, turn and ruleset
+    for (size_t i = 0; i < 8; ++i)
+    {
+        low |= (unsigned long long)(unsigned char)board[i] << (8 * i);
+    }
+    for (size_t i = 8; i < 14; ++i)
+    {
+        high |= (unsigned long long)(unsigned char)board[i] << (8 * (i - 8));
+    }
+    high |= (unsigned long long)(unsigned char)turn << 48;
+    high |= (unsigned long long)(unsigned char)ruleset << 56;
+
+    // splitmix64 finalizer applied to both halves
+    auto mix = [](unsigned long long x)
+    {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    };
+    return mix(low ^ mix(high + 0x9E3779B97F4A7C15ULL));
+}
+
 /**
  * @brief Checks if a move is legal.
  *
@@ -185,9 +294,9 @@ bool State::IsLegal(const char &move)
  */
 char State::RandomMove()
 {
-    const std::vector<char> legalMoves = LegalMoves();           // Get the list of legal moves
-    const char move = legalMoves.at(rand() % legalMoves.size()); // Choose a random move from the legal moves
-    return move;                                                 // Return the randomly selected move
+    const MoveList legalMoves = LegalMoves();                 // Get the list of legal moves
+    const char move = legalMoves[rand() % legalMoves.size()]; // Choose a random move from the legal moves
+    return move;                                              // Return the randomly selected move
 }
 
 /**
@@ -401,12 +510,9 @@ void State::ChangeRuleset(const char &ruleset)
  */
 State State::NextState(const char &move) const
 {
-    State *state = new State(); // Create a new state object
-    state->m_Turn = m_Turn;     // Set the turn of the new state
-    state->m_Board = m_Board;   // Copy the board of the current state
-    state->m_Ruleset = m_Ruleset;
-    state->MakeMove(move); // Make the specified move in the new state
-    return *state;         // Return the new state
+    State state = *this;  // Copy the current state
+    state.MakeMove(move); // Make the specified move in the new state
+    return state;         // Return the new state
 }
 
 /**
@@ -416,7 +522,9 @@ State State::NextState(const char &move) const
  */
 GameStateEnum State::GameState() const
 {
-    if (m_Board[6] + m_Board[13] == 48 || m_Board[6] > 24 || m_Board[13] > 24) // Check if game is over
+    constexpr int total = ClassicGeometry::TOTAL;
+    constexpr int majority = ClassicGeometry::MAJORITY;
+    if (m_Board[6] + m_Board[13] == total || m_Board[6] > majority || m_Board[13] > majority) // Check if game is over
     {
         return GAMEOVER; // Return GAMEOVER if game conditions are met
     }
@@ -433,11 +541,11 @@ GameStateEnum State::GameState() const
  */
 char State::GetWinner() const
 {
-    if (m_Board[6] > 24) // If player 1's store has more than 24 stones
+    if (m_Board[6] > ClassicGeometry::MAJORITY) // If player 1's store has more than 24 stones
     {
         return 0; // Player 1 wins
     }
-    else if (m_Board[13] > 24) // If player 2's store has more than 24 stones
+    else if (m_Board[13] > ClassicGeometry::MAJORITY) // If player 2's store has more than 24 stones
     {
         return 1; // Player 2 wins
     }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <ctime>
 #include <format>
 #include <iostream>
@@ -17,6 +19,72 @@ enum GameStateEnum
 	GAMEOVER
 };
 
+/**
+ * @brief The layout of a Kalah(PITS, SEEDS) board, known at compile time.
+ *
+ * Player 1's pits are 0 to PITS - 1 followed by their store, player 2's pits and store follow in the
+ * same order. Every index and threshold is a constant, so code written against a geometry compiles to
+ * the same instructions as code with the numbers written out.
+ */
+template <int PITS, int SEEDS>
+struct BoardGeometry
+{
+	static_assert(PITS >= 1 && PITS <= 16, "Kalah boards have between 1 and 16 pits per side");
+	static_assert(SEEDS >= 1 && 2 * PITS * SEEDS <= 127, "Pit counts are stored in a char");
+
+	static constexpr int SIZE = 2 * PITS + 2;       // Pits and stores
+	static constexpr int TOTAL = 2 * PITS * SEEDS;  // Stones in play
+	static constexpr int MAJORITY = TOTAL / 2;      // A store holding more than this has won
+
+	static constexpr int Store(const int& player) { return player == 0 ? PITS : 2 * PITS + 1; }
+	static constexpr int Start(const int& player) { return player == 0 ? 0 : PITS + 1; }
+	static constexpr int Opposite(const int& pit) { return 2 * PITS - pit; }
+};
+
+using ClassicGeometry = BoardGeometry<6, 4>; // The board State plays on
+
+/**
+ * @brief The legal moves of a position.
+ *
+ * A player never has more moves than pits on their side, so the list is stored inline and generating
+ * moves does not allocate.
+ */
+template <int CAPACITY>
+struct BasicMoveList
+{
+	char m_Moves[CAPACITY];
+	int m_Count = 0;
+
+	char* begin() { return m_Moves; }
+	char* end() { return m_Moves + m_Count; }
+	const char* begin() const { return m_Moves; }
+	const char* end() const { return m_Moves + m_Count; }
+	size_t size() const { return (size_t)m_Count; }
+	bool empty() const { return m_Count == 0; }
+	char operator[](const size_t& index) const { return m_Moves[index]; }
+
+	// Moves a move to the front, keeping the order of the others; bounded by CAPACITY so the compiler
+	// can see that the shifts stay inside the list
+	void MoveToFront(const char& move)
+	{
+		const int count = std::min(m_Count, CAPACITY);
+		for (int i = 0; i < count; ++i)
+		{
+			if (m_Moves[i] == move)
+			{
+				for (int j = i; j > 0; --j)
+				{
+					m_Moves[j] = m_Moves[j - 1];
+				}
+				m_Moves[0] = move;
+				return;
+			}
+		}
+	}
+};
+
+using MoveList = BasicMoveList<6>;
+
 /**
  * @brief Represents the state of the game.
  *
@@ -28,9 +96,24 @@ class State
 	friend class Minimax;
 	friend class Game;
 	friend class OpeningsBookGenerator;
+	friend class EvaluationTuner;
+	friend class NetworkEvaluator;
+	friend class NetworkTrainer;
+	friend class ProofNumberSolver;
+	friend class TranspositionTable;
+	friend class PositionIndex;
+	friend class StateBatch;
+	friend class SelfPlayGenerator;
+	friend class AllocationTracker;
+	friend class EngineServer;
+	friend class SharedTableBenchmark;
+	friend class TaskBenchmark;
+	friend class MancalaApi;
+	friend class GameAnnotator;
+	friend class LoadTest;
 
 private:
-	std::vector<char> m_Board;
+	std::array<char, ClassicGeometry::SIZE> m_Board;
 	char m_Ruleset;
 	char m_Turn;
 
@@ -41,8 +124,14 @@ private:
 	void ClassicalMancalaRuleset(const char &move);
 	void TurkishMancalaRuleset(const char &move);
 
-	std::vector<char> LegalMoves() const;
+	MoveList LegalMoves() const;
 	std::string GetStateString(int depth) const;
+	unsigned long long Hash() const;
+	unsigned long long CanonicalHash() const;
+	State Mirror() const;
+	State Canonical() const;
+	static char MirrorMove(const char &move);
+	static unsigned long long HashBoard(const char *board, const char &turn, const char &ruleset);
 	State NextState(const char &move) const;
 	char TotalStones(const char &start, const char &stop) const;
 	char OppositePit(const char &pit);
@@ -0,0 +1,142 @@
+#include "task-benchmark.h"
+#include "mancala-engine.h"
+#include "task-scheduler.h"
+
+#include <chrono>
+#include <format>
+#include <memory>
+#include <random>
+#include <thread>
+
+/**
+ * @brief Generates the jobs of the benchmark, the same on every run.
+ *
+ * Depths are drawn so that shallow jobs are common and deep ones rare.
+ *
+ * @param count Number of jobs.
+ * @return The jobs.
+ */
+std::vector<TaskBenchmark::Job> TaskBenchmark::Jobs(const int& count)
+{
+    std::mt19937 generator(4242);
+    std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+    std::vector<Job> jobs;
+    while ((int)jobs.size() < count)
+    {
+        State state;
+        state.ChangeRuleset(jobs.size() % 2);
+        const int moves = 2 + generator() % 8;
+        for (int i = 0; i < moves && state.GameState() != GAMEOVER; ++i)
+        {
+            const MoveList legalMoves = state.LegalMoves();
+            state.MakeMove(legalMoves[generator() % legalMoves.size()]);
+        }
+
+        if (state.GameState() != GAMEOVER)
+        {
+            const float u = uniform(generator);
+            jobs.push_back({ state, (char)(1 + (int)(10.0F * u * u * u)) });
+        }
+    }
+    return jobs;
+}
+
+/**
+ * @brief Runs every job as a task of a work-stealing scheduler.
+ *
+ * @param jobs The jobs.
+ * @param threads Number of worker threads.
+ * @param steals Receives the number of tasks run by another worker than the one they were queued on.
+ * @return The time taken in seconds.
+ */
+double TaskBenchmark::RunScheduler(const std::vector<Job>& jobs, const int& threads, unsigned long long& steals)
+{
+    TaskScheduler scheduler({ threads, false });
+    std::vector<std::unique_ptr<Minimax>> engines;
+    for (int i = 0; i < threads; ++i)
+    {
+        engines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const Job& job : jobs)
+    {
+        scheduler.Submit([&engines, &job]() { engines[TaskScheduler::WorkerIndex()]->Search(job.m_State, job.m_Depth); });
+    }
+    scheduler.Wait();
+    steals = scheduler.Steals();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Runs the jobs split into one contiguous chunk per thread.
+ *
+ * @param jobs The jobs.
+ * @param threads Number of threads.
+ * @return The time taken in seconds.
+ */
+double TaskBenchmark::RunStatic(const std::vector<Job>& jobs, const int& threads)
+{
+    std::vector<std::unique_ptr<Minimax>> engines;
+    for (int i = 0; i < threads; ++i)
+    {
+        engines.push_back(std::make_unique<Minimax>(std::make_shared<TranspositionTable>(16)));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    const size_t chunk = (jobs.size() + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+            {
+                for (size_t i = t * chunk; i < std::min(jobs.size(), (t + 1) * chunk); ++i)
+                {
+                    engines[t]->Search(jobs[i].m_State, jobs[i].m_Depth);
+                }
+            });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Runs the benchmark with a doubling number of threads and prints the speedups.
+ *
+ * @param jobs Number of search jobs.
+ * @param maxThreads Largest number of threads, 0 for one per core.
+ */
+void TaskBenchmark::Start(const int& jobs, const int& maxThreads)
+{
+    const int limit = maxThreads > 0 ? maxThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<Job> list = Jobs(jobs);
+
+    std::vector<int> counts;
+    for (int threads = 1; threads < limit; threads *= 2)
+    {
+        counts.push_back(threads);
+    }
+    counts.push_back(limit);
+
+    std::cout << std::format("{} search jobs of depth 1 to 10, up to {} threads\n\n", list.size(), limit);
+    std::cout << std::format("{:>8}{:>12}{:>10}{:>12}{:>10}{:>12}{:>10}\n", "threads", "stealing s", "speedup", "efficiency", "steals", "static s", "speedup");
+
+    double stealingBase = 0.0, staticBase = 0.0;
+    for (const int threads : counts)
+    {
+        unsigned long long steals = 0;
+        const double stealing = RunScheduler(list, threads, steals);
+        const double chunked = RunStatic(list, threads);
+        if (threads == 1)
+        {
+            stealingBase = stealing;
+            staticBase = chunked;
+        }
+
+        std::cout << std::format("{:>8}{:>12.3f}{:>10.2f}{:>11.0f}%{:>10}{:>12.3f}{:>10.2f}\n", threads, stealing, stealingBase / stealing,
+            100.0 * stealingBase / stealing / threads, steals, chunked, staticBase / chunked) << std::flush;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "state.h"
+
+/**
+ * @brief Measures how the task scheduler scales on search jobs of very different sizes.
+ *
+ * A fixed list of jobs, each searching an early position to a depth between 1 and 10, is run with 1, 2,
+ * 4, ... threads, once on a TaskScheduler and once split into one contiguous chunk per thread as the
+ * batch tools used to do. Most jobs take microseconds and a few take seconds, so the static split
+ * leaves threads idle while work stealing keeps them busy.
+ */
+class TaskBenchmark
+{
+private:
+	/**
+	 * @brief One search job.
+	 */
+	struct Job
+	{
+		State m_State;
+		char m_Depth;
+	};
+
+	static std::vector<Job> Jobs(const int& count);
+	static double RunScheduler(const std::vector<Job>& jobs, const int& threads, unsigned long long& steals);
+	static double RunStatic(const std::vector<Job>& jobs, const int& threads);
+
+public:
+	static void Start(const int& jobs = 500, const int& maxThreads = 0);
+};
@@ -0,0 +1,222 @@
+#include "task-scheduler.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local const TaskScheduler* t_Scheduler = nullptr; // Pool the calling thread works for
+static thread_local int t_Worker = -1;                           // Index of the calling thread in that pool
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param config Number of threads and whether to pin them to cores.
+ */
+TaskScheduler::TaskScheduler(const TaskSchedulerConfig& config)
+    : m_Queued(0), m_Pending(0), m_Sleeping(0), m_NextWorker(0), m_Steals(0), m_Stop(false)
+{
+    const int threads = config.m_Threads > 0 ? config.m_Threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threads; ++i)
+    {
+        m_Workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Every worker exists before any thread starts stealing
+    for (int i = 0; i < threads; ++i)
+    {
+        m_Workers[i]->m_Thread = std::thread(&TaskScheduler::WorkerLoop, this, i, config.m_PinThreads);
+    }
+}
+
+/**
+ * @brief Finishes every submitted task and stops the workers.
+ */
+TaskScheduler::~TaskScheduler()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Stop.store(true);
+    }
+    m_Wake.notify_all();
+    for (std::unique_ptr<Worker>& worker : m_Workers)
+    {
+        worker->m_Thread.join();
+    }
+}
+
+/**
+ * @brief Runs and steals tasks until the pool stops.
+ *
+ * @param index Index of the worker.
+ * @param pin Whether to bind the thread to the core with the same index.
+ */
+void TaskScheduler::WorkerLoop(const int& index, const bool& pin)
+{
+    t_Scheduler = this;
+    t_Worker = index;
+
+#if defined(__linux__)
+    if (pin)
+    {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+    }
+#endif
+
+    while (true)
+    {
+        if (TryRun(index))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_SleepMutex);
+        m_Sleeping++;
+        m_Wake.wait(lock, [this]() { return m_Queued.load() > 0 || m_Stop.load(); });
+        m_Sleeping--;
+        if (m_Stop.load() && m_Queued.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Runs one task of the worker's own deques or, failing that, one stolen from another worker.
+ *
+ * @param index Index of the worker.
+ * @return True if a task was run, false if every deque was empty.
+ */
+bool TaskScheduler::TryRun(const int& index)
+{
+    std::function<void()> task;
+    if (!Pop(index, task) && !Steal(index, task))
+    {
+        return false;
+    }
+
+    task();
+
+    if (--m_Pending == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Idle.notify_all();
+    }
+    return true;
+}
+
+/**
+ * @brief Takes the newest task of the highest priority from the worker's own deques.
+ */
+bool TaskScheduler::Pop(const int& index, std::function<void()>& task)
+{
+    Worker& worker = *m_Workers[index];
+    std::lock_guard<std::mutex> lock(worker.m_Mutex);
+    for (std::deque<std::function<void()>>& queue : worker.m_Queues)
+    {
+        if (!queue.empty())
+        {
+            task = std::move(queue.back());
+            queue.pop_back();
+            m_Queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Takes the oldest task of the highest priority any other worker has queued.
+ *
+ * Victims are visited starting after the thief, so thieves spread over the pool.
+ */
+bool TaskScheduler::Steal(const int& index, std::function<void()>& task)
+{
+    const int workers = (int)m_Workers.size();
+    for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    {
+        for (int offset = 1; offset < workers; ++offset)
+        {
+            Worker& victim = *m_Workers[(index + offset) % workers];
+            std::lock_guard<std::mutex> lock(victim.m_Mutex);
+            std::deque<std::function<void()>>& queue = victim.m_Queues[priority];
+            if (!queue.empty())
+            {
+                task = std::move(queue.front());
+                queue.pop_front();
+                m_Queued--;
+                m_Steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Queues a task.
+ *
+ * A task submitted by a worker of this pool goes to that worker's deque, others are spread over the
+ * workers in turn.
+ *
+ * @param task The task to run.
+ * @param priority Tasks of a higher priority are run and stolen first.
+ */
+void TaskScheduler::Submit(std::function<void()> task, const TaskPriorityEnum& priority)
+{
+    const int index = t_Scheduler == this ? t_Worker : (int)(m_NextWorker++ % m_Workers.size());
+    m_Pending++;
+    {
+        Worker& worker = *m_Workers[index];
+        std::lock_guard<std::mutex> lock(worker.m_Mutex);
+        worker.m_Queues[priority].push_back(std::move(task));
+        m_Queued++;
+    }
+
+    if (m_Sleeping.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+        }
+        m_Wake.notify_one();
+    }
+}
+
+/**
+ * @brief Blocks until every task submitted so far, and every task those submitted, has finished.
+ */
+void TaskScheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_SleepMutex);
+    m_Idle.wait(lock, [this]() { return m_Pending.load() == 0; });
+}
+
+/**
+ * @brief Returns the number of worker threads.
+ */
+int TaskScheduler::Threads() const
+{
+    return (int)m_Workers.size();
+}
+
+/**
+ * @brief Returns how many tasks were run by another worker than the one they were queued on.
+ */
+unsigned long long TaskScheduler::Steals() const
+{
+    return m_Steals.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the index of the calling worker thread.
+ *
+ * @return The index in [0, Threads()) inside a task, -1 on threads outside any pool.
+ */
+int TaskScheduler::WorkerIndex()
+{
+    return t_Worker;
+}
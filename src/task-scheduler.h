@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Order in which queued tasks are picked, higher priorities first.
+ */
+enum TaskPriorityEnum
+{
+	PRIORITY_HIGH,
+	PRIORITY_NORMAL,
+	PRIORITY_LOW,
+	PRIORITY_COUNT
+};
+
+/**
+ * @brief Settings of a task scheduler.
+ */
+struct TaskSchedulerConfig
+{
+	int m_Threads = 0;         // Worker threads, 0 for one per core
+	bool m_PinThreads = false; // Binds worker i to core i (Linux only)
+};
+
+/**
+ * @brief A work-stealing pool for large sets of independent, unevenly sized tasks.
+ *
+ * Every worker owns one deque per priority. A worker runs its own newest task first, which keeps a task
+ * that submits subtasks working on hot data; an idle worker steals the oldest task of another worker,
+ * which for recursive work is the largest one left. Tasks submitted from outside the pool are spread
+ * over the workers in turn. Workers with nothing to run or steal sleep until a task is submitted.
+ *
+ * Tasks that keep per-thread state (an engine, a random generator, a buffer) index it with
+ * WorkerIndex(). Wait blocks until every task submitted so far, including subtasks, has finished; it
+ * must not be called from a task.
+ */
+class TaskScheduler
+{
+private:
+	/**
+	 * @brief The queues of one worker thread. Guarded by a mutex, as tasks run for microseconds at least.
+	 */
+	struct Worker
+	{
+		std::mutex m_Mutex;
+		std::deque<std::function<void()>> m_Queues[PRIORITY_COUNT];
+		std::thread m_Thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::atomic<size_t> m_Queued;         // Tasks waiting in any deque
+	std::atomic<size_t> m_Pending;        // Tasks queued or running
+	std::atomic<size_t> m_Sleeping;       // Workers waiting for tasks
+	std::atomic<size_t> m_NextWorker;     // Receives the next task submitted from outside the pool
+	std::atomic<unsigned long long> m_Steals;
+	std::atomic<bool> m_Stop;
+
+	std::mutex m_SleepMutex;
+	std::condition_variable m_Wake; // Signals sleeping workers that tasks were queued or the pool stops
+	std::condition_variable m_Idle; // Signals Wait that no task is pending
+
+	void WorkerLoop(const int& index, const bool& pin);
+	bool TryRun(const int& index);
+	bool Pop(const int& index, std::function<void()>& task);
+	bool Steal(const int& index, std::function<void()>& task);
+
+public:
+	TaskScheduler(const TaskSchedulerConfig& config = TaskSchedulerConfig());
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	void Submit(std::function<void()> task, const TaskPriorityEnum& priority = PRIORITY_NORMAL);
+	void Wait();
+	int Threads() const;
+	unsigned long long Steals() const;
+
+	static int WorkerIndex();
+};
@@ -6,8 +6,9 @@
  * @brief Constructs a new Timer object and starts the timer.
  *
  * @param ResultPtr Pointer to a float variable where the elapsed time will be stored.
+ * @param zone Name of the trace zone to record, nullptr for none.
  */
-Timer::Timer(float* ResultPtr) : m_ResultPtr(ResultPtr)
+Timer::Timer(float* ResultPtr, const char* zone) : m_ResultPtr(ResultPtr), m_Zone(zone)
 {
 	m_StartTimepoint = std::chrono::high_resolution_clock::now(); // Record the current time
 }
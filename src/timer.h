@@ -2,22 +2,28 @@
 
 #include <chrono>
 
+#include "tracer.h"
+
 /**
  * @brief A timer class to measure elapsed time.
+ *
+ * A timer can also record its lifetime as a named TraceZone while tracing is enabled.
  */
 class Timer
 {
 private:
     std::chrono::time_point<std::chrono::high_resolution_clock> m_StartTimepoint; // Start timepoint of the timer
     float* m_ResultPtr; // Pointer to store the elapsed time result
+    TraceZone m_Zone; // Zone recorded when the timer is destroyed
 
 public:
     /**
      * @brief Constructs a new Timer object.
      *
      * @param ResultPtr Pointer to a float variable where the elapsed time will be stored.
+     * @param zone Name of the trace zone to record, nullptr for none.
      */
-    Timer(float* ResultPtr);
+    Timer(float* ResultPtr, const char* zone = nullptr);
 
     /**
      * @brief Destroys the Timer object and calculates the elapsed time.
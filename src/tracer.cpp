@@ -0,0 +1,200 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Tracer::s_Enabled = false;
+
+namespace
+{
+    /**
+     * @brief One finished zone.
+     */
+    struct TraceEvent
+    {
+        const char* m_Name;
+        long long m_Start; // Nanoseconds since the first call to Tracer::Now
+        long long m_End;
+        unsigned int m_Thread;
+    };
+
+    /**
+     * @brief The ring buffer of one thread. Only its owner writes to it.
+     */
+    struct TraceBuffer
+    {
+        std::unique_ptr<TraceEvent[]> m_Events = std::make_unique<TraceEvent[]>(Tracer::CAPACITY);
+        std::atomic<size_t> m_Written = 0; // Events ever written, the ring holds the last CAPACITY of them
+    };
+
+    /**
+     * @brief Owns every buffer, including the ones of threads that already exited.
+     */
+    struct TraceRegistry
+    {
+        std::mutex m_Mutex;
+        std::vector<std::unique_ptr<TraceBuffer>> m_Buffers;
+        std::vector<TraceBuffer*> m_Free; // Buffers of exited threads, reused by new ones
+        std::atomic<unsigned int> m_NextThread = 0;
+    };
+
+    TraceRegistry& Registry()
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    /**
+     * @brief Attaches a buffer to the calling thread on its first zone and releases it when the thread exits.
+     */
+    struct ThreadTrace
+    {
+        TraceBuffer* m_Buffer = nullptr;
+        unsigned int m_Thread = 0;
+
+        TraceBuffer* Acquire()
+        {
+            if (m_Buffer == nullptr)
+            {
+                TraceRegistry& registry = Registry();
+                std::lock_guard<std::mutex> lock(registry.m_Mutex);
+                if (registry.m_Free.empty())
+                {
+                    registry.m_Buffers.push_back(std::make_unique<TraceBuffer>());
+                    m_Buffer = registry.m_Buffers.back().get();
+                }
+                else
+                {
+                    m_Buffer = registry.m_Free.back();
+                    registry.m_Free.pop_back();
+                }
+                m_Thread = registry.m_NextThread++;
+            }
+            return m_Buffer;
+        }
+
+        ~ThreadTrace()
+        {
+            if (m_Buffer != nullptr)
+            {
+                TraceRegistry& registry = Registry();
+                std::lock_guard<std::mutex> lock(registry.m_Mutex);
+                registry.m_Free.push_back(m_Buffer);
+            }
+        }
+    };
+
+    thread_local ThreadTrace t_Trace;
+}
+
+/**
+ * @brief Starts recording zones.
+ */
+void Tracer::Enable()
+{
+    Now(); // Fix the time origin before the first zone
+    s_Enabled.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Stops recording zones. Zones already open when tracing is disabled are still recorded.
+ */
+void Tracer::Disable()
+{
+    s_Enabled.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the current time on the trace clock.
+ *
+ * @return Nanoseconds since the first call.
+ */
+long long Tracer::Now()
+{
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+/**
+ * @brief Appends a finished zone to the ring buffer of the calling thread.
+ *
+ * @param name Name of the zone.
+ * @param start Start of the zone on the trace clock.
+ * @param end End of the zone on the trace clock.
+ */
+void Tracer::Record(const char* name, const long long& start, const long long& end)
+{
+    TraceBuffer* buffer = t_Trace.Acquire();
+    const size_t written = buffer->m_Written.load(std::memory_order_relaxed);
+    buffer->m_Events[written % CAPACITY] = { name, start, end, t_Trace.m_Thread };
+    buffer->m_Written.store(written + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Writes every recorded zone as Chrome trace-event JSON.
+ *
+ * Should be called while traced threads are idle (for example at exit), zones recorded during the
+ * dump may be missing or torn.
+ *
+ * @param fileName The file to write.
+ * @return The number of zones written.
+ */
+size_t Tracer::Dump(const std::string& fileName)
+{
+    std::vector<TraceEvent> events;
+    {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.m_Mutex);
+        for (const std::unique_ptr<TraceBuffer>& buffer : registry.m_Buffers)
+        {
+            const size_t written = buffer->m_Written.load(std::memory_order_acquire);
+            for (size_t i = written - std::min(written, CAPACITY); i < written; ++i)
+            {
+                events.push_back(buffer->m_Events[i % CAPACITY]);
+            }
+        }
+    }
+
+    // Parents before children, so viewers that rely on the order nest zones correctly
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b)
+        {
+            return a.m_Thread != b.m_Thread ? a.m_Thread < b.m_Thread : a.m_Start != b.m_Start ? a.m_Start < b.m_Start : a.m_End > b.m_End;
+        });
+
+    std::ofstream file(fileName);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        const TraceEvent& event = events[i];
+        file << std::format("{}\n{{\"name\":\"{}\",\"cat\":\"mancala\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+            i == 0 ? "" : ",", event.m_Name, event.m_Thread, event.m_Start * 0.001, (event.m_End - event.m_Start) * 0.001);
+    }
+    file << "\n]}\n";
+    return events.size();
+}
+
+/**
+ * @brief Enables tracing and dumps every recorded zone to a file when the program exits.
+ *
+ * @param fileName The file to write at exit.
+ */
+void Tracer::Start(const std::string& fileName)
+{
+    static std::string s_FileName;
+    s_FileName = fileName;
+
+    Registry(); // Constructed before the exit handler is registered, so it is destroyed after it runs
+    std::atexit([]()
+        {
+            const size_t zones = Dump(s_FileName);
+            std::cout << std::format("trace: {} zones written to {}\n", zones, s_FileName);
+        });
+    Enable();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+/**
+ * @brief Records timed zones into per-thread ring buffers and writes them as Chrome trace-event JSON.
+ *
+ * Every thread that enters a zone while tracing is enabled gets its own ring buffer of CAPACITY
+ * events, so recording never takes a lock. When a buffer is full the oldest zones are overwritten.
+ * Buffers outlive their threads (their zones are still dumped) and are reused by later threads,
+ * so short-lived worker threads do not grow memory. The dump opens in Perfetto (ui.perfetto.dev)
+ * or chrome://tracing, where nested zones show up as a flame graph per thread.
+ *
+ * While tracing is disabled a zone costs a single relaxed load and a branch, so zones can stay in
+ * production builds.
+ */
+class Tracer
+{
+private:
+	static std::atomic<bool> s_Enabled;
+
+	friend class TraceZone;
+
+	static void Record(const char* name, const long long& start, const long long& end);
+
+public:
+	static constexpr size_t CAPACITY = 1 << 15; // Events per thread
+
+	static void Enable();
+	static void Disable();
+	static bool Enabled() { return s_Enabled.load(std::memory_order_relaxed); }
+	static long long Now();
+
+	static size_t Dump(const std::string& fileName);
+	static void Start(const std::string& fileName);
+};
+
+/**
+ * @brief Records the time between its construction and destruction as a named zone.
+ *
+ * Zones on the same thread nest by time, so a zone constructed inside another one shows up as its
+ * child. The name must outlive the dump, string literals are the intended use.
+ */
+class TraceZone
+{
+private:
+	const char* m_Name; // nullptr when tracing was disabled at construction
+	long long m_Start;
+
+public:
+	TraceZone(const char* name) : m_Name(nullptr), m_Start(0)
+	{
+		if (Tracer::Enabled() && name != nullptr)
+		{
+			m_Name = name;
+			m_Start = Tracer::Now();
+		}
+	}
+
+	~TraceZone()
+	{
+		if (m_Name != nullptr)
+		{
+			Tracer::Record(m_Name, m_Start, Tracer::Now());
+		}
+	}
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+};
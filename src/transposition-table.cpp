@@ -0,0 +1,360 @@
+#include "transposition-table.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Constructs a transposition table of roughly the requested size.
+ *
+ * The number of entries is rounded down to a power of two so that indexing is a single mask.
+ *
+ * @param sizeInMegabytes Memory budget of the table in megabytes.
+ */
+TranspositionTable::TranspositionTable(const size_t& sizeInMegabytes) : m_Slots(nullptr), m_Mask(0), m_Mapping(nullptr), m_MappingSize(0)
+{
+    Allocate(sizeInMegabytes);
+    Clear();
+}
+
+/**
+ * @brief Opens the transposition table kept in a shared-memory segment, creating it if needed.
+ *
+ * When the segment cannot be mapped the table falls back to memory private to this process, which
+ * Shared() reports.
+ *
+ * @param sharedName Name of the segment, the same for every process that shares the table.
+ * @param sizeInMegabytes Memory budget of the table in megabytes, used by the process creating the segment.
+ * @param hugePages Whether to ask the kernel to back the segment with transparent huge pages.
+ */
+TranspositionTable::TranspositionTable(const std::string& sharedName, const size_t& sizeInMegabytes, const bool& hugePages)
+    : m_Slots(nullptr), m_Mask(0), m_Mapping(nullptr), m_MappingSize(0)
+{
+    if (!MapShared(sharedName, sizeInMegabytes, hugePages))
+    {
+        std::cerr << "Cannot map shared transposition table " << sharedName << ", using a private one\n";
+        Allocate(sizeInMegabytes);
+        Clear();
+    }
+}
+
+/**
+ * @brief Releases the table. A shared segment is only unmapped, it stays available to other processes.
+ */
+TranspositionTable::~TranspositionTable()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_Mapping != nullptr)
+    {
+        munmap(m_Mapping, m_MappingSize);
+    }
+#endif
+}
+
+/**
+ * @brief Returns the number of slots that fit in a number of bytes, rounded down to a power of two.
+ */
+size_t TranspositionTable::SlotCount(const size_t& bytes)
+{
+    size_t count = 1;
+    while (count * 2 * sizeof(Slot) <= bytes)
+    {
+        count *= 2;
+    }
+    return count;
+}
+
+/**
+ * @brief Allocates slots private to this process.
+ *
+ * @param sizeInMegabytes Memory budget of the table in megabytes.
+ */
+void TranspositionTable::Allocate(const size_t& sizeInMegabytes)
+{
+    const size_t count = SlotCount(sizeInMegabytes * 1024 * 1024);
+    m_OwnedSlots = std::make_unique<Slot[]>(count);
+    m_Slots = m_OwnedSlots.get();
+    m_Mask = count - 1;
+}
+
+/**
+ * @brief Maps the shared-memory segment of a table.
+ *
+ * The process that creates the segment sizes it, clears the slots and then publishes the header;
+ * processes opening an existing segment wait for the header and take the size it records.
+ *
+ * @param name Name of the segment.
+ * @param sizeInMegabytes Memory budget of the table when the segment is created.
+ * @param hugePages Whether to advise the kernel to use huge pages.
+ * @return True if the segment was mapped, false otherwise.
+ */
+bool TranspositionTable::MapShared(const std::string& name, const size_t& sizeInMegabytes, const bool& hugePages)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const std::string path = name.starts_with("/") ? name : "/" + name;
+    const size_t count = SlotCount(sizeInMegabytes * 1024 * 1024);
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+    bool creator = true;
+    int file = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (file < 0 && errno == EEXIST)
+    {
+        creator = false;
+        file = shm_open(path.c_str(), O_RDWR, 0600);
+    }
+    if (file < 0)
+    {
+        return false;
+    }
+
+    size_t size = sizeof(SharedHeader) + count * sizeof(Slot);
+    if (creator)
+    {
+        if (ftruncate(file, (off_t)size) != 0)
+        {
+            close(file);
+            shm_unlink(path.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        // The creator may not have sized the segment yet
+        struct stat status;
+        while (fstat(file, &status) == 0 && (size_t)status.st_size < sizeof(SharedHeader) && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        size = fstat(file, &status) == 0 ? (size_t)status.st_size : 0;
+        if (size < sizeof(SharedHeader) + sizeof(Slot))
+        {
+            close(file);
+            return false;
+        }
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if (hugePages)
+    {
+        madvise(mapping, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    SharedHeader* header = static_cast<SharedHeader*>(mapping);
+    m_Mapping = mapping;
+    m_MappingSize = size;
+    m_Slots = reinterpret_cast<Slot*>(header + 1);
+
+    if (creator)
+    {
+        m_Mask = count - 1;
+        Clear();
+        header->m_Version = SHARED_VERSION;
+        header->m_SlotCount = count;
+        header->m_Ready.store(SHARED_MAGIC, std::memory_order_release);
+        return true;
+    }
+
+    while (header->m_Ready.load(std::memory_order_acquire) != SHARED_MAGIC && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const unsigned long long slots = header->m_SlotCount;
+    if (header->m_Ready.load(std::memory_order_acquire) != SHARED_MAGIC || header->m_Version != SHARED_VERSION ||
+        slots == 0 || (slots & (slots - 1)) != 0 || sizeof(SharedHeader) + slots * sizeof(Slot) > size)
+    {
+        munmap(mapping, size);
+        m_Mapping = nullptr;
+        m_MappingSize = 0;
+        m_Slots = nullptr;
+        return false;
+    }
+
+    m_Mask = slots - 1;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Packs the fields of an entry into one word.
+ */
+unsigned long long TranspositionTable::Pack(const float& score, const char& depth, const char& bestMove, const BoundEnum& bound)
+{
+    unsigned int scoreBits;
+    std::memcpy(&scoreBits, &score, sizeof(scoreBits));
+    return (unsigned long long)scoreBits | (unsigned long long)(unsigned char)depth << 32 |
+        (unsigned long long)(unsigned char)bestMove << 40 | (unsigned long long)bound << 48;
+}
+
+/**
+ * @brief Unpacks a word written by Pack.
+ */
+TranspositionEntry TranspositionTable::Unpack(const unsigned long long& key, const unsigned long long& data)
+{
+    TranspositionEntry entry;
+    const unsigned int scoreBits = (unsigned int)data;
+    std::memcpy(&entry.m_Score, &scoreBits, sizeof(scoreBits));
+    entry.m_Key = key;
+    entry.m_Depth = (char)(data >> 32);
+    entry.m_BestMove = (char)(data >> 40);
+    entry.m_Bound = (BoundEnum)(data >> 48);
+    return entry;
+}
+
+/**
+ * @brief Looks up a position in the table.
+ *
+ * @param key The hash of the position.
+ * @param entry Receives the stored entry when the lookup succeeds.
+ * @return True if the position was found, false otherwise.
+ */
+bool TranspositionTable::Probe(const unsigned long long& key, TranspositionEntry& entry) const
+{
+    const Slot& slot = m_Slots[key & m_Mask];
+    const unsigned long long data = slot.m_Data.load(std::memory_order_relaxed);
+    const unsigned long long check = slot.m_Check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key)
+    {
+        return false;
+    }
+
+    entry = Unpack(key, data);
+    return entry.m_Depth >= 0;
+}
+
+/**
+ * @brief Stores a search result, keeping the deeper of the old and new results for the same position.
+ *
+ * @param key The hash of the position.
+ * @param score The score found by the search.
+ * @param depth The remaining depth the position was searched with.
+ * @param bestMove The best move found, -1 if none.
+ * @param bound Whether the score is exact or a bound.
+ */
+void TranspositionTable::Store(const unsigned long long& key, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound)
+{
+    Slot& slot = m_Slots[key & m_Mask];
+    const unsigned long long oldData = slot.m_Data.load(std::memory_order_relaxed);
+    const unsigned long long oldCheck = slot.m_Check.load(std::memory_order_relaxed);
+    if ((oldCheck ^ oldData) == key && (char)(oldData >> 32) > depth)
+    {
+        return; // Keep the deeper result for this position
+    }
+
+    const unsigned long long data = Pack(score, depth, bestMove, bound);
+    slot.m_Check.store(key ^ data, std::memory_order_relaxed);
+    slot.m_Data.store(data, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Looks up a position by its canonical key.
+ *
+ * The returned entry is translated back to the frame of the given position: when the position had to
+ * be mirrored, the score is negated, the bounds are swapped and the move is mirrored.
+ *
+ * @param state The position to look up.
+ * @param entry Receives the stored entry when the lookup succeeds.
+ * @return True if the position (or its mirror) was found, false otherwise.
+ */
+bool TranspositionTable::Probe(const State& state, TranspositionEntry& entry) const
+{
+    if (!Probe(state.CanonicalHash(), entry))
+    {
+        return false;
+    }
+
+    if (state.m_Turn == 1)
+    {
+        entry.m_Score = -entry.m_Score;
+        entry.m_BestMove = State::MirrorMove(entry.m_BestMove);
+        entry.m_Bound = entry.m_Bound == LOWER_BOUND ? UPPER_BOUND : (entry.m_Bound == UPPER_BOUND ? LOWER_BOUND : EXACT);
+    }
+    return true;
+}
+
+/**
+ * @brief Stores a search result under the canonical key of the position.
+ *
+ * @param state The searched position.
+ * @param score The score found by the search, from player 1's point of view.
+ * @param depth The remaining depth the position was searched with.
+ * @param bestMove The best move found, -1 if none.
+ * @param bound Whether the score is exact or a bound.
+ */
+void TranspositionTable::Store(const State& state, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound)
+{
+    if (state.m_Turn == 0)
+    {
+        Store(state.CanonicalHash(), score, depth, bestMove, bound);
+        return;
+    }
+
+    const BoundEnum mirroredBound = bound == LOWER_BOUND ? UPPER_BOUND : (bound == UPPER_BOUND ? LOWER_BOUND : EXACT);
+    Store(state.CanonicalHash(), -score, depth, State::MirrorMove(bestMove), mirroredBound);
+}
+
+/**
+ * @brief Removes every entry from the table.
+ */
+void TranspositionTable::Clear()
+{
+    const unsigned long long empty = Pack(0.0F, -1, -1, EXACT);
+    for (size_t i = 0; i <= m_Mask; ++i)
+    {
+        m_Slots[i].m_Check.store(empty, std::memory_order_relaxed); // Key 0 with depth -1, never a hit
+        m_Slots[i].m_Data.store(empty, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Tells whether the table lives in a shared-memory segment.
+ *
+ * @return True if other processes can see the entries of this table, false otherwise.
+ */
+bool TranspositionTable::Shared() const
+{
+    return m_Mapping != nullptr;
+}
+
+/**
+ * @brief Returns the number of entries the table holds.
+ */
+size_t TranspositionTable::Capacity() const
+{
+    return m_Mask + 1;
+}
+
+/**
+ * @brief Removes a shared-memory segment. Processes that mapped it keep their mapping until they exit.
+ *
+ * @param sharedName Name of the segment.
+ * @return True if the segment existed and was removed, false otherwise.
+ */
+bool TranspositionTable::RemoveShared(const std::string& sharedName)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const std::string path = sharedName.starts_with("/") ? sharedName : "/" + sharedName;
+    return shm_unlink(path.c_str()) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "state.h"
+
+/**
+ * @brief Enumerates how a stored score relates to the true minimax value.
+ */
+enum BoundEnum : unsigned char
+{
+	EXACT,
+	LOWER_BOUND,
+	UPPER_BOUND
+};
+
+/**
+ * @brief A single slot of the transposition table.
+ */
+struct TranspositionEntry
+{
+	unsigned long long m_Key; // Full position hash, used to detect index collisions
+	float m_Score;            // Minimax score from the point of view of the player on the first side
+	char m_Depth;             // Remaining depth the score was searched with
+	char m_BestMove;          // Best (or refuting) move found, -1 if unknown
+	BoundEnum m_Bound;        // Whether the score is exact or a bound
+};
+
+/**
+ * @brief A fixed-size hash table of previously searched positions.
+ *
+ * The table is indexed by State::Hash() and replaces entries that were searched with a smaller
+ * remaining depth. Positions passed as a State are stored in their canonical form, so a position and
+ * its player-swapped mirror share one entry. It is meant to live longer than a single search so that work done on earlier
+ * moves (or while pondering) is reused by later ones.
+ *
+ * Probe and Store are safe to call from several threads at once, so searches running in parallel can
+ * share one table. An entry is packed into one 64-bit word stored next to its key XORed with that word;
+ * an entry torn by concurrent writes no longer matches its key and reads as a miss.
+ *
+ * A table can also live in a named POSIX shared-memory segment, shared by every engine process that
+ * opens the same name. The XOR check covers writers in other processes as well, including one killed
+ * halfway through a store, so no lock is ever taken across processes. The first process to open a
+ * name sizes and clears the segment, later ones map it as it is.
+ */
+class TranspositionTable
+{
+private:
+	/**
+	 * @brief A slot of the table, written and read without locks.
+	 */
+	struct Slot
+	{
+		std::atomic<unsigned long long> m_Check; // Key XOR data
+		std::atomic<unsigned long long> m_Data;  // Score, depth, best move and bound
+	};
+
+	/**
+	 * @brief The start of a shared-memory segment, the slots follow it.
+	 */
+	struct alignas(64) SharedHeader
+	{
+		std::atomic<unsigned int> m_Ready; // SHARED_MAGIC once the creating process cleared the slots
+		unsigned int m_Version;
+		unsigned long long m_SlotCount;
+	};
+
+	static constexpr unsigned int SHARED_MAGIC = 0x4D54544B;
+	static constexpr unsigned int SHARED_VERSION = 1;
+
+	static_assert(std::atomic<unsigned long long>::is_always_lock_free, "Shared slots need address-free atomics");
+
+	Slot* m_Slots;
+	unsigned long long m_Mask;
+	std::unique_ptr<Slot[]> m_OwnedSlots; // Storage of a table private to this process
+	void* m_Mapping;                      // Storage of a shared table, nullptr otherwise
+	size_t m_MappingSize;
+
+	void Allocate(const size_t& sizeInMegabytes);
+	bool MapShared(const std::string& name, const size_t& sizeInMegabytes, const bool& hugePages);
+	static size_t SlotCount(const size_t& bytes);
+
+	static unsigned long long Pack(const float& score, const char& depth, const char& bestMove, const BoundEnum& bound);
+	static TranspositionEntry Unpack(const unsigned long long& key, const unsigned long long& data);
+
+public:
+	TranspositionTable(const size_t& sizeInMegabytes = 32);
+	TranspositionTable(const std::string& sharedName, const size_t& sizeInMegabytes, const bool& hugePages = false);
+	~TranspositionTable();
+
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+	bool Probe(const unsigned long long& key, TranspositionEntry& entry) const;
+	void Store(const unsigned long long& key, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound);
+	bool Probe(const State& state, TranspositionEntry& entry) const;
+	void Store(const State& state, const float& score, const char& depth, const char& bestMove, const BoundEnum& bound);
+	void Clear();
+	bool Shared() const;
+	size_t Capacity() const;
+
+	static bool RemoveShared(const std::string& sharedName);
+};
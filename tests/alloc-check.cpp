@@ -0,0 +1,10 @@
+#include <string>
+#include "allocation-tracker.h"
+
+// Allocation and memory growth check, run by ctest: alloc-check [depth] [moves]
+int main(int argc, char* argv[])
+{
+    const char depth = argc > 1 ? (char)std::stoi(argv[1]) : 6;
+    const int moves = argc > 2 ? std::stoi(argv[2]) : 1000;
+    return AllocationTracker::Start(depth, moves);
+}
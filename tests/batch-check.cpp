@@ -0,0 +1,73 @@
+#include <vector>
+#include "check.h"
+#include "mancala-api.h"
+#include "position-index.h"
+#include "state-batch.h"
+
+// Batched move check against the moves of State, played through the C API, run by ctest
+static State ToState(const mancala_position& position)
+{
+    State state;
+    state.MutateBoard(std::vector<char>(position.board, position.board + MANCALA_PITS));
+    state.ChangeTurn((char)position.turn);
+    state.ChangeRuleset((char)position.ruleset);
+    return state;
+}
+
+int main()
+{
+    // Not a multiple of the AVX2 lanes, so the scalar tail runs too
+    const size_t boards = 37;
+    StateBatch batch(boards);
+    std::vector<mancala_position> positions(boards);
+    for (size_t i = 0; i < boards; ++i)
+    {
+        CHECK(mancala_position_init(&positions[i], (int)(i % 2)) == MANCALA_OK);
+        batch.Set(i, ToState(positions[i]));
+    }
+
+    unsigned long long seed = 2024;
+    char moves[boards];
+    unsigned char masks[boards];
+    bool flags[boards];
+    for (int round = 0; round < 400; ++round)
+    {
+        batch.LegalMoveMasks(masks);
+        batch.GameOverFlags(flags);
+        for (size_t i = 0; i < boards; ++i)
+        {
+            // The legal moves and the end of the game agree with State
+            int8_t legalMoves[6];
+            const int count = mancala_legal_moves(&positions[i], legalMoves);
+            CHECK(flags[i] == (mancala_game_over(&positions[i], nullptr) == 1));
+
+            unsigned char mask = 0;
+            for (int j = 0; j < count; ++j)
+            {
+                mask |= (unsigned char)(1 << (legalMoves[j] - (positions[i].turn == 0 ? 0 : 7)));
+            }
+            CHECK(count == 0 || masks[i] == mask);
+
+            // Finished games start over, every other board plays a random legal move
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            moves[i] = count == 0 ? -1 : (char)legalMoves[(seed >> 33) % count];
+            if (count == 0)
+            {
+                mancala_position_init(&positions[i], positions[i].ruleset);
+                batch.Set(i, ToState(positions[i]));
+            }
+            else
+            {
+                CHECK(mancala_make_move(&positions[i], moves[i]) == MANCALA_OK);
+            }
+        }
+
+        batch.MakeMoves(moves);
+        for (size_t i = 0; i < boards; ++i)
+        {
+            CHECK(PositionIndex::Rank(batch.Get(i)) == PositionIndex::Rank(ToState(positions[i])));
+        }
+    }
+
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include "check.h"
+#include "openings-book.h"
+#include "state-analyzer.h"
+
+// Opening book merge and checkpoint resume check, run by ctest
+int main()
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "mancala-book-check";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    // Merging keeps the deeper record of a position found in both books
+    {
+        const std::string bookFile = (directory / "merge.bin").string();
+        std::unordered_map<unsigned long long, BookRecord> entries;
+        entries[1] = { 1, 2, 5, {} };
+        entries[2] = { 2, 3, 3, {} };
+        CHECK(OpeningsBookGenerator::SaveBook(bookFile, entries));
+
+        entries.clear();
+        entries[1] = { 1, 4, 4, {} };
+        entries[2] = { 2, 5, 6, {} };
+        entries[3] = { 3, 0, 2, {} };
+        CHECK(OpeningsBookGenerator::SaveBook(bookFile, entries));
+
+        std::unordered_map<unsigned long long, BookRecord> merged;
+        CHECK(OpeningsBookGenerator::LoadBook(bookFile, merged));
+        CHECK(merged.size() == 3);
+        CHECK(merged[1].m_Move == 2 && merged[1].m_Depth == 5);
+        CHECK(merged[2].m_Move == 5 && merged[2].m_Depth == 6);
+        CHECK(merged[3].m_Move == 0);
+        CHECK(!std::filesystem::exists(bookFile + ".tmp"));
+    }
+
+    // The book answers for the second player two plies deep: one move for each of the five replies that pass the turn
+    BookConfig config;
+    State root;
+    std::string error;
+    CHECK(StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0", "0", "", root, error));
+    config.m_Roots.push_back(root);
+    config.m_Depth = 2;
+    config.m_Player = 1;
+    config.m_SearchDepth = 2;
+    config.m_BookFile = (directory / "book.bin").string();
+    config.m_CheckpointFile = (directory / "book.checkpoint").string();
+
+    // A checkpoint holding one queued position resumes from it instead of from the roots
+    const auto writeCheckpoint = [&config](const unsigned long long& fingerprint)
+    {
+        std::ofstream file(config.m_CheckpointFile, std::ios::binary | std::ios::trunc);
+        const unsigned long long empty = 0, queued = 1;
+        const char position[16] = { 0, 5, 5, 5, 5, 4, 0, 4, 4, 4, 4, 4, 4, 0, 1, 0 }; // After the first pit, second player to move
+        const int ply = 1;
+        file.write(OpeningsBookGenerator::CHECKPOINT_MAGIC, sizeof(OpeningsBookGenerator::CHECKPOINT_MAGIC));
+        file.write((const char*)&fingerprint, sizeof(fingerprint));
+        file.write((const char*)&empty, sizeof(empty));
+        file.write((const char*)&empty, sizeof(empty));
+        file.write((const char*)&queued, sizeof(queued));
+        file.write(position, sizeof(position));
+        file.write((const char*)&ply, sizeof(ply));
+    };
+    const auto bookSize = [&config]()
+    {
+        std::unordered_map<unsigned long long, BookRecord> entries;
+        return OpeningsBookGenerator::LoadBook(config.m_BookFile, entries) ? entries.size() : 0;
+    };
+
+    writeCheckpoint(OpeningsBookGenerator::Fingerprint(config));
+    CHECK(OpeningsBookGenerator(config).Generate());
+    CHECK(bookSize() == 1);
+    CHECK(!std::filesystem::exists(config.m_CheckpointFile));
+
+    // A build without a checkpoint extends the book, one with another build's checkpoint starts from the roots
+    CHECK(OpeningsBookGenerator(config).Generate());
+    CHECK(bookSize() == 5);
+    std::filesystem::remove(config.m_BookFile);
+    writeCheckpoint(OpeningsBookGenerator::Fingerprint(config) + 1);
+    CHECK(OpeningsBookGenerator(config).Generate());
+    CHECK(bookSize() == 5);
+
+    std::filesystem::remove_all(directory);
+    return s_Failures == 0 ? 0 : 1;
+}
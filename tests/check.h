@@ -0,0 +1,16 @@
+#pragma once
+
+#include <iostream>
+
+// Assertions of the ctest checks: a failed check is reported and the check exits with 1
+inline int s_Failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(condition))                                                                  \
+        {                                                                                  \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            ++s_Failures;                                                                  \
+        }                                                                                  \
+    } while (false)
@@ -0,0 +1,81 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "game-config.h"
+
+// Settings file and override check, run by ctest
+int main()
+{
+    const std::string filename = (std::filesystem::temp_directory_path() / "mancala-config-check.dat").string();
+    const auto write = [&filename](const std::string& contents)
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), contents.size());
+    };
+    const auto settingsFile = [](const int& version, const std::vector<int>& values)
+    {
+        const int size = (int)(values.size() * sizeof(int));
+        std::string contents(GameConfig::MAGIC, sizeof(GameConfig::MAGIC));
+        contents.append((const char*)&version, sizeof(version));
+        contents.append((const char*)&size, sizeof(size));
+        contents.append((const char*)values.data(), size);
+        return contents;
+    };
+
+    // Settings survive a round trip through the file
+    GameConfig saved;
+    CHECK(saved.Set("ruleset=1") && saved.Set("time_limit=250") && saved.Set("ponder=0"));
+    write(saved.Serialize());
+    GameConfig loaded;
+    CHECK(loaded.Load(filename));
+    CHECK(loaded.m_Ruleset == 1 && loaded.m_TimeLimit == 250 && loaded.m_Ponder == 0 && loaded.m_ShowEvaluation == 1);
+
+    // Values out of range keep the current ones
+    write(settingsFile(1, { 7, 0, 1, 1, 0 }));
+    GameConfig ranged;
+    CHECK(ranged.Load(filename));
+    CHECK(ranged.m_Ruleset == 0 && ranged.m_TimeLimit == 100 && ranged.m_OpeningMoveAllowed == 1 && ranged.m_ShowEvaluation == 0);
+    write(settingsFile(1, { 1, GameConfig::MAX_TIME_LIMIT + 1, 2, -1, 1 }));
+    CHECK(ranged.Load(filename));
+    CHECK(ranged.m_Ruleset == 1 && ranged.m_TimeLimit == 100 && ranged.m_OpeningMoveAllowed == 1 && ranged.m_Ponder == 1);
+
+    // An older file lacks the later settings, a newer one holds settings this version does not know
+    write(settingsFile(1, { 1, 500 }));
+    GameConfig older;
+    CHECK(older.Load(filename));
+    CHECK(older.m_Ruleset == 1 && older.m_TimeLimit == 500 && older.m_Ponder == 1);
+    write(settingsFile(2, { 0, 300, 1, 0, 0, 12345 }));
+    GameConfig newer;
+    CHECK(newer.Load(filename));
+    CHECK(newer.m_TimeLimit == 300 && newer.m_OpeningMoveAllowed == 1 && newer.m_Ponder == 0 && newer.m_ShowEvaluation == 0);
+
+    // Files that are not settings files are rejected
+    std::string damaged = saved.Serialize();
+    damaged[0] = 'X';
+    write(damaged);
+    CHECK(!GameConfig().Load(filename));
+    write(saved.Serialize().substr(0, 6));
+    CHECK(!GameConfig().Load(filename));
+    std::filesystem::remove(filename);
+    CHECK(!GameConfig().Load(filename));
+
+    // Assignments need a known key and an integer in range
+    GameConfig config;
+    CHECK(!config.Set("time_limit=0"));
+    CHECK(!config.Set("time_limit=abc"));
+    CHECK(!config.Set("time_limit=25x"));
+    CHECK(!config.Set("time_limit"));
+    CHECK(!config.Set("depth=5"));
+    CHECK(config.m_TimeLimit == 100);
+
+    // Valid overrides apply over the loaded settings
+    CHECK(GameConfig::AddOverride("time_limit=750"));
+    CHECK(!GameConfig::AddOverride("ponder=2"));
+    config.ApplyOverrides();
+    CHECK(config.m_TimeLimit == 750 && config.m_Ponder == 1);
+
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include "check.h"
+#include "state-analyzer.h"
+
+// Exact endgame search check, run by ctest
+int main()
+{
+    // Endgames with a forced line and their final store differences under both rulesets, worked out by hand
+    struct KnownEndgame
+    {
+        const char* m_Board;
+        const char* m_Turn;
+        int m_Classic;
+        int m_Turkish;
+    };
+    const KnownEndgame known[] = {
+        { "0-0-0-0-0-1-23-1-0-0-0-0-0-23", "0", 0, 2 },   // The last stone ends the game, the opponent's stone is swept
+        { "0-0-0-0-0-1-23-0-0-0-0-0-1-23", "1", 0, -2 },  // The same for the second player
+        { "0-0-0-0-0-2-22-1-0-0-0-0-0-23", "0", -2, 2 },  // A Turkish move leaves a stone behind and earns another turn
+        { "0-0-0-0-0-1-25-0-0-0-0-0-1-21", "0", 4, 6 },   // Play goes on after a store passed the majority
+    };
+    for (const KnownEndgame& endgame : known)
+    {
+        for (const int ruleset : { 0, 1 })
+        {
+            State state;
+            std::string error;
+            CHECK(StateAnalyzer::ParsePosition(endgame.m_Board, endgame.m_Turn, std::to_string(ruleset), state, error));
+            const int difference = ruleset == 0 ? endgame.m_Classic : endgame.m_Turkish;
+            const float expected = difference > 0 ? Minimax::WIN_SCORE + difference : (difference < 0 ? -Minimax::WIN_SCORE + difference : 0.0F);
+            Minimax engine(std::make_shared<TranspositionTable>(1));
+            CHECK(engine.Search(state, 1).m_Score == expected);
+        }
+    }
+
+    // Below the exact threshold the score does not depend on the depth, the window or an earlier search
+    const char* endgames[][2] = {
+        { "0-0-0-0-1-1-22-1-0-0-0-0-1-22", "0" },
+        { "0-0-0-0-1-1-22-1-0-0-0-0-1-22", "1" },
+        { "1-0-2-0-0-1-20-0-1-0-0-2-1-20", "0" },
+        { "0-3-0-1-0-0-21-2-0-0-1-0-0-20", "1" },
+        { "0-0-1-0-0-2-23-0-0-0-3-0-0-19", "0" },
+        { "2-1-0-0-1-0-20-0-2-1-0-1-0-20", "1" },
+    };
+    for (const auto& [board, turn] : endgames)
+    {
+        for (const std::string ruleset : { "0", "1" })
+        {
+            State state;
+            std::string error;
+            CHECK(StateAnalyzer::ParsePosition(board, turn, ruleset, state, error));
+            Minimax shallow(std::make_shared<TranspositionTable>(1));
+            Minimax deep(std::make_shared<TranspositionTable>(1));
+            const float score = shallow.Search(state, 1).m_Score;
+            CHECK(std::abs(score) >= Minimax::WIN_SCORE || score == 0.0F);
+            CHECK(deep.Search(state, 30).m_Score == score);
+            CHECK(shallow.Search(state, 30).m_Score == score);
+            CHECK(shallow.SearchMultiPV(state, 2, MultiPVResult::MAX_LINES).m_Lines[0].m_Score == score);
+        }
+    }
+
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "check.h"
+#include "state-analyzer.h"
+
+// Multi-PV line ordering check, run by ctest
+int main()
+{
+    const char* positions[][2] = {
+        { "4-4-4-4-4-4-0-4-4-4-4-4-4-0", "0" },
+        { "3-5-0-6-1-4-5-2-6-1-5-4-3-3", "0" },
+        { "0-6-6-5-5-5-1-5-5-4-4-0-1-1", "1" },
+        { "2-0-7-1-0-3-12-1-0-4-2-1-0-15", "1" },
+    };
+    for (const auto& [board, turn] : positions)
+    {
+        State state;
+        std::string error;
+        CHECK(StateAnalyzer::ParsePosition(board, turn, "", state, error));
+
+        // Every pit with stones on the side to move is a legal move
+        int legalMoves = 0;
+        std::istringstream pits(board);
+        std::string pit;
+        for (int i = 0; std::getline(pits, pit, '-'); ++i)
+        {
+            legalMoves += (turn[0] == '0' ? i < 6 : i > 6 && i < 13) && std::stoi(pit) > 0;
+        }
+
+        Minimax all(std::make_shared<TranspositionTable>(4));
+        Minimax some(std::make_shared<TranspositionTable>(4));
+        Minimax single(std::make_shared<TranspositionTable>(4));
+        const bool maximizing = turn[0] == '0';
+        for (char depth = 1; depth <= 7; ++depth)
+        {
+            const MultiPVResult result = all.SearchMultiPV(state, depth, MultiPVResult::MAX_LINES);
+            const MultiPVResult top = some.SearchMultiPV(state, depth, 3);
+            const SearchResult best = single.Search(state, depth);
+
+            // One line per legal move, best first for the side to move, each starting with its own move
+            CHECK(result.m_LineCount == legalMoves);
+            for (int i = 0; i < result.m_LineCount; ++i)
+            {
+                const PrincipalLine& line = result.m_Lines[i];
+                CHECK(line.m_VariationLength > 0 && line.m_Variation[0] == line.m_Move);
+                for (int j = 0; j < i; ++j)
+                {
+                    CHECK(result.m_Lines[j].m_Move != line.m_Move);
+                    CHECK(maximizing ? result.m_Lines[j].m_Score >= line.m_Score : result.m_Lines[j].m_Score <= line.m_Score);
+                }
+            }
+
+            // The best line scores what a single best move search finds, and fewer lines rank the same
+            CHECK(result.m_Lines[0].m_Score == best.m_Score);
+            CHECK(top.m_LineCount == std::min(3, legalMoves));
+            for (int i = 0; i < top.m_LineCount; ++i)
+            {
+                CHECK(top.m_Lines[i].m_Score == result.m_Lines[i].m_Score);
+            }
+        }
+    }
+
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#include <vector>
+#include "check.h"
+#include "position-index.h"
+
+// Position index round trip check, run by ctest
+int main()
+{
+    // Small totals are checked exhaustively
+    for (int total = 0; total <= 6; ++total)
+    {
+        for (unsigned long long index = 0; index < PositionIndex::Count(total); ++index)
+        {
+            CHECK(PositionIndex::Rank(PositionIndex::Unrank(index, total)) == index);
+        }
+    }
+
+    // The layers of a total are contiguous and cover its range
+    for (const int total : { 1, 12, 48 })
+    {
+        CHECK(PositionIndex::LayerOffset(total, 0) == 0);
+        for (int stones = 0; stones <= total; ++stones)
+        {
+            CHECK(PositionIndex::LayerOffset(total, stones) < PositionIndex::LayerOffset(total, stones + 1));
+        }
+        CHECK(PositionIndex::LayerOffset(total, total + 1) == PositionIndex::Count(total));
+    }
+
+    // The full game is sampled across its range, including both ends
+    const int total = PositionIndex::MAX_STONES;
+    const unsigned long long count = PositionIndex::Count(total);
+    std::vector<unsigned long long> indices = { 0, 1, count - 2, count - 1 };
+    unsigned long long seed = 12345;
+    for (int i = 0; i < 10000; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        indices.push_back((seed >> 11) % count);
+    }
+    for (const unsigned long long& index : indices)
+    {
+        const State state = PositionIndex::Unrank(index, total, (char)(index % 2));
+        CHECK(PositionIndex::Indexable(state));
+        CHECK(PositionIndex::Rank(state) == index);
+    }
+
+    // Pit distributions round trip on their own; the layer of a total with every stone in the pits holds each twice
+    for (const int stones : { 0, 1, 13, 48 })
+    {
+        const unsigned long long distributions = (PositionIndex::LayerOffset(stones, stones + 1) - PositionIndex::LayerOffset(stones, stones)) / 2;
+        for (const unsigned long long rank : { 0ULL, distributions / 2, distributions - 1 })
+        {
+            char pits[PositionIndex::PITS];
+            PositionIndex::UnrankPits(rank, stones, pits);
+            int sum = 0;
+            for (const char& pit : pits)
+            {
+                sum += pit;
+            }
+            CHECK(sum == stones);
+            CHECK(PositionIndex::RankPits(pits, stones) == rank);
+        }
+    }
+
+    // The batch functions match the scalar ones
+    std::vector<State> states(indices.size());
+    std::vector<unsigned long long> ranks(indices.size());
+    PositionIndex::UnrankBatch(indices.data(), indices.size(), total, 0, states.data());
+    PositionIndex::RankBatch(states.data(), states.size(), ranks.data());
+    CHECK(ranks == indices);
+
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include <memory>
+#include <string>
+#include "check.h"
+#include "proof-number-solver.h"
+#include "state-analyzer.h"
+
+// Position parsing and proof-number solver check, run by ctest
+int main()
+{
+    State state;
+    std::string error;
+
+    // Malformed boards, boards without the 48 stones of a game and positions without a move are rejected
+    CHECK(StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0", "0", "", state, error));
+    CHECK(StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0", "1", "1", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0-0", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4--4-4-4-4-4-4-0", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-x", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("48-48-48-48-48-48-48-48-48-48-48-48-48-48", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("2-2-2-2-2-2-0-2-2-2-2-2-0-0", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("0-0-0-0-0-0-20-4-4-4-4-4-4-4", "0", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0", "2", "", state, error));
+    CHECK(!StateAnalyzer::ParsePosition("4-4-4-4-4-4-0-4-4-4-4-4-4-0", "0", "7", state, error));
+
+    // Endgames whose value the exact search of the engine decides as well
+    const char* endgames[][2] = {
+        { "0-0-0-0-0-1-20-4-4-4-4-4-4-3", "0" },
+        { "0-0-0-0-1-1-22-1-0-0-0-0-1-22", "0" },
+        { "0-0-0-0-1-1-22-1-0-0-0-0-1-22", "1" },
+        { "1-0-2-0-0-1-20-0-1-0-0-2-1-20", "0" },
+        { "0-3-0-1-0-0-21-2-0-0-1-0-0-20", "1" },
+        { "0-0-1-0-0-2-23-0-0-0-3-0-0-19", "0" },
+        { "0-0-0-0-0-1-23-1-0-0-0-0-0-23", "0" },
+    };
+    for (const auto& [board, turn] : endgames)
+    {
+        for (const std::string ruleset : { "0", "1" })
+        {
+            CHECK(StateAnalyzer::ParsePosition(board, turn, ruleset, state, error));
+            ProofNumberSolver solver;
+            const ProofResult proof = solver.Solve(state);
+            Minimax engine(std::make_shared<TranspositionTable>(1));
+            const float score = engine.Search(state, 40).m_Score;
+            const ProofResultEnum expected = score > 0.0F ? PLAYER1_WIN : (score < 0.0F ? PLAYER2_WIN : DRAW);
+            CHECK(proof.m_Result == expected);
+        }
+    }
+
+    return s_Failures == 0 ? 0 : 1;
+}